@@ -0,0 +1,63 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+/*
+ * A line of the report: how long the best of a few runs has taken, and
+ * what it has done. The items are whatever the thing counts, matches or
+ * entries, so that it's seen right away when two engines disagree, or
+ * a change has broken something while making it faster.
+ */
+struct BenchResult {
+    std::string   name;
+    double        seconds;
+    std::uint64_t bytes;    // Zero if the throughput isn't in bytes.
+    std::uint64_t items;
+};
+
+/*
+ * Runs 'fn' 'repeats' times, and takes the best time, which is the least
+ * disturbed by whatever else the machine was doing. 'fn' returns the
+ * number of items it has found.
+ */
+template <typename Fn>
+BenchResult measure(std::string const& name, std::uint64_t bytes,
+                    unsigned repeats, Fn fn) {
+    using Clock = std::chrono::steady_clock;
+
+    BenchResult result {name, 0.0, bytes, 0};
+    for (unsigned k = 0; k < std::max(1u, repeats); ++k) {
+        auto start = Clock::now();
+        result.items = fn();
+        std::chrono::duration<double> took = Clock::now() - start;
+
+        if (k == 0 || took.count() < result.seconds)
+            result.seconds = took.count();
+    }
+
+    return result;
+}
+
+/*
+ * What every benchmark is given: the corpus, both in memory, for the
+ * searches, and in a file, for the whole scans.
+ */
+struct BenchContext {
+    std::string const& corpus;
+    std::string const& corpusFn;
+    unsigned repeats;
+    std::size_t maxNum;
+    ThreadPool& pool;
+};
+
+// The search functions, the ring buffer sizes and the whole scans of
+// speedrun.
+std::vector<BenchResult> benchSpeedrun(BenchContext const& context);
+
+// The regex engine, and the whole scans, of shodantask.
+std::vector<BenchResult> benchShodan(BenchContext const& context);
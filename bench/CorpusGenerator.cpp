@@ -0,0 +1,174 @@
+#include "CorpusGenerator.hpp"
+#include <algorithm>
+#include <string>
+
+namespace {
+
+/*
+ * SplitMix64. The engines of 'std::' are the same everywhere, but their
+ * distributions aren't, so the numbers are turned into whatever is needed
+ * right here, with nothing but integer and exact floating point math.
+ */
+class Random {
+public:
+
+    explicit Random(std::uint64_t seed): mState(seed) {}
+
+    std::uint64_t next() {
+        std::uint64_t z = (mState += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    // In [0, 1).
+    double uniform() {
+        return (next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    // In [0, n).
+    std::uint64_t below(std::uint64_t n) {
+        return next() % n;
+    }
+
+private:
+    std::uint64_t mState;
+};
+
+// A word of the text is about that long, with the space after it.
+const double MeanWordSize = 6.5;
+
+const char Letters[] = "abcdefghijklmnopqrstuvwxyz";
+const char PathChars[] = "abcdefghijklmnopqrstuvwxyz0123456789-_.";
+
+char const* const TopDomains[] = { "com", "net", "org", "io", "example" };
+
+// What makes the search stop, but isn't an URL. A host of dots or dashes
+// alone is an URL as far as the grammar cares, so there's none of these.
+char const* const NearMisses[] = {
+    "http:x", "http:/", "http//", "https:/x", "http:// ", "httpx://a",
+    "http", "HTTP://x", "http:///", "htt"
+};
+
+template <std::size_t N>
+char pick(Random& random, char const (&chars)[N]) {
+    return chars[random.below(N - 1)];
+}
+
+void appendWord(std::string& out, Random& random) {
+    std::size_t length = 1 + random.below(10);
+    for (std::size_t i = 0; i < length; ++i)
+        out.push_back(pick(random, Letters));
+}
+
+/*
+ * The host of the given number: a few letters made of the number, so
+ * that every number has its own, and a top level domain.
+ */
+void appendHost(std::string& out, std::uint64_t index) {
+    if (index % 3 == 0)
+        out += "www.";
+
+    std::uint64_t rest = index;
+    do {
+        out.push_back(Letters[rest % 26]);
+        rest /= 26;
+    } while (rest != 0);
+
+    out.push_back('.');
+    out += TopDomains[index % (sizeof TopDomains / sizeof TopDomains[0])];
+}
+
+void appendUrl(std::string& out, Random& random,
+               CorpusOptions const& options) {
+    out += random.below(5) == 0 ? "https://" : "http://";
+
+    // The product of a few uniform numbers is skewed towards zero.
+    double skewed = 1.0;
+    for (unsigned i = 0; i < options.hostSkew; ++i)
+        skewed *= random.uniform();
+    appendHost(out, std::uint64_t(skewed * options.numHosts));
+
+    // A geometric number of segments, with the given mean.
+    double more = options.meanPathSegments
+                / (options.meanPathSegments + 1.0);
+    while (random.uniform() < more) {
+        out.push_back('/');
+        std::size_t length = 1 + random.below(options.maxSegmentLength);
+        for (std::size_t i = 0; i < length; ++i)
+            out.push_back(pick(random, PathChars));
+    }
+}
+
+} // namespace
+
+void generateCorpus(std::ostream& out, CorpusOptions const& options) {
+    Random random(options.seed);
+
+    double urlChance  = options.urlDensity      * MeanWordSize / 1024;
+    double missChance = options.nearMissDensity * MeanWordSize / 1024;
+
+    std::string chunk;
+    std::size_t lineLength = 0;
+    std::uint64_t left = options.size;
+
+    while (left != 0) {
+        std::size_t before = chunk.size();
+
+        double roll = random.uniform();
+        if (roll < urlChance)
+            appendUrl(chunk, random, options);
+        else if (roll < urlChance + missChance)
+            chunk += NearMisses[random.below(sizeof NearMisses
+                                             / sizeof NearMisses[0])];
+        else
+            appendWord(chunk, random);
+
+        lineLength += chunk.size() - before;
+
+        // Some punctuation right after a thing is what makes it end.
+        if (random.below(8) == 0)
+            chunk.push_back(random.below(2) ? ',' : '.');
+
+        if (lineLength >= 80) {
+            chunk.push_back('\n');
+            lineLength = 0;
+        } else {
+            chunk.push_back(' ');
+        }
+
+        if (chunk.size() >= 64*1024 || chunk.size() >= left) {
+            std::size_t size = std::min<std::uint64_t>(chunk.size(), left);
+            out.write(chunk.data(), size);
+            left -= size;
+            chunk.clear();
+        }
+    }
+}
+
+char const* const CorpusUsage =
+    "Corpus: -S SEED, -u URLS_PER_KB, -h HOSTS, -k HOST_SKEW,"
+    " -p PATH_SEGMENTS, -l SEGMENT_LENGTH, -e NEAR_MISSES_PER_KB\n";
+
+bool parseCorpusOption(std::string const& option, std::string const& value,
+                       CorpusOptions& options) {
+    if (option == "-S")
+        options.seed = std::stoull(value);
+    else if (option == "-u")
+        options.urlDensity = std::stod(value);
+    else if (option == "-h")
+        options.numHosts = std::stoul(value);
+    else if (option == "-k")
+        options.hostSkew = std::stoul(value);
+    else if (option == "-p")
+        options.meanPathSegments = std::stod(value);
+    else if (option == "-l")
+        options.maxSegmentLength = std::stoul(value);
+    else if (option == "-e")
+        options.nearMissDensity = std::stod(value);
+    else
+        return false;
+
+    return options.urlDensity >= 0 && options.nearMissDensity >= 0
+        && options.meanPathSegments >= 0 && options.maxSegmentLength > 0;
+}
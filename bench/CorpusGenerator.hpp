@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+/*
+ * What a synthetic corpus looks like. It's lines of random words, with
+ * URLs and things which almost are URLs scattered among them. The same
+ * options and the same seed always give the very same bytes, on whatever
+ * machine and standard library, so that throughput measured on different
+ * machines, or before and after a change, is measured on the same data.
+ */
+struct CorpusOptions {
+    std::uint64_t size = 64*1024*1024;
+    std::uint64_t seed = 1;
+
+    // URLs per kilobyte of text, on average.
+    double urlDensity = 2.0;
+
+    // How many distinct hosts there are. A host is picked by the product
+    // of 'hostSkew' random numbers, so the more of them, the more the few
+    // first hosts are frequent, and the rest are rare.
+    std::uint32_t numHosts = 1000;
+    unsigned hostSkew = 3;
+
+    // Path segments per URL, on average, and the longest segment. Their
+    // number is geometric, so a lot of URLs have no path at all.
+    double meanPathSegments = 2.5;
+    std::uint32_t maxSegmentLength = 12;
+
+    // Things like "http:x", "http//" and "https://" followed by nothing,
+    // which make the prefilter stop, and the parser reject them.
+    double nearMissDensity = 1.0;
+};
+
+// Writes 'options.size' bytes of the corpus to 'out'.
+void generateCorpus(std::ostream& out, CorpusOptions const& options);
+
+/*
+ * Takes a command line option of the generator and its value into
+ * 'options'. Returns 'false' if it isn't one, or its value is no good.
+ */
+bool parseCorpusOption(std::string const& option, std::string const& value,
+                       CorpusOptions& options);
+
+// What 'parseCorpusOption' knows, for the usage messages.
+extern char const* const CorpusUsage;
@@ -0,0 +1,71 @@
+#include <regex>
+#include "Benchmark.hpp"
+#include "../src/FrequencyTable.hpp"
+#include "../src/Helpers.hpp"
+#include "../src/RegexSearchFile.hpp"
+
+namespace {
+
+// The same as shodantask looks for.
+constexpr auto UrlRegexExpr = "(https?)://([\\w.-]+)(/[\\w_.,/+-]*)?";
+
+/*
+ * What 'countFile' of shodantask does: every match of the file, counted
+ * in the tables of hosts and paths.
+ */
+std::uint64_t countMatches(RegexSearchCo::pull_type& coro) {
+    FrequencyTable hosts, paths;
+    std::uint64_t numMatches = 0;
+
+    for (auto const& batch: coro) {
+        for (std::size_t idx = 0; idx < batch.size(); ++idx) {
+            StringRef path = batch.group(idx, 3);
+            if (path.empty())
+                path = StringRef("/", 1);
+
+            hosts.add(batch.group(idx, 2));
+            paths.add(path);
+        }
+
+        numMatches += batch.size();
+    }
+
+    return numMatches;
+}
+
+} // namespace
+
+std::vector<BenchResult> benchShodan(BenchContext const& context) {
+    std::vector<BenchResult> results;
+    DfaRegex rex(UrlRegexExpr, std::regex::icase);
+
+    char const* first = context.corpus.data();
+    char const* last  = first + context.corpus.size();
+
+    results.push_back(measure("regexSearchAll", context.corpus.size(),
+                              context.repeats, [&]{
+        std::uint64_t num = 0;
+        for (auto const& match: regexSearchAll(first, last, rex)) {
+            (void)match;
+            ++num;
+        }
+        return num;
+    }));
+
+    results.push_back(measure("shodantask mmap", context.corpus.size(),
+                              context.repeats, [&]{
+        auto coro = spawn<RegexSearchCo>(regexSearchFileMmap,
+                                         context.corpusFn, rex);
+        return countMatches(coro);
+    }));
+
+    results.push_back(measure("shodantask buf", context.corpus.size(),
+                              context.repeats, [&]{
+        auto coro = spawn<RegexSearchCo>(regexSearchFileBuf,
+                                         context.corpusFn, rex, 100,
+                                         1024*1024);
+        return countMatches(coro);
+    }));
+
+    return results;
+}
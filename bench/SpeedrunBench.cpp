@@ -0,0 +1,108 @@
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include "../src/InputFiles.hpp"
+#include "../src/Report.hpp"
+#include "../src/ScanResult.hpp"
+#include "../src/Scanner.hpp"
+#include "../src/UrlSearch.hpp"
+#include "Benchmark.hpp"
+
+namespace {
+
+// Reads the corpus through a ring of N bytes, which is what 'BufferSize'
+// is tuned by.
+template <UIndex N>
+BenchResult benchRing(BenchContext const& context) {
+    return measure("scanStream, " + std::to_string(N / 1024) + " kB ring",
+                   context.corpus.size(), context.repeats, [&]{
+        std::ifstream input(context.corpusFn, std::ios_base::binary);
+        ScanResult result{ScanConfig()};
+        scanStream<N>(context.pool, input, UINT64_MAX, result);
+        return result.numMatches;
+    });
+}
+
+// The scanner generated from a grammar other than the built one costs
+// just as much, and that's what these show.
+template <typename Grammar>
+BenchResult benchFindUrl(BenchContext const& context, std::string const& name) {
+    ArrayView<char> view(context.corpus.data(), context.corpus.size());
+    UIndex size = view.size();
+
+    return measure(name, size, context.repeats, [&]{
+        std::uint64_t num = 0;
+        UIndex begin = 0, urlBegin, domainBegin, pathBegin, urlEnd;
+        while (findUrl<Grammar>(view, begin, size, true,
+                                urlBegin, domainBegin, pathBegin, urlEnd)) {
+            ++num;
+            begin = urlEnd;
+        }
+        return num;
+    });
+}
+
+BenchResult benchScan(BenchContext const& context, std::string const& method) {
+    InputOptions options;
+    options.method = method;
+    options.mapping.sequential = true;
+
+    auto inputs = listInputFiles({context.corpusFn});
+    return measure("speedrun " + method + ", "
+                   + std::to_string(context.pool.size()) + " threads",
+                   context.corpus.size(), context.repeats, [&]{
+        return scanInputs(context.pool, ScanConfig(), inputs,
+                          options).numMatches;
+    });
+}
+
+} // namespace
+
+std::vector<BenchResult> benchSpeedrun(BenchContext const& context) {
+    std::vector<BenchResult> results;
+
+    ArrayView<char> view(context.corpus.data(), context.corpus.size());
+    UIndex size = view.size();
+
+    results.push_back(measure("findLiteral", size, context.repeats, [&]{
+        std::uint64_t num = 0;
+        UIndex begin = 0, matchBegin;
+        while (findLiteral(view, begin, size, matchBegin)) {
+            ++num;
+            begin = matchBegin + UrlTables<UrlGrammar>::Restart;
+        }
+        return num;
+    }));
+
+    results.push_back(benchFindUrl<UrlGrammar>(context, "findUrl"));
+    results.push_back(benchFindUrl<HttpQueryGrammar>(context,
+                                                     "findUrl, queries"));
+    results.push_back(benchFindUrl<HttpFtpGrammar>(context, "findUrl, ftp"));
+
+    // Searching and counting, in a single thread, with no reading at all.
+    ScanResult counted{ScanConfig()};
+    results.push_back(measure("collectMatches", size, context.repeats, [&]{
+        counted = ScanResult(ScanConfig());
+        ScanCursor cursor(counted, 0);
+        collectMatches(view, 0, size, true, cursor, counted);
+        return counted.numMatches;
+    }));
+
+    results.push_back(benchRing<64*1024>(context));
+    results.push_back(benchRing<128*1024>(context));
+    results.push_back(benchRing<256*1024>(context));
+    results.push_back(benchRing<512*1024>(context));
+    results.push_back(benchRing<1024*1024>(context));
+    results.push_back(benchRing<4*1024*1024>(context));
+
+    results.push_back(benchScan(context, "buf"));
+    results.push_back(benchScan(context, "mmap"));
+
+    results.push_back(measure("printTop, paths", 0, context.repeats, [&]{
+        std::ofstream output("/dev/null");
+        printTop(output, counted.urlPaths, context.maxNum, context.pool);
+        return counted.urlPaths.exact().size();
+    }));
+
+    return results;
+}
@@ -0,0 +1,124 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include "Benchmark.hpp"
+#include "CorpusGenerator.hpp"
+#include "../src/ThreadPool.hpp"
+
+extern "C" {
+    #include <stdlib.h>
+    #include <unistd.h>
+}
+
+namespace {
+
+void printResult(BenchResult const& result) {
+    std::cout << std::left << std::setw(32) << result.name << std::right
+              << std::fixed << std::setprecision(4)
+              << std::setw(10) << result.seconds << " s";
+
+    if (result.bytes != 0) {
+        std::cout << std::setprecision(1) << std::setw(10)
+                  << result.bytes / result.seconds / (1024*1024) << " MB/s";
+    } else {
+        std::cout << std::setw(15) << "";
+    }
+
+    std::cout << std::setw(12) << result.items << std::endl;
+}
+
+} // namespace
+
+/*
+ * Measures the search functions, the ring buffer sizes, and the whole
+ * scans of both tools on a corpus, a generated one unless a file is given.
+ * Every benchmark is run a few times, and the best time counts.
+ */
+int main(int argc, char *argv[]) {
+    CorpusOptions corpusOptions;
+    unsigned sizeMb = 64;
+    unsigned repeats = 3;
+    unsigned numThreads = 0;
+    std::size_t maxNum = 10;
+    bool badOption = false;
+
+    int argi = 1;
+    for (; argi + 1 < argc && argv[argi][0] == '-'; argi += 2) {
+        std::string option = argv[argi];
+        if (option == "-s")
+            sizeMb = std::stoul(argv[argi+1]);
+        else if (option == "-r")
+            repeats = std::stoul(argv[argi+1]);
+        else if (option == "-j")
+            numThreads = std::stoul(argv[argi+1]);
+        else if (option == "-n")
+            maxNum = std::stoul(argv[argi+1]);
+        else
+            badOption |= !parseCorpusOption(option, argv[argi+1],
+                                            corpusOptions);
+    }
+
+    if (argc - argi > 1 || badOption) {
+        std::cerr << "Usage: benchmark [-s MEGABYTES] [-r REPEATS]"
+                     " [-j THREADS] [-n N] [CORPUS OPTION...] [CORPUS]\n"
+                  << CorpusUsage;
+        return EXIT_FAILURE;
+    }
+
+    if (numThreads == 0)
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    // The whole scans want a file, and the searches want memory. A corpus
+    // given is read into memory, a generated one is written to a file
+    // which is removed in the end.
+    std::string corpus, corpusFn;
+    bool temporary = argc - argi == 0;
+
+    if (temporary) {
+        corpusOptions.size = std::uint64_t(sizeMb) * 1024*1024;
+        std::ostringstream text;
+        generateCorpus(text, corpusOptions);
+        corpus = text.str();
+
+        char const* tmpDir = std::getenv("TMPDIR");
+        std::string name = std::string(tmpDir ? tmpDir : "/tmp")
+                         + "/speedrun-corpus-XXXXXX";
+        int fd = ::mkstemp(&name[0]);
+        if (fd == -1)
+            throw std::ios_base::failure(name);
+        ::close(fd);
+
+        corpusFn = name;
+        std::ofstream output(corpusFn, std::ios_base::binary);
+        output.write(corpus.data(), corpus.size());
+        if (!output)
+            throw std::ios_base::failure(corpusFn);
+    } else {
+        corpusFn = argv[argi];
+        std::ifstream input(corpusFn, std::ios_base::binary);
+        if (!input.is_open())
+            throw std::ios_base::failure(corpusFn);
+        std::ostringstream text;
+        text << input.rdbuf();
+        corpus = text.str();
+    }
+
+    std::cout << "corpus " << corpus.size() / (1024*1024) << " MB, "
+              << numThreads << " threads, best of " << repeats << std::endl
+              << std::endl;
+
+    ThreadPool pool(numThreads);
+    BenchContext context {corpus, corpusFn, repeats, maxNum, pool};
+
+    for (auto const& result: benchSpeedrun(context))
+        printResult(result);
+    for (auto const& result: benchShodan(context))
+        printResult(result);
+
+    if (temporary)
+        std::remove(corpusFn.c_str());
+}
@@ -0,0 +1,31 @@
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include "CorpusGenerator.hpp"
+
+/*
+ * Writes a synthetic corpus to a file, for measuring the tools themselves,
+ * end to end, or for looking at what the benchmark runs on.
+ */
+int main(int argc, char *argv[]) {
+    CorpusOptions options;
+    bool badOption = false;
+
+    int argi = 1;
+    for (; argi + 1 < argc && argv[argi][0] == '-'; argi += 2)
+        badOption |= !parseCorpusOption(argv[argi], argv[argi+1], options);
+
+    if (argc - argi != 2 || badOption) {
+        std::cerr << "Usage: gencorpus [CORPUS OPTION...] MEGABYTES OUTPUT\n"
+                  << CorpusUsage;
+        return EXIT_FAILURE;
+    }
+
+    options.size = std::stoull(argv[argi]) * 1024*1024;
+
+    std::ofstream output(argv[argi+1], std::ios_base::binary);
+    if (!output.is_open())
+        throw std::ios_base::failure(argv[argi+1]);
+
+    generateCorpus(output, options);
+}
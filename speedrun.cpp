@@ -1,495 +1,286 @@
 #include <algorithm>
+#include <chrono>
+#include <cstdlib>
 #include <cstdint>
-#include <cstring>
-#include <fstream>
-#include <future>
-#include <ios>
 #include <iostream>
+#include <memory>
+#include <stdexcept>
 #include <string>
 #include <thread>
-#include <tuple>
-#include <unordered_map>
 #include <vector>
 
-/*
- * Integral type to store ring buffer index. This type is intentionally
- * made unsigned, since we're going to do shifts and bitwise operations
- * which are well-defined by the C++ standard only for unsigned types.
- * This makes some things less convenient, but there're no other option.
- */
-using UIndex = std::size_t;
-
-/* Long names are bad if your're an adept of the Eighty Column religion. */
-using FrequencyMap = std::unordered_map<std::string, unsigned>;
+#include "src/BlockReader.hpp"
+#include "src/Checkpoint.hpp"
+#include "src/FollowInput.hpp"
+#include "src/InputFiles.hpp"
+#include "src/InputStream.hpp"
+#include "src/MemoryMappedFile.hpp"
+#include "src/Merge.hpp"
+#include "src/Patterns.hpp"
+#include "src/Report.hpp"
+#include "src/ScanResult.hpp"
+#include "src/Scanner.hpp"
+#include "src/Stats.hpp"
+#include "src/ThreadPool.hpp"
 
 /*
- * Unfortunately, we cannot use 'boost::circular_buffer', so must roll out
- * our own implementation. The main point of the implementation is the
- * following: if we restrict buffer size to the power of two values, we can
- * get very cheap implementation of index wrap-around (single bitwise and).
- * If the size of buffer known at compile time, the compiler is able to
- * statically calculate the mask and inline it.
+ * "speedrun merge": merges partial results of any number of scans, and
+ * prints the same report a single scan of all their inputs would. The
+ * extra patterns come in the order they're first met in the files.
  */
-template <typename T, UIndex N>
-class RingArray {
-public:
-
-    UIndex   size()  const { return N; }
-    T const* begin() const { return buf; }
-    T      * begin()       { return buf; }
-    T const* end()   const { return buf + N; }
-    T      * end()         { return buf + N; }
-
-    /*
-     * Returns the canonical representation of 'idx'. Whatever 'idx' is,
-     * return value fits the range [0, size()-1].
-     */
-    UIndex wrap(UIndex idx) const { return idx % N; }
-
-    /*
-     * Index the underlying array with a wrapped around index value. Since
-     * every possible 'idx' value is correct, these functions must be used
-     * with care. More over, to tell the truth, dealing with ring buffer
-     * indices really hurts.
-     */
-    T const& operator [] (UIndex idx) const { return buf[idx % N]; }
-    T      & operator [] (UIndex idx)       { return buf[idx % N]; }
+int mergeMain(int argc, char *argv[]) {
+    unsigned maxNum = 10;
+    unsigned numThreads = 1;
+
+    int argi = 2;
+    for (; argi + 1 < argc && argv[argi][0] == '-'; argi += 2) {
+        std::string option = argv[argi];
+        if (option == "-n")
+            maxNum = std::stoul(argv[argi+1]);
+        else if (option == "-j")
+            numThreads = std::stoul(argv[argi+1]);
+        else
+            break;
+    }
 
-private:
+    if (argc - argi < 2) {
+        std::cerr << "Usage: speedrun merge [-n N] [-j THREADS]"
+                     " PARTIAL... OUTPUT\n";
+        return EXIT_FAILURE;
+    }
 
-    T buf[N];
-};
+    std::vector<std::string> inputArgs(argv + argi, argv + argc - 1);
+    std::string outputFn = argv[argc-1];
 
-/*
- * An ad-hoc implementation for a function which looks for literal sting
- * "http" in a ring buffer of chars. It uses Wikipedia's implementation of
- * Boyer-Moore string search algorithm with search tables pre-calculated
- * for the particular search pattern. Shodan, this part of code is written
- * this way especially for you. Enjoy :).
- */
-template <UIndex N>
-bool findHttp(RingArray<char, N> const& buf,
-              UIndex begin, UIndex end, UIndex& matchBegin, UIndex& matchEnd) {
-
-    const UIndex patlen = 4;
-    const char* pat = "http";
-
-    static UIndex delta1[] = {
-        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-        4, 4, 4, 4, 3, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 1, 4, 4, 4,
-        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4 };
-
-    static UIndex delta2[] = {7, 6, 5, 1};
-
-    begin = buf.wrap(begin);
-    end   = buf.wrap(end);
-
-    UIndex stringlen = buf.wrap(end - begin);
-    if (stringlen == 0)
-        stringlen = buf.size();
-
-    if (stringlen < 4) {
-        matchBegin = begin;
-        matchBegin = end;
-        return false;
-    }
+    if (numThreads == 0)
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
 
-    UIndex i = patlen-1 +1;
-    while (i < stringlen+1) {
-        int j = patlen-1; // Don't make unsigned!
-        while (j >= 0 && (buf[begin+i-1] == pat[j])) {
-            --i;
-            --j;
-        }
-        if (j < 0) {
-            matchBegin = buf.wrap(begin+i);
-            matchEnd   = buf.wrap(matchBegin + 4);
-            return true;
-        }
+    ThreadPool pool(numThreads);
+    printMergedReport(pool, inputArgs, maxNum, outputFn);
 
-        i += std::max(delta1[buf[begin+i-1]], delta2[j]);
-    }
+    return EXIT_SUCCESS;
+}
 
-    matchBegin = end - 3;
-    matchEnd   = end - 3;
-    return false;
+// Tells whether 'hint' is 'name' followed by a number.
+bool isSizeHint(std::string const& hint, std::string const& name) {
+    return hint.compare(0, name.size(), name) == 0
+        && hint.size() > name.size()
+        && hint.find_first_not_of("0123456789", name.size()) == hint.npos;
 }
 
 /*
- * Finds the first thing looking like an URL in the circular buffer 'buf'
- * in the [begin, end) range. If an URL was found, the function returns
- * 'true' and sets its results like in the following example:
- *
- *     https://www.youtube.com/watch?v=oHg5SJYRHA0
- *     ^       ^ domainBegin  ^     ^ urlEnd
- *     urlBegin               pathBegin
- *
- * If the function hasn't found anything like an URL, or found a thing
- * what, if continued beyond the 'end', may cause a longer match, it sets
- * all these four results to the same value which should be treated as the
- * search re-run point.
+ * Parses the "-M" list of mapping hints, like "populate,ahead=64,drop",
+ * into 'mapping'. Returns 'false' on anything it doesn't know.
  */
-template <UIndex N>
-bool findUrl(RingArray<char, N> const& buf,
-             UIndex  begin,
-             UIndex  end,
-             UIndex& urlBegin,
-             UIndex& domainBegin,
-             UIndex& pathBegin,
-             UIndex& urlEnd) {
-             // More arguments for the god of arguments.
-
-    UIndex httpBegin, httpEnd;
-    bool foundHttp = findHttp(buf, begin, end, httpBegin, httpEnd);
-
-    if (!foundHttp) {
-        urlBegin = domainBegin = pathBegin == httpEnd;
-        return false;
-    }
-
-    UIndex idx;
-    char ch;
-
-    auto advance = [&buf, &idx, &ch, end]{
-        idx = buf.wrap(idx+1);
-        ch = buf[idx];
-    };
-
-    auto allowedInDomainName = [](char ch) -> bool {
-        // The following line is a portability killer.
-        // Please, don't run this program on IBM mainframes.
-        return ('a' <= ch && ch <= 'z')
-            || ('A' <= ch && ch <= 'Z')
-            || ('0' <= ch && ch <= '9')
-            || ch == '-' || ch == '.';
-    };
-
-    auto allowedInPath = [&allowedInDomainName](char ch) -> bool {
-        return allowedInDomainName(ch)
-            || ch == '_'
-            || ch == '/'
-            || ch == '+'
-            || ch == ','; // I'm sure it a legal character, but who
-    };                    // wants to put a comma in their URLs?
-
-    urlBegin = httpBegin;
-    idx = httpEnd-1;
-
-    // Yes, you're right. The following is what you think. It's
-    // a hand-written finite automaton. It's kind of ugly, but
-    // is going to be faster than a regular expression.
-
-got_http:
-    advance();
-    if (idx == end)
-        goto fail_premature;
-
-    if (ch == ':')
-        goto got_http_colon;
-    if (ch == 's')
-        goto got_https;
-
-    goto fail;
-
-got_http_colon:
-    advance();
-    if (idx == end)
-        goto fail_premature;
-
-    if (ch == '/')
-        goto got_first_slash;
-
-    goto fail;
-
-got_https:
-    advance();
-    if (idx == end)
-        goto fail_premature;
-
-    if (ch == ':')
-        goto got_https_colon;
-
-    goto fail;
-
-got_https_colon:
-    advance();
-    if (idx == end)
-        goto fail_premature;
-
-    if (ch == '/')
-        goto got_first_slash;
-
-    goto fail;
-
-got_first_slash:
-    advance();
-    if (idx == end)
-        goto fail_premature;
-
-    if (ch == '/')
-        goto got_second_slash;
-
-    goto fail;
-
-got_second_slash:
-    advance();
-    if (idx == end)
-        goto fail_premature;
-
-    domainBegin = idx;
-    if (allowedInDomainName(ch))
-        goto got_domain_char;
-
-    goto fail;
-
-got_domain_char:
-    advance();
-    if (idx == end)
-        goto fail_premature;
-
-    if (ch == '/') {
-        pathBegin = idx;
-        goto got_path_char;
+bool parseMappingOptions(std::string const& list, MappingOptions& mapping) {
+    for (auto const& hint: splitList(list)) {
+        if (hint == "populate")
+            mapping.populate = true;
+        else if (hint == "huge")
+            mapping.hugePages = true;
+        else if (hint == "drop")
+            mapping.dropConsumed = true;
+        else if (isSizeHint(hint, "ahead="))
+            mapping.readAhead = std::stoul(hint.substr(6)) * 1024*1024;
+        else if (isSizeHint(hint, "window="))
+            mapping.windowSize = std::stoul(hint.substr(7)) * 1024*1024;
+        else
+            return false;
     }
 
-    if (allowedInDomainName(ch))
-        goto got_domain_char;
-
-    goto out_domain;
-
-got_path_char:
-    advance();
-    if (idx == end)
-        goto fail_premature;
-
-    if (allowedInPath(ch))
-        goto got_path_char;
-
-    urlEnd = idx;
-    goto out_path;
-
-out_domain:
-    urlEnd = idx;
-    pathBegin = idx;
-    return true;
-
-out_path:
-    urlEnd = idx;
     return true;
-
-fail_premature:
-    urlBegin = domainBegin = pathBegin = urlEnd = httpBegin;
-    return false;
-
-fail:
-    urlBegin = domainBegin = pathBegin = httpEnd;
-    return false;
 }
 
-// Sorts 'map' items by 'second' field, and prints the most frequent
-// items as a text table.
-void printTop(std::ofstream& out, FrequencyMap const& map, UIndex maxNum){
-
-    using Pointer = FrequencyMap::const_pointer;
-
-    // Instead of copying pairs from the original map, simply fill
-    // a vector with their addresses.
-    std::vector<Pointer> pointers;
-    pointers.reserve(map.size());
-    for (auto& pair: map) {
-        pointers.push_back(std::addressof(pair));
+/*
+ * Parses the "-i" reader options, like "pread,direct", into 'reading'.
+ * Returns 'false' on anything it doesn't know.
+ */
+bool parseReaderOptions(std::string const& list, ReaderOptions& reading) {
+    for (auto const& hint: splitList(list)) {
+        if (hint == "uring")
+            reading.backend = ReaderOptions::Uring;
+        else if (hint == "pread")
+            reading.backend = ReaderOptions::Pread;
+        else if (hint == "direct")
+            reading.direct = true;
+        else
+            return false;
     }
 
-    // Just sort the vector. I know, this is not the best possible
-    // approach from the O() point of view, but I have not enough spare
-    // time for elaborated algorithms in a test assignment.
-    std::sort(pointers.begin(), pointers.end(),
-              [](Pointer const& a, Pointer const& b) {
-                  if (a->second == b->second)
-                      return a->first < b->first;
-                  return (a->second > b->second);
-    });
-
-    UIndex i = 0;
-    for (auto const& ptr: pointers) {
-        if (i++ >= maxNum)
-            break;
-
-        out << ptr->second << ' ' << ptr->first << std::endl;
-    }
+    return true;
 }
 
 int main(int argc, char *argv[]) {
-    std::string inputFn;
+    if (argc > 1 && std::string(argv[1]) == "merge")
+        return mergeMain(argc, argv);
+
     std::string outputFn;
-    unsigned maxNum;
+    std::string statsFn;
+    std::string format = "text";
+    unsigned maxNum = 10;
+    unsigned numThreads = 1;
+    unsigned followInterval = 0;
+    CheckpointOptions checkpoint;
+    InputOptions options;
+    ScanConfig config;
+    std::unique_ptr<PatternSet> patterns;
+    bool badPatterns = false;
+
+    // Each thread reads its chunk front to back, so let the kernel read
+    // ahead aggressively and drop the pages behind.
+    options.mapping.sequential = true;
+    bool badMapping = false;
+    bool badReading = false;
 
     /*
      * I don't really understand why the task formulation insists on the
      * optional command line switch "-n". It adds routine to the code with
-     * no benefit (comparing to required argument).
+     * no benefit (comparing to required argument). And now there are two
+     * of them.
      */
-    if (argc == 3) {
-        maxNum   = 10;
-        inputFn  = argv[1];
-        outputFn = argv[2];
-    } else if (argc == 5 && std::string(argv[1]) == "-n") {
-        maxNum   = std::stoul(argv[2]);
-        inputFn  = argv[3];
-        outputFn = argv[4];
-    } else {
-        std::cerr << "Usage: speedrun [-n N] INPUT OUTPUT\n";
-        return EXIT_FAILURE;
+    int argi = 1;
+    for (; argi + 1 < argc && argv[argi][0] == '-'; argi += 2) {
+        std::string option = argv[argi];
+        if (option == "-n")
+            maxNum = std::stoul(argv[argi+1]);
+        else if (option == "-j")
+            numThreads = std::stoul(argv[argi+1]);
+        else if (option == "-m")
+            options.method = argv[argi+1];
+        else if (option == "-f")
+            format = argv[argi+1];
+        else if (option == "-F")
+            followInterval = std::stoul(argv[argi+1]);
+        else if (option == "-C" || option == "-R") {
+            checkpoint.filename = argv[argi+1];
+            checkpoint.resume = option == "-R";
+        } else if (option == "-c")
+            checkpoint.interval = std::stoul(argv[argi+1]);
+        else if (option == "-a")
+            config.approxCapacity = std::stoul(argv[argi+1]);
+        else if (option == "-d")
+            config.distinctPrecision = std::stoul(argv[argi+1]);
+        else if (option == "-x") {
+            try {
+                patterns.reset(new PatternSet(argv[argi+1]));
+            } catch (std::invalid_argument const&) {
+                badPatterns = true;
+            }
+        } else if (option == "-M") {
+            badMapping = !parseMappingOptions(argv[argi+1],
+                                              options.mapping);
+        } else if (option == "-i") {
+            badReading = !parseReaderOptions(argv[argi+1],
+                                             options.reading);
+        } else if (option == "--stats")
+            statsFn = argv[argi+1];
+        else
+            break;
     }
 
-    std::ifstream input(inputFn);
-    if (!input.is_open()) {
-        // Sorry, I'm not in mood to print errors nicely.
-        throw std::ios_base::failure(inputFn);
+    bool badPrecision = config.distinctPrecision != 0
+        && (config.distinctPrecision < HyperLogLog::MinPrecision ||
+            config.distinctPrecision > HyperLogLog::MaxPrecision);
+
+    bool badMethod = options.method != "buf" && options.method != "mmap";
+
+    // Approximate counts can't be merged into exact ones.
+    bool badFormat = (format != "text" && format != "partial")
+        || (format == "partial" && config.approxCapacity != 0);
+
+    // A follow never ends, so the report is the only thing it can write.
+    bool badFollow = followInterval != 0 && format != "text";
+
+    // Checkpoints are partial results, so what's true for them is true
+    // here, and a follow is never done anyway.
+    bool badCheckpoint = !checkpoint.filename.empty()
+        && (config.approxCapacity != 0 || followInterval != 0);
+
+    if (argc - argi < 2 || badMethod || badFormat || badFollow
+            || badCheckpoint || badPrecision || badPatterns || badMapping || badReading) {
+        std::cerr << "Usage: speedrun [-n N] [-j THREADS] [-m (buf|mmap)]"
+                     " [-f (text|partial)] [-F SECONDS]"
+                     " [(-C|-R) SNAPSHOT] [-c SECONDS]"
+                     " [-a CAPACITY] [-d PRECISION]"
+                     " [-x PATTERN,...] [-M HINT,...] [-i READER,...]"
+                     " [--stats FILE] INPUT... OUTPUT\n"
+                     "       speedrun merge [-n N] [-j THREADS]"
+                     " PARTIAL... OUTPUT\n"
+                     "An input may be a file, a directory or a glob.\n"
+                     "A partial result can't be written with -a.\n"
+                     "With -F, the only INPUT is followed as it grows, and"
+                     " OUTPUT is rewritten every SECONDS.\n"
+                     "With -C, a checkpoint is saved to SNAPSHOT every -c"
+                     " SECONDS, 60 by default, and -R resumes from it.\n"
+                     "Patterns: email, ipv4, ftp, ws, id=PREFIX\n"
+                     "Mapping hints: populate, huge, ahead=MEGABYTES, drop,"
+                     " window=MEGABYTES\n"
+                     "Readers: uring, pread, direct\n"
+                     "With --stats, where the time and memory went is"
+                     " written to FILE as JSON, '-' is stderr.\n";
+        return EXIT_FAILURE;
     }
 
-    // I thought that the buffer size of 8 kB would be large enough for
-    // batch reading, yet small enough to fit the processor cache. However,
-    // tests had shown that larger buffers operate faster.
-    RingArray<char, 512*1024> buf;
-
-    using OpState = std::tuple<bool, UIndex>;
-    using Future = std::future<OpState>;
-
-    // Starts a background file read operation to populate the [begin, end)
-    // range of the circular buffer with fresh data.
-    auto populate = [&](UIndex begin, UIndex end) -> Future {
-        begin = buf.wrap(begin);
-        end   = buf.wrap(end);
-
-        return std::async(std::launch::async, [&input, &buf, begin, end]()
-                                                               -> OpState {
-            if (!input.good())
-                return std::make_tuple(false, begin);
-
-            if (begin == end)
-                throw std::logic_error("This should never happen.");
-
-            std::streamsize read = 0;
-            if (begin < end) {
-                input.read(&buf[begin], end - begin);
-                read += input.gcount();
-            }
-            else {
-                input.read(&buf[begin], buf.size() - begin);
-                read += input.gcount();
-
-                input.read(&buf[0], end);
-                read += input.gcount();
-            }
-
-            if (read == 0)
-                return std::make_tuple(false, begin);
-
-            return std::make_tuple(true, buf.wrap(begin + read));
-        });
-    };
-
-    FrequencyMap urlDomains, urlPaths;
-    unsigned numMatches = 0;
-
-    auto processMatches = [&](UIndex begin, UIndex end) -> OpState {
-        begin = buf.wrap(begin);
-        end   = buf.wrap(end);
-
-        std::string urlDomain;
-        std::string urlPath;
-
-        auto readString = [&](std::string& dest, UIndex begin, UIndex end) {
-            // Why not just create the result string? I'm just trying
-            // to avoid unneeded memory allocation.
-            dest.clear();
-            for (UIndex i = begin; i != end; i = buf.wrap(i+1))
-                dest.push_back(buf[i]);
-        };
-
-        auto addEntry = [](FrequencyMap& map, std::string const& key) {
-            auto iter = map.find(key);
-            if (iter != map.end())
-                ++(iter->second);
-            else map[key] = 1;
-        };
-
-        UIndex urlBegin, domainBegin, pathBegin, urlEnd = begin;
-        bool foundAny = false;
-        while (1) {
-            bool found = findUrl(buf, urlEnd, end,
-                             urlBegin, domainBegin, pathBegin, urlEnd);
-            if (!found)
-                break;
-
-            foundAny = true;
-            ++numMatches;
-
-            readString(urlDomain, domainBegin, pathBegin);
-            if (pathBegin == urlEnd)
-                urlPath = "/";
-            else
-                readString(urlPath, pathBegin, urlEnd);
-
-            addEntry(urlDomains, urlDomain);
-            addEntry(urlPaths, urlPath);
+    // With "-n 0", nobody is going to look at the tables, and the counts
+    // of distinct keys come from the estimators. A partial result keeps
+    // them all, since it's not known which keys make it to the top of
+    // the merged ones.
+    config.keepTop = maxNum > 0 || config.distinctPrecision == 0
+                  || format == "partial";
+    config.patterns = patterns.get();
+
+    std::vector<std::string> inputArgs(argv + argi, argv + argc - 1);
+    outputFn = argv[argc-1];
+
+    if (numThreads == 0)
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    // Every thread is started right here, once: reads, scans, merges and
+    // the top lists all run on these.
+    ThreadPool pool(numThreads);
+
+    auto started = std::chrono::steady_clock::now();
+    std::vector<InputFile> inputs = listInputFiles(inputArgs);
+
+    if (followInterval != 0) {
+        // Only a plain file can be read at the offset where the last look
+        // has stopped.
+        if (inputs.size() != 1 || !inputs[0].regular
+                || detectCompression(inputs[0].path) != Compression::None) {
+            std::cerr << "speedrun: -F follows a single uncompressed"
+                         " regular file\n";
+            return EXIT_FAILURE;
         }
 
-        return std::make_tuple(foundAny, urlEnd);
-    };
-
-    auto future = populate(0, buf.size()/2);
-    future.wait();
-
-    bool readAny;
-    UIndex readEnd;
-    std::tie(readAny, readEnd) = future.get();
-
-    UIndex searchBegin = 0;
-    UIndex searchEnd   = readEnd;
-
-    while (readAny) {
-        auto future = populate(searchEnd, searchBegin);
-
-        bool matchAny;
-        UIndex matchEnd;
-        std::tie(matchAny, matchEnd) =
-                                processMatches(searchBegin, searchEnd);
-
-        future.wait();
-
-        std::tie(readAny, readEnd) = future.get();
-        if (!readAny)
-            break;
-
-        searchBegin = matchEnd;
-        searchEnd = readEnd;
+        followInput(pool, config, inputs[0].path, options.reading,
+                    followInterval, outputFn, maxNum);
     }
 
-    std::ofstream output(outputFn);
-    if (!output.is_open())
-        throw std::ios_base::failure(outputFn);
-
-    output << "total urls " << numMatches        << ", "
-           << "domains "    << urlDomains.size() << ", "
-           << "paths "      << urlPaths.size()   << std::endl
-                                                 << std::endl;
-
-    output << "top domains" << std::endl;
-    printTop(output, urlDomains, maxNum);
-    output << std::endl;
-
-    output << "top paths" << std::endl;
-    printTop(output, urlPaths, maxNum);
+    ScanResult result = checkpoint.filename.empty()
+        ? scanInputs(pool, config, inputs, options)
+        : scanInputsCheckpointed(pool, config, inputs, options, checkpoint);
+
+    if (format == "partial")
+        writePartial(outputFn, result);
+    else
+        printReport(outputFn, result, maxNum, pool);
+
+    // The output is there, so nobody is going to resume it.
+    if (!checkpoint.filename.empty())
+        std::remove(checkpoint.filename.c_str());
+
+    if (!statsFn.empty()) {
+        std::uint64_t inputBytes = 0;
+        for (auto const& input: inputs)
+            inputBytes += input.size;
+
+        auto elapsed = std::chrono::steady_clock::now() - started;
+        Stats::writeJson(statsFn, {
+            {"elapsed_ms", std::chrono::duration_cast<
+                               std::chrono::milliseconds>(elapsed).count()},
+            {"input_bytes", inputBytes},
+            {"urls", result.numMatches},
+            {"table_bytes", result.memoryUsage()},
+        });
+    }
 }
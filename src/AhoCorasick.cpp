@@ -0,0 +1,88 @@
+#include "AhoCorasick.hpp"
+#include <algorithm>
+#include <array>
+#include <deque>
+#include <stdexcept>
+
+unsigned AhoCorasick::add(std::string const& literal) {
+    if (literal.empty())
+        throw std::invalid_argument("empty literal");
+
+    mLiterals.push_back(literal);
+    mMaxLength = std::max(mMaxLength, literal.size());
+    return mLiterals.size() - 1;
+}
+
+void AhoCorasick::build() {
+
+    // The trie first. Node 0 is the root, and -1 means no edge.
+    std::vector<std::array<int, 256>> edges(1);
+    edges[0].fill(-1);
+    mOutputs.assign(1, {});
+
+    for (unsigned literal = 0; literal < mLiterals.size(); ++literal) {
+        int node = 0;
+        for (char ch: mLiterals[literal]) {
+            int& edge = edges[node][(unsigned char)ch];
+            if (edge < 0) {
+                edge = edges.size();
+                edges.emplace_back();
+                edges.back().fill(-1);
+                mOutputs.emplace_back();
+            }
+            node = edge;
+        }
+        mOutputs[node].push_back(literal);
+    }
+
+    // Breadth first, so that the failure target of a node is always done
+    // before the node itself. A missing edge goes wherever the failure
+    // target's edge goes, and the outputs are inherited the same way.
+    std::vector<int> fail(edges.size(), 0);
+    std::deque<int> queue;
+
+    mFirstBytes.clear();
+    for (unsigned ch = 0; ch < 256; ++ch) {
+        int& edge = edges[0][ch];
+        if (edge < 0) {
+            edge = 0;
+        } else {
+            mFirstBytes.push_back(char(ch));
+            queue.push_back(edge);
+        }
+    }
+
+    while (!queue.empty()) {
+        int node = queue.front();
+        queue.pop_front();
+
+        auto& inherited = mOutputs[fail[node]];
+        mOutputs[node].insert(mOutputs[node].end(),
+                              inherited.begin(), inherited.end());
+
+        for (unsigned ch = 0; ch < 256; ++ch) {
+            int& edge = edges[node][ch];
+            if (edge < 0) {
+                edge = edges[fail[node]][ch];
+            } else {
+                fail[edge] = edges[fail[node]][ch];
+                queue.push_back(edge);
+            }
+        }
+    }
+
+    for (auto& outputs: mOutputs) {
+        std::stable_sort(outputs.begin(), outputs.end(),
+                         [this](unsigned a, unsigned b) {
+                             return length(a) > length(b); });
+    }
+
+    mTable.resize(edges.size() * 256);
+    for (std::size_t node = 0; node < edges.size(); ++node) {
+        for (unsigned ch = 0; ch < 256; ++ch) {
+            int target = edges[node][ch];
+            mTable[node * 256 + ch] = State(target) * 256
+                | (mOutputs[target].empty() ? 0 : HasOutput);
+        }
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * Finds every occurrence of several literals in a single pass over the
+ * text, one table lookup per byte no matter how many literals there are.
+ * It's the Aho-Corasick automaton, with the failure links resolved ahead
+ * of time into a full 256-column transition table, so there's no looping
+ * at run time.
+ *
+ * A state is the offset of its row in the table. Rows are 256 entries
+ * long, so the lowest bit is free and tells whether some literals end in
+ * the state. That's what the scanning loop checks on every byte, and it
+ * doesn't take another memory access.
+ */
+class AhoCorasick {
+public:
+
+    using State = std::uint32_t;
+
+    // Adds a non-empty literal, and returns its number. Literals can only
+    // be added before 'build' is called.
+    unsigned add(std::string const& literal);
+
+    void build();
+
+    State start() const { return 0; }
+
+    State next(State state, char ch) const {
+        return mTable[(state & ~HasOutput) + (unsigned char)ch];
+    }
+
+    static bool hasOutput(State state) { return (state & HasOutput) != 0; }
+
+    // Numbers of the literals which end in the state, the longest first.
+    std::vector<unsigned> const& outputs(State state) const {
+        return mOutputs[state >> 8];
+    }
+
+    std::size_t length(unsigned literal) const {
+        return mLiterals[literal].size();
+    }
+
+    // Bytes which lead out of the start state, that is, the distinct first
+    // bytes of the literals. Nothing else can begin a match.
+    std::string const& firstBytes() const { return mFirstBytes; }
+
+    std::size_t maxLength() const { return mMaxLength; }
+    std::size_t numStates() const { return mOutputs.size(); }
+
+private:
+
+    static const State HasOutput = 1;
+
+    std::vector<std::string>           mLiterals;
+    std::vector<State>                 mTable;
+    std::vector<std::vector<unsigned>> mOutputs;
+    std::string mFirstBytes;
+    std::size_t mMaxLength = 0;
+};
@@ -0,0 +1,387 @@
+#include "BlockReader.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+extern "C" {
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <linux/io_uring.h>
+    #include <sys/mman.h>
+    #include <sys/syscall.h>
+    #include <sys/uio.h>
+    #include <unistd.h>
+}
+
+namespace {
+
+/*
+ * io_uring without liburing, which isn't around. The three system calls
+ * and a pair of shared memory rings are all it takes for plain reads.
+ */
+class UringReader: public BlockReader {
+public:
+
+    UringReader(int fd, bool direct, std::string const& filename,
+                char* buffer, std::size_t bufferSize, unsigned depth)
+        : BlockReader(fd, direct, filename)
+        , mRequests(depth) {
+
+        // The destructor doesn't run for a half-built object.
+        try {
+            setup(buffer, bufferSize, depth);
+        } catch (std::system_error const&) {
+            release();
+            throw;
+        }
+    }
+
+    ~UringReader() {
+        release();
+    }
+
+    /*
+     * Tells whether the kernel lets this process have a ring at all. It
+     * may be missing, or forbidden by a seccomp filter, or by sysctl.
+     */
+    static bool available() {
+        io_uring_params params {};
+        int ring = ::syscall(__NR_io_uring_setup, 1, &params);
+        if (ring < 0)
+            return false;
+
+        ::close(ring);
+        return true;
+    }
+
+    void submit(unsigned tag, char* dest, std::size_t length,
+                std::uint64_t offset) override {
+        mRequests[tag] = Request{dest, length, offset, 0};
+        push(tag);
+    }
+
+    Completion wait() override {
+        while (1) {
+            io_uring_cqe cqe = pop();
+            unsigned tag = cqe.user_data;
+            Request& request = mRequests[tag];
+
+            if (cqe.res < 0)
+                throw std::system_error(-cqe.res, std::system_category(),
+                                        mFilename);
+
+            // Regular files rarely give less than asked for without being
+            // over, but they may. The rest is just asked for once again.
+            request.done += cqe.res;
+            if (cqe.res == 0 || request.done == request.length)
+                return Completion{tag, request.done};
+
+            push(tag);
+        }
+    }
+
+    char const* name() const override { return "io_uring"; }
+
+private:
+
+    struct Request {
+        char*         dest;
+        std::size_t   length;
+        std::uint64_t offset;
+        std::size_t   done;
+    };
+
+    void setup(char* buffer, std::size_t bufferSize, unsigned depth) {
+        io_uring_params params {};
+        mRing = ::syscall(__NR_io_uring_setup, depth, &params);
+        if (mRing < 0)
+            throw std::system_error(errno, std::system_category(),
+                                    "io_uring_setup");
+
+        mSqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        mCqSize = params.cq_off.cqes
+                + params.cq_entries * sizeof(io_uring_cqe);
+
+        // Older kernels map the two rings separately.
+        bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single)
+            mSqSize = mCqSize = std::max(mSqSize, mCqSize);
+
+        mSq = map(mSqSize, IORING_OFF_SQ_RING);
+        mCq = single ? mSq : map(mCqSize, IORING_OFF_CQ_RING);
+        mSqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        mSqes = static_cast<io_uring_sqe*>(map(mSqesSize, IORING_OFF_SQES));
+
+        char* sq = static_cast<char*>(mSq);
+        mSqTail  = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        mSqMask  = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        mSqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+        char* cq = static_cast<char*>(mCq);
+        mCqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        mCqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        mCqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        mCqes   = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+        // With the buffer registered, the kernel pins its pages once,
+        // rather than on every read. It may refuse, for example over
+        // RLIMIT_MEMLOCK, and then plain reads do.
+        iovec vec { buffer, bufferSize };
+        mFixed = ::syscall(__NR_io_uring_register, mRing,
+                           IORING_REGISTER_BUFFERS, &vec, 1) == 0;
+    }
+
+    void release() {
+        if (mSqes)
+            ::munmap(mSqes, mSqesSize);
+        if (mCq && mCq != mSq)
+            ::munmap(mCq, mCqSize);
+        if (mSq)
+            ::munmap(mSq, mSqSize);
+        if (mRing >= 0)
+            ::close(mRing);
+
+        mSqes = nullptr;
+        mSq = mCq = nullptr;
+        mRing = -1;
+    }
+
+    void* map(std::size_t size, std::uint64_t offset) {
+        void* addr = ::mmap(0, size, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, mRing, offset);
+        if (addr == MAP_FAILED)
+            throw std::system_error(errno, std::system_category(),
+                                    "io_uring mmap");
+        return addr;
+    }
+
+    void push(unsigned tag) {
+        Request const& request = mRequests[tag];
+
+        unsigned tail = *mSqTail;
+        unsigned index = tail & *mSqMask;
+
+        io_uring_sqe& sqe = mSqes[index];
+        sqe = io_uring_sqe {};
+        sqe.opcode    = mFixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+        sqe.fd        = mFd;
+        sqe.addr      = reinterpret_cast<std::uint64_t>(request.dest
+                                                        + request.done);
+        sqe.len       = request.length - request.done;
+        sqe.off       = request.offset + request.done;
+        sqe.buf_index = 0;
+        sqe.user_data = tag;
+
+        mSqArray[index] = index;
+        __atomic_store_n(mSqTail, tail + 1, __ATOMIC_RELEASE);
+
+        while (::syscall(__NR_io_uring_enter, mRing, 1, 0, 0, nullptr, 0) < 0)
+            if (errno != EINTR && errno != EAGAIN)
+                throw std::system_error(errno, std::system_category(),
+                                        "io_uring_enter");
+    }
+
+    io_uring_cqe pop() {
+        while (1) {
+            unsigned head = *mCqHead;
+            if (head != __atomic_load_n(mCqTail, __ATOMIC_ACQUIRE)) {
+                io_uring_cqe cqe = mCqes[head & *mCqMask];
+                __atomic_store_n(mCqHead, head + 1, __ATOMIC_RELEASE);
+                return cqe;
+            }
+
+            if (::syscall(__NR_io_uring_enter, mRing, 0, 1,
+                          IORING_ENTER_GETEVENTS, nullptr, 0) < 0
+                    && errno != EINTR)
+                throw std::system_error(errno, std::system_category(),
+                                        "io_uring_enter");
+        }
+    }
+
+    std::vector<Request> mRequests;
+    bool mFixed = false;
+
+    int    mRing = -1;
+    void  *mSq = nullptr, *mCq = nullptr;
+    std::size_t mSqSize = 0, mCqSize = 0, mSqesSize = 0;
+    io_uring_sqe* mSqes = nullptr;
+    io_uring_cqe* mCqes = nullptr;
+
+    unsigned *mSqTail, *mSqMask, *mSqArray;
+    unsigned *mCqHead, *mCqTail, *mCqMask;
+};
+
+/*
+ * The fallback: a few threads, started once, doing blocking 'pread()'
+ * calls off a queue. It's as many reads in flight as there are threads.
+ */
+class PreadReader: public BlockReader {
+public:
+
+    PreadReader(int fd, bool direct, std::string const& filename,
+                unsigned depth)
+        : BlockReader(fd, direct, filename) {
+
+        for (unsigned k = 0; k < depth; ++k)
+            mThreads.emplace_back(&PreadReader::work, this);
+    }
+
+    ~PreadReader() {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStop = true;
+        }
+        mWake.notify_all();
+
+        for (auto& thread: mThreads)
+            thread.join();
+    }
+
+    void submit(unsigned tag, char* dest, std::size_t length,
+                std::uint64_t offset) override {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mQueue.push_back(Request{tag, dest, length, offset});
+        }
+        mWake.notify_one();
+    }
+
+    Completion wait() override {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mDone.wait(lock, [this]{ return !mCompleted.empty(); });
+
+        Result result = mCompleted.front();
+        mCompleted.pop_front();
+
+        if (result.error != 0)
+            throw std::system_error(result.error, std::system_category(),
+                                    mFilename);
+
+        return result.completion;
+    }
+
+    char const* name() const override { return "pread"; }
+
+private:
+
+    struct Request {
+        unsigned      tag;
+        char*         dest;
+        std::size_t   length;
+        std::uint64_t offset;
+    };
+
+    struct Result {
+        Completion completion;
+        int        error;
+    };
+
+    void work() {
+        while (1) {
+            Request request;
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+                mWake.wait(lock, [this]{ return mStop || !mQueue.empty(); });
+                if (mStop)
+                    return;
+
+                request = mQueue.front();
+                mQueue.pop_front();
+            }
+
+            std::size_t done = 0;
+            int error = 0;
+            while (done < request.length) {
+                ssize_t got = ::pread(mFd, request.dest + done,
+                                      request.length - done,
+                                      request.offset + done);
+                if (got < 0 && errno == EINTR)
+                    continue;
+                if (got < 0)
+                    error = errno;
+                if (got <= 0)
+                    break;
+                done += got;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mCompleted.push_back(Result{{request.tag, done}, error});
+            }
+            mDone.notify_one();
+        }
+    }
+
+    std::mutex mMutex;
+    std::condition_variable mWake;
+    std::condition_variable mDone;
+    std::deque<Request> mQueue;
+    std::deque<Result>  mCompleted;
+    bool mStop = false;
+
+    std::vector<std::thread> mThreads;
+};
+
+/*
+ * Opens 'filename' for reading, with O_DIRECT if 'direct' is set and the
+ * filesystem allows it. 'direct' tells whether it has.
+ */
+int openFile(std::string const& filename, bool& direct) {
+    int fd = -1;
+
+    // Some filesystems, tmpfs for one, refuse O_DIRECT, then the page
+    // cache it is.
+    if (direct)
+        fd = ::open(filename.c_str(), O_RDONLY | O_DIRECT, 0);
+    if (fd == -1) {
+        direct = false;
+        fd = ::open(filename.c_str(), O_RDONLY, 0);
+    }
+    if (fd == -1)
+        throw std::system_error(errno, std::system_category(), filename);
+
+    return fd;
+}
+
+} // namespace
+
+BlockReader::~BlockReader() {
+    if (mFd != -1)
+        ::close(mFd);
+}
+
+void BlockReader::reopen(std::string const& filename,
+                         ReaderOptions const& options) {
+    if (mFd != -1)
+        ::close(mFd);
+
+    mFd = -1;
+    mFilename = filename;
+    mDirect = options.direct;
+    mFd = openFile(filename, mDirect);
+}
+
+std::unique_ptr<BlockReader> BlockReader::open(std::string const& filename,
+                                               char* buffer,
+                                               std::size_t bufferSize,
+                                               unsigned depth,
+                                               ReaderOptions const& options) {
+    bool direct = options.direct;
+    int fd = openFile(filename, direct);
+
+    // From here on, the reader owns the descriptor, even if it throws.
+    bool uring = options.backend == ReaderOptions::Uring
+              || (options.backend == ReaderOptions::Auto
+                  && UringReader::available());
+    if (uring) {
+        return std::unique_ptr<BlockReader>(new UringReader(
+                   fd, direct, filename, buffer, bufferSize, depth));
+    }
+
+    return std::unique_ptr<BlockReader>(
+               new PreadReader(fd, direct, filename, depth));
+}
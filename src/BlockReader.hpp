@@ -0,0 +1,85 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <boost/noncopyable.hpp>
+
+/*
+ * How a 'BlockReader' talks to the kernel.
+ */
+struct ReaderOptions {
+    enum Backend { Auto, Uring, Pread };
+
+    // 'Auto' tries io_uring first, and quietly falls back to a pool of
+    // threads doing 'pread()' if the kernel doesn't have it, or doesn't
+    // let this process use it.
+    Backend backend = Auto;
+
+    // Bypass the page cache with O_DIRECT, where the filesystem allows.
+    // Then offsets, lengths and buffers must be aligned to 'alignment()'.
+    bool direct = false;
+};
+
+/*
+ * Reads blocks of a file into a single buffer given up front, with several
+ * reads in flight at once. Reads are submitted with a tag, and completions
+ * come back in whatever order the device finishes them. A read is only
+ * completed in full, or when the file is over, so a completion with fewer
+ * bytes than asked for means the end of the file.
+ */
+class BlockReader: public boost::noncopyable {
+public:
+
+    struct Completion {
+        unsigned    tag;
+        std::size_t length;
+    };
+
+    /*
+     * Opens 'filename' for reads into [buffer, buffer+bufferSize), at most
+     * 'depth' of them in flight. Throws 'std::system_error' if the file
+     * can't be opened.
+     */
+    static std::unique_ptr<BlockReader> open(std::string const& filename,
+                                             char* buffer,
+                                             std::size_t bufferSize,
+                                             unsigned depth,
+                                             ReaderOptions const& options);
+
+    virtual ~BlockReader();
+
+    /*
+     * Switches to reading 'filename', keeping the buffer, and the threads
+     * or the ring, so another file costs no more than opening it. Nothing
+     * may be in flight. Throws 'std::system_error' if the file can't be
+     * opened, and then the reader is good for nothing but another try.
+     */
+    void reopen(std::string const& filename, ReaderOptions const& options);
+
+    // Starts reading 'length' bytes at 'offset' into 'dest', which must
+    // be inside the buffer. The tag is below 'depth', and isn't reused
+    // until its read has completed.
+    virtual void submit(unsigned tag, char* dest, std::size_t length,
+                        std::uint64_t offset) = 0;
+
+    // Waits until some read completes, and throws 'std::system_error'
+    // if it has failed.
+    virtual Completion wait() = 0;
+
+    virtual char const* name() const = 0;
+
+    // What O_DIRECT wants offsets, lengths and addresses aligned to, one
+    // without it.
+    std::size_t alignment() const { return mDirect ? DirectAlignment : 1; }
+
+    static const std::size_t DirectAlignment = 4096;
+
+protected:
+
+    BlockReader(int fd, bool direct, std::string const& filename)
+        : mFd(fd), mDirect(direct), mFilename(filename) {}
+
+    int  mFd;
+    bool mDirect;
+    std::string mFilename;
+};
@@ -0,0 +1,160 @@
+#include "Checkpoint.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <ios>
+#include <limits>
+#include <stdexcept>
+#include "InputStream.hpp"
+#include "PartialResult.hpp"
+#include "Report.hpp"
+
+extern "C" {
+    #include <sys/stat.h>
+}
+
+namespace {
+
+// A checkpoint is taken after a step of about that many bytes at most.
+const std::uint64_t CheckpointStep = 1024*1024*1024;
+
+/*
+ * Hashes whatever decides what a scan counts, so that a checkpoint is
+ * never resumed with other inputs or other patterns. A file rewritten to
+ * the same size still has another modification time.
+ */
+std::uint64_t fingerprintOf(std::vector<InputFile> const& inputs,
+                            ScanConfig const& config) {
+    std::string text;
+    for (auto const& input: inputs) {
+        text += input.path + '\0' + std::to_string(input.size) + '\0';
+
+        struct stat inputStat;
+        if (::stat(input.path.c_str(), &inputStat) == 0) {
+            text += std::to_string(inputStat.st_mtim.tv_sec) + '.'
+                  + std::to_string(inputStat.st_mtim.tv_nsec) + '\0';
+        }
+    }
+
+    text += "d=" + std::to_string(config.distinctPrecision) + '\0';
+    text += "t=" + std::to_string(config.keepTop) + '\0';
+    for (std::size_t k = 1; config.patterns && k < config.patterns->size();
+         ++k)
+        text += "x=" + (*config.patterns)[k].title + '\0';
+
+    return hashBytes(text);
+}
+
+/*
+ * Adds the counters of a checkpoint to 'result'. A snapshot whose totals
+ * don't fit the counters is refused rather than wrapped around.
+ */
+void loadCheckpoint(PartialResultFile const& snapshot, ScanResult& result) {
+    auto addTotal = [&](std::uint64_t& counter, std::uint64_t total) {
+        if (total > std::numeric_limits<std::uint64_t>::max() - counter)
+            throw std::invalid_argument(snapshot.filename()
+                                        + ": the counts overflow");
+        counter += total;
+    };
+
+    for (auto const& table: snapshot.tables()) {
+        if (table.kind == PartialKind::Domains) {
+            result.urlDomains.load(snapshot, table);
+            addTotal(result.numMatches, table.total);
+        } else if (table.kind == PartialKind::Paths) {
+            result.urlPaths.load(snapshot, table);
+        } else {
+            for (std::size_t k = 0; k < result.extraKeys.size(); ++k) {
+                if ((*result.patterns)[k+1].title != table.name.str())
+                    continue;
+                result.extraKeys[k].load(snapshot, table);
+                addTotal(result.extraMatches[k], table.total);
+            }
+        }
+    }
+}
+
+} // namespace
+
+ScanResult scanInputsCheckpointed(ThreadPool& pool, ScanConfig const& config,
+                                  std::vector<InputFile> const& inputs,
+                                  InputOptions const& options,
+                                  CheckpointOptions const& checkpoint) {
+
+    using Clock = std::chrono::steady_clock;
+
+    ScanResult total(config);
+    ScanProgress progress {fingerprintOf(inputs, config), 0, 0};
+
+    struct stat snapshotStat;
+    if (checkpoint.resume
+            && ::stat(checkpoint.filename.c_str(), &snapshotStat) == 0) {
+        PartialResultFile snapshot(checkpoint.filename);
+        if (!snapshot.hasProgress()
+                || snapshot.progress().fingerprint != progress.fingerprint
+                || snapshot.progress().inputIndex > inputs.size())
+            throw std::invalid_argument(checkpoint.filename +
+                ": not a checkpoint of a scan of these inputs");
+
+        loadCheckpoint(snapshot, total);
+        progress = snapshot.progress();
+    }
+
+    std::uint64_t stepSize = std::max<std::uint64_t>(CheckpointStep,
+                                                     pool.size() * 64*1024*1024);
+    auto lastSave = Clock::now();
+
+    while (progress.inputIndex < inputs.size()) {
+        InputFile const& input = inputs[progress.inputIndex];
+        bool isRegular = input.regular && input.size > 0
+                      && detectCompression(input.path) == Compression::None;
+
+        if (isRegular && input.size > stepSize) {
+            std::uint64_t end = input.size;
+            if (input.size - progress.offset > stepSize) {
+                std::ifstream stream(input.path, std::ios_base::binary);
+                end = findChunkStart(stream, syncFuncOf(config),
+                                     progress.offset + stepSize, input.size);
+            }
+
+            scanFileBuffered(pool, config, input.path, progress.offset, end,
+                             pool.size(), options.reading, total);
+            progress.offset = end;
+            if (end == input.size) {
+                ++progress.inputIndex;
+                progress.offset = 0;
+            }
+        } else {
+            // Small files, up to the next large one, the size of a step.
+            std::vector<InputFile> batch;
+            std::uint64_t batchSize = 0;
+            for (std::size_t k = progress.inputIndex; k < inputs.size(); ++k) {
+                if (!batch.empty() && (inputs[k].size > stepSize
+                        || batchSize + inputs[k].size > stepSize))
+                    break;
+                batch.push_back(inputs[k]);
+                batchSize += inputs[k].size;
+            }
+
+            scanInputs(pool, config, batch, options, total);
+            progress.inputIndex += batch.size();
+        }
+
+        if (progress.inputIndex < inputs.size()
+                && Clock::now() - lastSave
+                       >= std::chrono::seconds(checkpoint.interval)) {
+            // Renamed, so that a job killed while saving still has the
+            // checkpoint before.
+            std::string tempFn = checkpoint.filename + ".tmp";
+            writePartial(tempFn, total, &progress);
+            if (std::rename(tempFn.c_str(), checkpoint.filename.c_str()) != 0)
+                throw std::ios_base::failure(checkpoint.filename);
+
+            lastSave = Clock::now();
+        }
+    }
+
+    return total;
+}
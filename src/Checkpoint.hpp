@@ -0,0 +1,33 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "InputFiles.hpp"
+#include "ScanResult.hpp"
+#include "Scanner.hpp"
+#include "ThreadPool.hpp"
+
+/*
+ * How often, and where to, a long scan saves what it has done so far.
+ */
+struct CheckpointOptions {
+    std::string filename;       // No checkpoints if it's empty.
+    unsigned interval = 60;     // Seconds.
+    bool resume = false;        // Go on from the checkpoint, if there's one.
+};
+
+/*
+ * The same as 'scanInputs', but done by steps, and every 'interval' seconds
+ * the counters and the place to go on from are saved to a checkpoint. When
+ * a scan is resumed, it picks up where the checkpoint says, and the final
+ * result is the same as if it had never stopped.
+ *
+ * A step ends at a byte which can't be a part of a match, just like
+ * a chunk does, so nothing which was in the ring buffers has to be saved.
+ * A step is either a run of small files, scanned all at once as usual, or
+ * a piece of a large file, scanned by all the workers. Compressed files
+ * can only be read from the beginning, so a step never ends inside one.
+ */
+ScanResult scanInputsCheckpointed(ThreadPool& pool, ScanConfig const& config,
+                                  std::vector<InputFile> const& inputs,
+                                  InputOptions const& options,
+                                  CheckpointOptions const& checkpoint);
@@ -0,0 +1,616 @@
+#include "DfaRegex.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <map>
+
+using std::regex_error;
+namespace rc = std::regex_constants;
+
+/*
+ * A parsed pattern. Counted repetitions are not supported, so the tree
+ * is compiled into the NFA program directly, without any rewriting.
+ */
+struct DfaRegex::Node {
+    enum Kind { Empty, Set, Concat, Alternate, Optional, Star, Plus, Group };
+
+    Kind kind;
+    unsigned arg;   // Set index for 'Set', group number for 'Group'.
+    std::vector<Node> children;
+};
+
+/*
+ * A recursive descent parser for the supported subset. Character sets are
+ * registered in the regex right away, so the tree only refers to them.
+ */
+class DfaRegex::Parser {
+public:
+
+    Parser(char const* pattern, bool icase, DfaRegex& rex)
+        : mPos(pattern)
+        , mIcase(icase)
+        , mRex(rex)
+        {}
+
+    Node parse() {
+        Node node = parseAlternation();
+        if (*mPos == ')')
+            throw regex_error(rc::error_paren);
+
+        return node;
+    }
+
+private:
+
+    using CharSet = std::bitset<256>;
+
+    Node parseAlternation() {
+        Node node {Node::Alternate, 0, {parseConcat()}};
+        while (*mPos == '|') {
+            ++mPos;
+            node.children.push_back(parseConcat());
+        }
+
+        if (node.children.size() == 1)
+            return node.children[0];
+        return node;
+    }
+
+    Node parseConcat() {
+        Node node {Node::Concat, 0, {}};
+        while (*mPos != '\0' && *mPos != '|' && *mPos != ')')
+            node.children.push_back(parseRepeat());
+
+        if (node.children.empty())
+            return Node {Node::Empty, 0, {}};
+        if (node.children.size() == 1)
+            return node.children[0];
+        return node;
+    }
+
+    Node parseRepeat() {
+        Node node = parseAtom();
+
+        Node::Kind kind;
+        switch (*mPos) {
+            case '?': kind = Node::Optional; break;
+            case '*': kind = Node::Star;     break;
+            case '+': kind = Node::Plus;     break;
+            case '{': throw regex_error(rc::error_badbrace);
+            default:  return node;
+        }
+
+        // Lazy quantifiers would need the other priority order, and
+        // a quantifier can't be quantified in ECMAScript anyway.
+        if (std::strchr("?*+{", *++mPos) && *mPos != '\0')
+            throw regex_error(rc::error_badrepeat);
+
+        return Node {kind, 0, {node}};
+    }
+
+    Node parseAtom() {
+        char ch = *mPos++;
+        switch (ch) {
+            case '(':
+                return parseGroup();
+
+            case '[':
+                return makeSet(parseBracket());
+
+            case '.': {
+                CharSet set;
+                set.set();
+                set.reset('\n');
+                set.reset('\r');
+                return makeSet(set);
+            }
+
+            case '\\':
+                return makeSet(parseEscape());
+
+            case '*': case '+': case '?':
+                throw regex_error(rc::error_badrepeat);
+
+            case '{':
+                throw regex_error(rc::error_badbrace);
+
+            // Assertions can't be expressed by a plain DFA.
+            case '^': case '$':
+                throw regex_error(rc::error_complexity);
+
+            default: {
+                CharSet set;
+                set.set((unsigned char)ch);
+                return makeSet(set);
+            }
+        }
+    }
+
+    Node parseGroup() {
+        bool capturing = true;
+        if (mPos[0] == '?') {
+            if (mPos[1] != ':')
+                throw regex_error(rc::error_complexity);
+
+            capturing = false;
+            mPos += 2;
+        }
+
+        unsigned group = capturing ? mRex.mNumGroups++ : 0;
+        Node inner = parseAlternation();
+        if (*mPos++ != ')')
+            throw regex_error(rc::error_paren);
+
+        if (!capturing)
+            return inner;
+        return Node {Node::Group, group, {inner}};
+    }
+
+    CharSet parseBracket() {
+        CharSet set;
+        bool negate = *mPos == '^';
+        if (negate)
+            ++mPos;
+
+        while (*mPos != ']') {
+            if (*mPos == '\0')
+                throw regex_error(rc::error_brack);
+
+            bool isClass = false;
+            CharSet first = parseBracketAtom(isClass);
+
+            if (mPos[0] == '-' && mPos[1] != ']' && mPos[1] != '\0') {
+                ++mPos;
+                bool lastIsClass = false;
+                CharSet last = parseBracketAtom(lastIsClass);
+                if (isClass || lastIsClass)
+                    throw regex_error(rc::error_range);
+
+                unsigned from = firstByte(first);
+                unsigned to   = firstByte(last);
+                if (from > to)
+                    throw regex_error(rc::error_range);
+
+                for (unsigned b = from; b <= to; ++b)
+                    set.set(b);
+            } else {
+                set |= first;
+            }
+        }
+
+        ++mPos;
+
+        // Case folding goes before the negation, just like in ECMAScript.
+        set = foldCase(set);
+        return negate ? ~set : set;
+    }
+
+    CharSet parseBracketAtom(bool& isClass) {
+        char ch = *mPos++;
+        if (ch != '\\') {
+            CharSet set;
+            set.set((unsigned char)ch);
+            return set;
+        }
+
+        // Inside brackets, "\b" is a backspace, not a word boundary.
+        if (*mPos == 'b') {
+            ++mPos;
+            CharSet set;
+            set.set('\b');
+            return set;
+        }
+
+        isClass = std::strchr("dDwWsS", *mPos) != nullptr && *mPos != '\0';
+        return parseEscape();
+    }
+
+    CharSet parseEscape() {
+        char ch = *mPos++;
+        CharSet set;
+
+        auto addRange = [&set](char from, char to) {
+            for (unsigned b = (unsigned char)from; b <= (unsigned char)to; ++b)
+                set.set(b);
+        };
+
+        switch (ch) {
+            case 'd': case 'D':
+                addRange('0', '9');
+                break;
+
+            case 'w': case 'W':
+                addRange('0', '9');
+                addRange('A', 'Z');
+                addRange('a', 'z');
+                set.set('_');
+                break;
+
+            case 's': case 'S':
+                for (char space: std::string(" \t\n\v\f\r"))
+                    set.set((unsigned char)space);
+                break;
+
+            case 'n': set.set('\n'); return set;
+            case 'r': set.set('\r'); return set;
+            case 't': set.set('\t'); return set;
+            case 'f': set.set('\f'); return set;
+            case 'v': set.set('\v'); return set;
+            case '0': set.set('\0'); return set;
+
+            case 'x': {
+                unsigned value = 0;
+                for (int i = 0; i < 2; ++i) {
+                    char digit = *mPos++;
+                    if (!std::isxdigit((unsigned char)digit))
+                        throw regex_error(rc::error_escape);
+
+                    value = value * 16 + (std::isdigit((unsigned char)digit)
+                        ? digit - '0'
+                        : std::tolower((unsigned char)digit) - 'a' + 10);
+                }
+                set.set(value);
+                return set;
+            }
+
+            case '\0':
+                throw regex_error(rc::error_escape);
+
+            default:
+                // Backreferences and boundaries are out of reach of a DFA,
+                // and the other letters are reserved.
+                if (std::isdigit((unsigned char)ch))
+                    throw regex_error(rc::error_backref);
+                if (std::isalpha((unsigned char)ch))
+                    throw regex_error(rc::error_escape);
+
+                set.set((unsigned char)ch);
+                return set;
+        }
+
+        return std::isupper((unsigned char)ch) ? ~set : set;
+    }
+
+    CharSet foldCase(CharSet set) const {
+        if (!mIcase)
+            return set;
+
+        for (unsigned b = 'A'; b <= 'Z'; ++b) {
+            if (set[b] || set[b + 'a' - 'A']) {
+                set.set(b);
+                set.set(b + 'a' - 'A');
+            }
+        }
+
+        return set;
+    }
+
+    static unsigned firstByte(CharSet const& set) {
+        for (unsigned b = 0; b < 256; ++b) {
+            if (set[b])
+                return b;
+        }
+        return 0;
+    }
+
+    Node makeSet(CharSet const& set) {
+        mRex.mSets.push_back(mIcase ? foldCase(set) : set);
+        return Node {Node::Set, unsigned(mRex.mSets.size() - 1), {}};
+    }
+
+    char const* mPos;
+    bool mIcase;
+    DfaRegex& mRex;
+};
+
+/*
+ * Threads of the Pike VM: their instructions in priority order, and the
+ * slots of every thread, stored by its instruction. An instruction has
+ * been visited in this step if it's marked with the current generation,
+ * so the list is cleared without touching the marks.
+ */
+struct DfaRegex::Threads {
+    std::vector<unsigned>    pcs;
+    std::vector<unsigned>    visited;
+    std::vector<std::size_t> slots;
+    unsigned generation;
+
+    Threads(std::size_t programSize, std::size_t numSlots)
+        : visited(programSize, 0)
+        , slots(programSize * numSlots)
+        , generation(1)
+        {}
+
+    void clear() {
+        pcs.clear();
+        ++generation;
+    }
+};
+
+DfaRegex::DfaRegex(char const* pattern, flag_type flags)
+    : mNumGroups(1) {
+
+    if (flags & (rc::basic | rc::extended | rc::awk | rc::grep | rc::egrep))
+        throw regex_error(rc::error_complexity);
+
+    Node root = Parser(pattern, (flags & rc::icase) != 0, *this).parse();
+
+    emit(Save, 0);
+    compile(root);
+    emit(Save, 1);
+    emit(Match);
+
+    buildByteClasses();
+    buildDfa();
+}
+
+unsigned DfaRegex::emit(Opcode op, unsigned arg) {
+    unsigned pc = mProgram.size();
+    mProgram.push_back(Inst {op, arg, pc + 1, 0});
+    return pc;
+}
+
+void DfaRegex::compile(Node const& node) {
+    switch (node.kind) {
+        case Node::Empty:
+            break;
+
+        case Node::Set:
+            emit(Byte, node.arg);
+            break;
+
+        case Node::Concat:
+            for (Node const& child: node.children)
+                compile(child);
+            break;
+
+        case Node::Alternate: {
+            std::vector<unsigned> jumps;
+            for (std::size_t i = 0; i + 1 < node.children.size(); ++i) {
+                unsigned split = emit(Split);
+                compile(node.children[i]);
+                jumps.push_back(emit(Jump));
+                mProgram[split].alt = mProgram.size();
+            }
+
+            compile(node.children.back());
+            for (unsigned jump: jumps)
+                mProgram[jump].next = mProgram.size();
+            break;
+        }
+
+        case Node::Optional: {
+            unsigned split = emit(Split);
+            compile(node.children[0]);
+            mProgram[split].alt = mProgram.size();
+            break;
+        }
+
+        case Node::Star: {
+            unsigned split = emit(Split);
+            compile(node.children[0]);
+            unsigned jump = emit(Jump);
+            mProgram[jump].next = split;
+            mProgram[split].alt = mProgram.size();
+            break;
+        }
+
+        case Node::Plus: {
+            unsigned body = mProgram.size();
+            compile(node.children[0]);
+            unsigned split = emit(Split);
+            mProgram[split].next = body;
+            mProgram[split].alt  = split + 1;
+            break;
+        }
+
+        case Node::Group:
+            emit(Save, 2 * node.arg);
+            compile(node.children[0]);
+            emit(Save, 2 * node.arg + 1);
+            break;
+    }
+}
+
+void DfaRegex::buildByteClasses() {
+
+    // Every set splits each of the current classes in two: the bytes which
+    // are in the set, and those which aren't.
+    mByteClass.fill(0);
+    mNumClasses = 1;
+
+    for (auto const& set: mSets) {
+        std::array<int, 512> renumber;
+        renumber.fill(-1);
+
+        std::size_t numClasses = 0;
+        for (unsigned b = 0; b < 256; ++b) {
+            int& cls = renumber[mByteClass[b] * 2 + set[b]];
+            if (cls < 0)
+                cls = numClasses++;
+
+            mByteClass[b] = cls;
+        }
+
+        mNumClasses = numClasses;
+    }
+}
+
+bool DfaRegex::follow(unsigned pc, std::vector<unsigned>& list,
+                      std::vector<bool>& seen, bool allowMatch) const {
+    if (seen[pc])
+        return false;
+
+    seen[pc] = true;
+    Inst const& inst = mProgram[pc];
+    switch (inst.op) {
+        case Byte:
+            list.push_back(pc);
+            return false;
+
+        case Match:
+            if (!allowMatch)
+                return false;
+
+            list.push_back(pc);
+            return true;
+
+        case Split:
+            return follow(inst.next, list, seen, allowMatch)
+                || follow(inst.alt,  list, seen, allowMatch);
+
+        case Jump:
+        case Save:
+            return follow(inst.next, list, seen, allowMatch);
+    }
+
+    return false;
+}
+
+void DfaRegex::buildDfa() {
+
+    // A pattern which explodes into this many states is either a mistake,
+    // or something this engine isn't meant for.
+    const std::size_t maxStates = 10000;
+
+    // The class representatives, to check the sets against.
+    std::vector<unsigned> sample(mNumClasses);
+    for (unsigned b = 256; b-- > 0; )
+        sample[mByteClass[b]] = b;
+
+    std::vector<std::vector<unsigned>> states;
+    std::map<std::vector<unsigned>, std::uint32_t> known;
+
+    auto lookup = [&](std::vector<unsigned> const& list) -> std::uint32_t {
+        auto found = known.find(list);
+        if (found != known.end())
+            return found->second;
+
+        if (states.size() >= maxStates)
+            throw regex_error(rc::error_complexity);
+
+        std::uint32_t state = states.size() * mNumClasses;
+        if (!list.empty() && mProgram[list.back()].op == Match)
+            state |= Accepting;
+
+        known.emplace(list, state);
+        states.push_back(list);
+        return state;
+    };
+
+    std::vector<bool> seen(mProgram.size());
+    std::vector<unsigned> list;
+
+    lookup(list);
+
+    follow(0, list, seen);
+    mStart = lookup(list);
+
+    list.clear();
+    std::fill(seen.begin(), seen.end(), false);
+    follow(0, list, seen, false);
+    mStartNotNull = lookup(list);
+
+    // States are appended as they're discovered, and every one of them
+    // gets its row of transitions in turn.
+    for (std::size_t idx = 0; idx < states.size(); ++idx) {
+        for (std::size_t cls = 0; cls < mNumClasses; ++cls) {
+            std::fill(seen.begin(), seen.end(), false);
+            list.clear();
+
+            for (unsigned pc: states[idx]) {
+                Inst const& inst = mProgram[pc];
+                if (inst.op == Byte && mSets[inst.arg][sample[cls]]) {
+                    if (follow(inst.next, list, seen))
+                        break;
+                }
+            }
+
+            std::uint32_t next = lookup(list);
+            mTransitions.resize(states.size() * mNumClasses);
+            mTransitions[idx * mNumClasses + cls] = next;
+        }
+    }
+
+    mNumStates = states.size();
+
+    for (unsigned b = 0; b < 256; ++b)
+        mFirstBytes[b] = mTransitions[(mStart & ~Accepting)
+                                      + mByteClass[b]] != 0;
+
+    mMatchesEmpty = (mStart & Accepting) != 0;
+}
+
+void DfaRegex::addThread(Threads& threads, unsigned pc, std::size_t pos,
+                         std::size_t* slots) const {
+    if (threads.visited[pc] == threads.generation)
+        return;
+
+    threads.visited[pc] = threads.generation;
+    Inst const& inst = mProgram[pc];
+    switch (inst.op) {
+        case Byte:
+        case Match: {
+            std::size_t numSlots = 2 * mNumGroups;
+            threads.pcs.push_back(pc);
+            std::copy(slots, slots + numSlots,
+                      threads.slots.begin() + pc * numSlots);
+            break;
+        }
+
+        case Split:
+            addThread(threads, inst.next, pos, slots);
+            addThread(threads, inst.alt,  pos, slots);
+            break;
+
+        case Jump:
+            addThread(threads, inst.next, pos, slots);
+            break;
+
+        case Save: {
+            std::size_t saved = slots[inst.arg];
+            slots[inst.arg] = pos;
+            addThread(threads, inst.next, pos, slots);
+            slots[inst.arg] = saved;
+            break;
+        }
+    }
+}
+
+void DfaRegex::captureSlots(unsigned char const* data, std::size_t size,
+                            bool notNull,
+                            std::vector<std::size_t>& slots) const {
+    std::size_t numSlots = 2 * mNumGroups;
+    slots.assign(numSlots, std::string::npos);
+
+    Threads current(mProgram.size(), numSlots);
+    Threads next(mProgram.size(), numSlots);
+    std::vector<std::size_t> scratch(slots);
+
+    addThread(current, 0, 0, scratch.data());
+
+    // The DFA has already proven that the best match ends at 'size', so
+    // the VM only has to get there the same way.
+    for (std::size_t pos = 0; pos <= size && !current.pcs.empty(); ++pos) {
+        for (unsigned pc: current.pcs) {
+            Inst const& inst = mProgram[pc];
+            std::size_t* threadSlots = &current.slots[pc * numSlots];
+
+            if (inst.op == Match) {
+                if (pos == 0 && notNull)
+                    continue;
+
+                slots.assign(threadSlots, threadSlots + numSlots);
+                break;
+            }
+
+            if (pos < size && mSets[inst.arg][data[pos]]) {
+                scratch.assign(threadSlots, threadSlots + numSlots);
+                addThread(next, inst.next, pos + 1, scratch.data());
+            }
+        }
+
+        std::swap(current, next);
+        next.clear();
+    }
+}
@@ -0,0 +1,318 @@
+#pragma once
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <iterator>
+#include <regex>
+#include <string>
+#include <utility>
+#include <vector>
+
+template <typename It>
+class DfaMatch;
+
+/*
+ * A small regular expression engine for the subset of the ECMAScript
+ * syntax which is actually needed here: literals and escapes, '.', bracket
+ * classes, alternation, groups, and greedy '?', '*' and '+'. Anything else
+ * is rejected with 'std::regex_error', so that a pattern never silently
+ * means something else. The only flag supported is 'icase'.
+ *
+ * 'std::regex' is a backtracking engine, and a slow one. This one compiles
+ * the pattern into a DFA ahead of time, and runs the search in two passes:
+ *
+ *   1. The DFA is run from every byte which can start a match, and finds
+ *      where the match ends. A DFA state is an ordered list of NFA threads,
+ *      and the threads which have lower priority than a matching one are
+ *      dropped, so the match is exactly the one a backtracking engine would
+ *      have found (leftmost, then first by priority).
+ *
+ *   2. Only the matched span is then run through a Pike VM, which tracks
+ *      the submatches of the same threads in the same order.
+ *
+ * The first pass touches every byte of the input, and the second pass only
+ * touches matches, which are rare. Just like with a backtracking engine,
+ * a pattern like "a*b" over a long run of 'a' takes quadratic time.
+ *
+ * A loop whose body can match an empty string, like "(a?|b)*", follows
+ * ECMAScript: an empty iteration fails and the next alternative is tried.
+ * libstdc++ stops such a loop instead, so there the results may differ.
+ */
+class DfaRegex {
+public:
+
+    using flag_type = std::regex_constants::syntax_option_type;
+
+    explicit DfaRegex(char const* pattern,
+                      flag_type flags = std::regex_constants::ECMAScript);
+
+    explicit DfaRegex(std::string const& pattern,
+                      flag_type flags = std::regex_constants::ECMAScript)
+        : DfaRegex(pattern.c_str(), flags) {}
+
+    // Number of capture groups, not counting the whole match.
+    std::size_t mark_count() const { return mNumGroups - 1; }
+
+    std::size_t numStates() const { return mNumStates; }
+
+    /*
+     * Finds the first match in [first, last), and returns 'false' if there
+     * is none. Group 0 is the whole match, groups which didn't participate
+     * in it are empty ranges at its end.
+     */
+    template <typename It>
+    bool search(It first, It last, DfaMatch<It>& match) const;
+
+    /*
+     * Matches at 'start' only. If 'notNull' is set, an empty match doesn't
+     * count, and a non-empty one of lower priority is looked for instead,
+     * like 'std::regex_iterator' does after an empty match.
+     */
+    template <typename It>
+    bool matchAt(It start, It last, DfaMatch<It>& match,
+                 bool notNull = false) const;
+
+private:
+
+    enum Opcode: std::uint8_t { Byte, Split, Jump, Save, Match };
+
+    // A Thompson NFA instruction. 'Byte' consumes a byte from set 'arg',
+    // 'Split' continues at 'next' first and at 'alt' second, 'Jump' goes
+    // to 'next', and 'Save' stores the position into slot 'arg'.
+    struct Inst {
+        Opcode   op;
+        unsigned arg;
+        unsigned next;
+        unsigned alt;
+    };
+
+    struct Node;
+    class Parser;
+
+    void compile(Node const& node);
+    unsigned emit(Opcode op, unsigned arg = 0);
+    void buildByteClasses();
+    void buildDfa();
+
+    template <typename It>
+    bool matchEnd(It start, It last, bool notNull, It& end) const;
+
+    template <typename It>
+    void capture(It start, It end, bool notNull, DfaMatch<It>& match) const;
+
+    // Runs the Pike VM over a span known to be the match, and stores the
+    // offsets of the groups' bounds into 'slots', 'npos' for missing ones.
+    void captureSlots(unsigned char const* data, std::size_t size,
+                      bool notNull, std::vector<std::size_t>& slots) const;
+
+    struct Threads;
+    void addThread(Threads& threads, unsigned pc, std::size_t pos,
+                   std::size_t* slots) const;
+
+    // Appends the instructions reachable from 'pc' without consuming
+    // a byte to 'list' in priority order, and returns 'true' as soon as
+    // 'Match' is reached: whatever comes after it can't win anymore.
+    // Unless 'Match' isn't allowed, then it's simply skipped.
+    bool follow(unsigned pc, std::vector<unsigned>& list,
+                std::vector<bool>& seen, bool allowMatch = true) const;
+
+    static unsigned char const* spanData(char const* begin, char const*,
+                                         std::string&) {
+        return reinterpret_cast<unsigned char const*>(begin);
+    }
+
+    template <typename It>
+    static unsigned char const* spanData(It begin, It end,
+                                         std::string& scratch) {
+        scratch.assign(begin, end);
+        return reinterpret_cast<unsigned char const*>(scratch.data());
+    }
+
+    std::size_t mNumGroups;
+
+    std::vector<Inst>            mProgram;
+    std::vector<std::bitset<256>> mSets;
+
+    // Bytes which no set tells apart share a class, so the DFA table has
+    // a column per class rather than per byte.
+    std::array<std::uint8_t, 256> mByteClass;
+    std::size_t mNumClasses;
+
+    // States are numbered by their row offsets in the table, so that the
+    // lookup doesn't multiply, and the top bit tells if the state matches.
+    // Zero is the dead state.
+    static const std::uint32_t Accepting = 0x80000000u;
+
+    std::vector<std::uint32_t> mTransitions;
+    std::uint32_t mStart;
+    std::uint32_t mStartNotNull;
+    std::size_t   mNumStates;
+
+    // Bytes which can start a match. Every position is a candidate if
+    // the pattern matches an empty string.
+    std::array<bool, 256> mFirstBytes;
+    bool mMatchesEmpty;
+};
+
+/*
+ * The result of a successful search. Unlike 'std::match_results', groups
+ * are plain pairs of iterators, but they have the same 'first' and 'second'
+ * members, which is all the code here needs.
+ */
+template <typename It>
+class DfaMatch {
+public:
+
+    using value_type = std::pair<It, It>;
+
+    value_type const& operator [] (std::size_t idx) const {
+        return mGroups[idx];
+    }
+
+    std::size_t size() const { return mGroups.size(); }
+
+    std::string str(std::size_t idx = 0) const {
+        return std::string(mGroups[idx].first, mGroups[idx].second);
+    }
+
+private:
+    friend class DfaRegex;
+
+    std::vector<value_type> mGroups;
+};
+
+/*
+ * Walks every non-overlapping match, exactly like 'std::regex_iterator'
+ * does, including its treatment of empty matches.
+ */
+template <typename It>
+class DfaRegexIterator {
+public:
+
+    using iterator_category = std::forward_iterator_tag;
+    using value_type        = DfaMatch<It>;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = DfaMatch<It> const*;
+    using reference         = DfaMatch<It> const&;
+
+    DfaRegexIterator(): mLast(), mRegex(nullptr) {}
+
+    DfaRegexIterator(It first, It last, DfaRegex const& rex)
+        : mLast(last)
+        , mRegex(&rex) {
+        if (!mRegex->search(first, mLast, mMatch))
+            mRegex = nullptr;
+    }
+
+    reference operator *  () const { return mMatch; }
+    pointer   operator -> () const { return &mMatch; }
+
+    DfaRegexIterator& operator ++ () {
+        It from = mMatch[0].second;
+
+        // After an empty match, a non-empty one may start at the same
+        // place, otherwise the search goes on from the next byte.
+        if (mMatch[0].first == from) {
+            if (mRegex->matchAt(from, mLast, mMatch, true))
+                return *this;
+
+            if (from == mLast) {
+                mRegex = nullptr;
+                return *this;
+            }
+            ++from;
+        }
+
+        if (!mRegex->search(from, mLast, mMatch))
+            mRegex = nullptr;
+        return *this;
+    }
+
+    // Like with stream iterators, only the end iterators are equal.
+    bool operator == (DfaRegexIterator const& other) const {
+        return mRegex == nullptr && other.mRegex == nullptr;
+    }
+
+    bool operator != (DfaRegexIterator const& other) const {
+        return !(*this == other);
+    }
+
+private:
+    It mLast;
+    DfaRegex const* mRegex;
+    DfaMatch<It> mMatch;
+};
+
+template <typename It>
+bool DfaRegex::matchEnd(It start, It last, bool notNull, It& end) const {
+    std::uint32_t state = notNull ? mStartNotNull : mStart;
+    bool found = (state & Accepting) != 0;
+    end = start;
+
+    // A match found later always comes from threads of higher priority,
+    // since the lower ones have been dropped. So the last one wins.
+    for (It it = start; it != last; ) {
+        state = mTransitions[(state & ~Accepting)
+                             + mByteClass[std::uint8_t(*it)]];
+        ++it;
+
+        if (state == 0)
+            break;
+
+        if (state & Accepting) {
+            found = true;
+            end = it;
+        }
+    }
+
+    return found;
+}
+
+template <typename It>
+void DfaRegex::capture(It start, It end, bool notNull,
+                       DfaMatch<It>& match) const {
+    std::string scratch;
+    std::vector<std::size_t> slots;
+    captureSlots(spanData(start, end, scratch),
+                 std::distance(start, end), notNull, slots);
+
+    match.mGroups.assign(mNumGroups, std::make_pair(end, end));
+    for (std::size_t g = 0; g < mNumGroups; ++g) {
+        std::size_t begin = slots[2*g];
+        std::size_t stop  = slots[2*g + 1];
+        if (begin == std::string::npos || stop == std::string::npos)
+            continue;
+
+        match.mGroups[g].first  = std::next(start, begin);
+        match.mGroups[g].second = std::next(start, stop);
+    }
+}
+
+template <typename It>
+bool DfaRegex::matchAt(It start, It last, DfaMatch<It>& match,
+                       bool notNull) const {
+    It end;
+    if (!matchEnd(start, last, notNull, end))
+        return false;
+
+    capture(start, end, notNull, match);
+    return true;
+}
+
+template <typename It>
+bool DfaRegex::search(It first, It last, DfaMatch<It>& match) const {
+    for (It start = first; ; ++start) {
+        if (!mMatchesEmpty) {
+            while (start != last && !mFirstBytes[std::uint8_t(*start)])
+                ++start;
+            if (start == last)
+                return false;
+        }
+
+        if (matchAt(start, last, match))
+            return true;
+
+        if (start == last)
+            return false;
+    }
+}
@@ -0,0 +1,63 @@
+#include "FileWatcher.hpp"
+#include <algorithm>
+#include <thread>
+
+extern "C" {
+    #include <errno.h>
+    #include <poll.h>
+    #include <sys/inotify.h>
+    #include <unistd.h>
+}
+
+constexpr std::chrono::milliseconds FileWatcher::PollInterval;
+
+FileWatcher::FileWatcher(std::string const& filename)
+    : mFilename(filename)
+    , mFd(::inotify_init1(IN_NONBLOCK | IN_CLOEXEC))
+    , mWatch(-1) {
+    rewatch();
+}
+
+FileWatcher::~FileWatcher() {
+    if (mFd != -1)
+        ::close(mFd);
+}
+
+void FileWatcher::rewatch() {
+    if (mFd == -1)
+        return;
+
+    if (mWatch != -1)
+        ::inotify_rm_watch(mFd, mWatch);
+
+    // The file may be gone for a moment in the middle of a rotation, then
+    // it's polled until somebody calls again.
+    mWatch = ::inotify_add_watch(mFd, mFilename.c_str(),
+                                 IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE
+                                 | IN_MOVE_SELF | IN_DELETE_SELF);
+}
+
+void FileWatcher::wait(std::chrono::milliseconds timeout) {
+    if (timeout.count() <= 0)
+        return;
+
+    if (mWatch == -1) {
+        std::this_thread::sleep_for(std::min(timeout, PollInterval));
+        return;
+    }
+
+    pollfd wake {mFd, POLLIN, 0};
+    if (::poll(&wake, 1, timeout.count()) <= 0)
+        return;
+
+    // What has happened doesn't matter, the file is looked at anyway.
+    // Every event since the last call is read and forgotten.
+    char events[4096];
+    while (1) {
+        ssize_t got = ::read(mFd, events, sizeof events);
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got <= 0)
+            break;
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <chrono>
+#include <string>
+#include <boost/noncopyable.hpp>
+
+/*
+ * Waits for a file to change, for whoever follows a log as it grows. It's
+ * inotify where the kernel has it, and a sleep of 'PollInterval' where it
+ * doesn't, or where the file can't be watched. Either way, it's only
+ * a hint: a wakeup doesn't promise a change, and some filesystems, like
+ * the network ones, change files without telling anyone, so whoever waits
+ * has to look at the file anyway once in a while.
+ */
+class FileWatcher: public boost::noncopyable {
+public:
+
+    static constexpr std::chrono::milliseconds PollInterval{1000};
+
+    explicit FileWatcher(std::string const& filename);
+    ~FileWatcher();
+
+    // Watches whatever file is at the path now, for when the old one has
+    // been replaced, like a log rotated by renaming.
+    void rewatch();
+
+    // Returns once the file may have changed, or 'timeout' has passed.
+    void wait(std::chrono::milliseconds timeout);
+
+private:
+    std::string mFilename;
+    int mFd;        // -1 if there's no inotify.
+    int mWatch;     // -1 if the file isn't watched.
+};
@@ -0,0 +1,96 @@
+#include "FollowInput.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <ios>
+#include "FileWatcher.hpp"
+#include "Report.hpp"
+#include "Scanner.hpp"
+
+extern "C" {
+    #include <sys/stat.h>
+}
+
+namespace {
+
+// Appends smaller than that are scanned by a single worker.
+const std::uint64_t MinFollowChunk = 16*1024*1024;
+
+} // namespace
+
+FollowedInput::FollowedInput(ScanConfig const& config,
+                             std::string const& inputFn,
+                             ReaderOptions const& reading)
+    : mConfig(config)
+    , mInputFn(inputFn)
+    , mReading(reading)
+    , mTotal(config)
+    , mOffset(0)
+    , mDevice(0)
+    , mInode(0)
+    {}
+
+bool FollowedInput::update(ThreadPool& pool) {
+    struct stat inputStat;
+    if (::stat(mInputFn.c_str(), &inputStat) != 0)
+        return false;
+
+    std::uint64_t size = inputStat.st_size;
+    bool replaced = inputStat.st_ino != mInode;
+
+    if (inputStat.st_dev != mDevice || replaced || size < mOffset) {
+        mDevice = inputStat.st_dev;
+        mInode = inputStat.st_ino;
+        mTotal = ScanResult(mConfig);
+        mOffset = 0;
+    }
+
+    std::ifstream input(mInputFn, std::ios_base::binary);
+    std::uint64_t end = input.is_open()
+        ? findChunkEnd(input, syncFuncOf(mConfig), mOffset, size)
+        : mOffset;
+
+    if (end > mOffset) {
+        unsigned numChunks = std::max<std::uint64_t>(1,
+            std::min<std::uint64_t>((end - mOffset) / MinFollowChunk,
+                                    pool.size()));
+
+        scanFileBuffered(pool, mConfig, mInputFn, mOffset, end, numChunks,
+                         mReading, mTotal);
+        mOffset = end;
+    }
+
+    return replaced;
+}
+
+void followInput(ThreadPool& pool, ScanConfig const& config,
+                 std::string const& inputFn, ReaderOptions const& reading,
+                 unsigned interval, std::string const& outputFn,
+                 unsigned maxNum) {
+
+    using Clock = std::chrono::steady_clock;
+
+    FileWatcher watcher(inputFn);
+    FollowedInput input(config, inputFn, reading);
+    auto nextReport = Clock::now();
+
+    while (1) {
+        if (input.update(pool))
+            watcher.rewatch();
+
+        auto now = Clock::now();
+        if (now >= nextReport) {
+            std::string tempFn = outputFn + ".tmp";
+            printReport(tempFn, input.total(), maxNum, pool);
+            if (std::rename(tempFn.c_str(), outputFn.c_str()) != 0)
+                throw std::ios_base::failure(outputFn);
+
+            nextReport = now + std::chrono::seconds(interval);
+        }
+
+        watcher.wait(std::chrono::duration_cast<std::chrono::milliseconds>(
+                         nextReport - Clock::now()));
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <boost/noncopyable.hpp>
+#include "BlockReader.hpp"
+#include "ScanResult.hpp"
+#include "ThreadPool.hpp"
+
+/*
+ * A file followed as it grows, and the counters of what it has had so far.
+ * Only what has been appended since the last look is scanned, and added to
+ * the counters of everything before. The appended data is scanned up to its
+ * last byte which can't be a part of a match, and the rest waits for the
+ * next look, so a line which is still being written is never counted twice,
+ * nor counted cut. A file which has shrunk, or has been replaced, has been
+ * rotated, and is counted from scratch.
+ */
+class FollowedInput: public boost::noncopyable {
+public:
+
+    FollowedInput(ScanConfig const& config, std::string const& inputFn,
+                  ReaderOptions const& reading);
+
+    /*
+     * Looks at the file once, and scans whatever there's new. Returns
+     * 'true' if the path has another file behind it than the last time,
+     * so that whoever watches the old one should watch the new one. A file
+     * which isn't there is left for the next look.
+     */
+    bool update(ThreadPool& pool);
+
+    ScanResult const& total() const { return mTotal; }
+
+    // Everything before it has been counted.
+    std::uint64_t offset() const { return mOffset; }
+
+private:
+
+    ScanConfig    mConfig;
+    std::string   mInputFn;
+    ReaderOptions mReading;
+
+    ScanResult    mTotal;
+    std::uint64_t mOffset;
+    std::uint64_t mDevice;
+    std::uint64_t mInode;
+};
+
+/*
+ * Follows a file as it grows, like 'tail -f' does, and rewrites the report
+ * of what it has had every 'interval' seconds (see 'FollowedInput'). The
+ * report is written to a temporary file, and renamed over the old one, so
+ * that nobody ever reads half of it. Never returns.
+ */
+void followInput(ThreadPool& pool, ScanConfig const& config,
+                 std::string const& inputFn, ReaderOptions const& reading,
+                 unsigned interval, std::string const& outputFn,
+                 unsigned maxNum);
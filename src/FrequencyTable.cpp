@@ -0,0 +1,166 @@
+#include "FrequencyTable.hpp"
+#include <algorithm>
+#include <cstring>
+#include "ThreadPool.hpp"
+
+FrequencyTable::FrequencyTable()
+    : mCapacity(0)
+    , mSize(0)
+    , mGrowAt(0)
+    {}
+
+FrequencyTable::FrequencyTable(FrequencyTable&& other)
+    : mControl(std::move(other.mControl))
+    , mEntries(std::move(other.mEntries))
+    , mCapacity(other.mCapacity)
+    , mSize(other.mSize)
+    , mGrowAt(other.mGrowAt)
+    , mArena(std::move(other.mArena)) {
+
+    // Otherwise the old table would go on walking slots it doesn't have.
+    other.mCapacity = other.mSize = other.mGrowAt = 0;
+}
+
+FrequencyTable& FrequencyTable::operator = (FrequencyTable&& other) {
+    if (this != &other) {
+        mControl  = std::move(other.mControl);
+        mEntries  = std::move(other.mEntries);
+        mCapacity = other.mCapacity;
+        mSize     = other.mSize;
+        mGrowAt   = other.mGrowAt;
+        mArena    = std::move(other.mArena);
+
+        other.mCapacity = other.mSize = other.mGrowAt = 0;
+    }
+    return *this;
+}
+
+void FrequencyTable::merge(FrequencyTable const& other) {
+    // Hashes are already there, so merging never rehashes a string.
+    for (auto const& entry: other)
+        add(entry.key(), entry.hash(), entry.count());
+}
+
+std::size_t FrequencyTable::memoryUsage() const {
+    return mCapacity * (sizeof(Entry) + 1) + mArena.capacity();
+}
+
+namespace {
+
+using Pointer = FrequencyTable::const_pointer;
+
+// The order of the output: the more frequent entries go first, and the
+// equally frequent ones are ordered by their keys to be deterministic.
+bool comesBefore(Pointer a, Pointer b) {
+    if (a->count() == b->count())
+        return a->key() < b->key();
+    return a->count() > b->count();
+}
+
+/*
+ * Keeps the best 'maxNum' entries of the [first, last) range in a heap
+ * whose top is the worst of them. Most entries lose to the top in a single
+ * comparison of counts, so they never even get near the heap.
+ */
+template <typename Iterator>
+std::vector<Pointer> selectTop(Iterator first, Iterator last,
+                               std::size_t maxNum) {
+    std::vector<Pointer> heap;
+    if (maxNum == 0)
+        return heap;
+
+    for (; first != last; ++first) {
+        Pointer ptr = std::addressof(*first);
+        if (heap.size() < maxNum) {
+            heap.push_back(ptr);
+            std::push_heap(heap.begin(), heap.end(), comesBefore);
+        } else if (comesBefore(ptr, heap.front())) {
+            std::pop_heap(heap.begin(), heap.end(), comesBefore);
+            heap.back() = ptr;
+            std::push_heap(heap.begin(), heap.end(), comesBefore);
+        }
+    }
+
+    std::sort_heap(heap.begin(), heap.end(), comesBefore);
+    return heap;
+}
+
+}
+
+std::vector<FrequencyTable::const_pointer>
+FrequencyTable::top(std::size_t maxNum, ThreadPool* pool) const {
+
+    // Handing a part over costs about as much as looking through a few
+    // hundred thousands entries, so small tables are done right here.
+    const std::size_t minPartSize = 256*1024;
+    std::size_t numParts = std::min<std::size_t>(
+        pool ? pool->size() : 1, mSize / minPartSize + 1);
+
+    if (numParts == 1)
+        return selectTop(begin(), end(), maxNum);
+
+    // Parts are cut by slots, not entries, but the entries are spread
+    // evenly over the slots by the hash.
+    std::vector<Task<std::vector<Pointer>>> parts;
+    for (std::size_t k = 0; k < numParts; ++k) {
+        const_iterator first(this, mCapacity * k / numParts);
+        const_iterator last(this, mCapacity * (k+1) / numParts);
+        parts.push_back(pool->submit([=]{
+            return selectTop(first, last, maxNum);
+        }));
+    }
+
+    // Every part's best are the only candidates to be the best overall,
+    // and there are just a few of them.
+    std::vector<Pointer> candidates;
+    for (auto& part: parts) {
+        auto best = part.get();
+        candidates.insert(candidates.end(), best.begin(), best.end());
+    }
+
+    std::size_t num = std::min(maxNum, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + num,
+                      candidates.end(), comesBefore);
+    candidates.resize(num);
+    return candidates;
+}
+
+void FrequencyTable::grow() {
+    Stats::add(Stats::TableGrowths, 1);
+    std::size_t capacity = std::max<std::size_t>(mCapacity * 2, 4*GroupSize);
+
+    std::unique_ptr<std::uint8_t[]> control(new std::uint8_t[capacity]);
+    std::unique_ptr<Entry[]>        entries(new Entry[capacity]);
+    std::memset(control.get(), Empty, capacity);
+
+    // Every key is known to be unique, so moving an entry is just finding
+    // an empty slot for it, and its stored hash is enough for that.
+    std::size_t groupMask = capacity / GroupSize - 1;
+    for (std::size_t slot = 0; slot != mCapacity; ++slot) {
+        if (mControl[slot] == Empty)
+            continue;
+
+        Entry const& entry = mEntries[slot];
+        std::size_t group = (entry.mHash >> 7) & groupMask;
+        for (std::size_t step = 1; ; ++step) {
+            std::size_t base = group * GroupSize;
+            unsigned empty = matchGroup(&control[base], 0).empty;
+            if (empty != 0) {
+                std::size_t dest = base + __builtin_ctz(empty);
+                control[dest] = mControl[slot];
+                entries[dest] = entry;
+                break;
+            }
+
+            group = (group + step) & groupMask;
+        }
+    }
+
+    mControl  = std::move(control);
+    mEntries  = std::move(entries);
+    mCapacity = capacity;
+
+    // 7/8 is what SwissTable uses. Groups of 16 make longer probe
+    // sequences rare enough even at this load.
+    mGrowAt = capacity / 8 * 7;
+}
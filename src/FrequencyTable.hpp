@@ -0,0 +1,240 @@
+#pragma once
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <vector>
+#include "Stats.hpp"
+#include "StringArena.hpp"
+#include "StringRef.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+class ThreadPool;
+
+/*
+ * Counts how many times every distinct string was seen. It's looked up by
+ * a string reference, so that the caller needn't build a 'std::string' for
+ * every occurrence. A key is copied into the table's own arena only the
+ * first time it's seen, and its hash is calculated exactly once per 'add'
+ * call.
+ *
+ * Inside, it's a flat open addressing hash table in the spirit of Google's
+ * SwissTable. Slots are organized in groups of 16, and every slot has
+ * a control byte: either 'Empty', or the lowest 7 bits of the hash of its
+ * key. A single SSE2 comparison checks the whole group for a key's tag,
+ * so the entries themselves are only touched when the tag matches. There
+ * are no deletions, hence no tombstones either.
+ *
+ * Full hashes are stored in the entries. Growing the table never touches
+ * the keys: the stored hash is all what's needed to find a new place.
+ */
+class FrequencyTable {
+public:
+
+    class Entry {
+    public:
+
+        StringRef     key()   const { return StringRef(mData, mSize); }
+        std::uint64_t count() const { return mCount; }
+        std::uint64_t hash()  const { return mHash; }
+
+    private:
+        friend class FrequencyTable;
+
+        // Ordered to make the whole thing 32 bytes long. A 32-bit count
+        // would've made it 24, but a day of logs counts more than that.
+        char const*   mData;
+        std::uint64_t mHash;
+        std::uint64_t mCount;
+        std::uint32_t mSize;
+    };
+
+    class const_iterator;
+
+    using value_type    = Entry;
+    using const_pointer = Entry const*;
+
+    FrequencyTable();
+
+    // A moved-from table is an empty one, which may be filled again.
+    FrequencyTable(FrequencyTable&& other);
+    FrequencyTable& operator = (FrequencyTable&& other);
+
+    /*
+     * Adds 'count' to the counter of 'key'. The table doesn't keep the
+     * reference, so 'key' may die right after the call.
+     */
+    void add(StringRef const& key, std::uint64_t count = 1) {
+        add(key, hashBytes(key), count);
+    }
+
+    void add(StringRef const& key, std::uint64_t hash, std::uint64_t count);
+
+    // Adds all the counters of 'other' to this table.
+    void merge(FrequencyTable const& other);
+
+    std::size_t size() const { return mSize; }
+
+    // Bytes taken by the slots and the keys' arena, overhead included.
+    std::size_t memoryUsage() const;
+
+    /*
+     * Returns no more than 'maxNum' entries with the largest counts, ordered
+     * by count descending, then by key. The table isn't sorted as a whole:
+     * every part of it is run through a heap of 'maxNum' best entries, which
+     * takes O(size * log(maxNum)) and no memory proportional to the size.
+     * Huge tables are cut into parts done in parallel on 'pool', if any.
+     */
+    std::vector<const_pointer> top(std::size_t maxNum,
+                                   ThreadPool* pool = nullptr) const;
+
+    const_iterator begin() const;
+    const_iterator end()   const;
+
+private:
+
+    static const std::size_t GroupSize = 16;
+    static const std::uint8_t Empty = 0x80;
+
+    // Which slots of a group have the given tag, and which are empty.
+    struct GroupMatch {
+        unsigned tagged;
+        unsigned empty;
+    };
+
+    static GroupMatch matchGroup(std::uint8_t const* control,
+                                 std::uint8_t tag);
+
+    void grow();
+
+    std::unique_ptr<std::uint8_t[]> mControl;
+    std::unique_ptr<Entry[]>        mEntries;
+
+    std::size_t mCapacity;
+    std::size_t mSize;
+    std::size_t mGrowAt;
+
+    StringArena mArena;
+};
+
+class FrequencyTable::const_iterator {
+public:
+
+    using iterator_category = std::forward_iterator_tag;
+    using value_type        = Entry;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = Entry const*;
+    using reference         = Entry const&;
+
+    const_iterator(FrequencyTable const* table, std::size_t slot)
+        : mTable(table)
+        , mSlot(slot) {
+        skipEmpty();
+    }
+
+    reference operator *  () const { return mTable->mEntries[mSlot]; }
+    pointer   operator -> () const { return &mTable->mEntries[mSlot]; }
+
+    const_iterator& operator ++ () {
+        ++mSlot;
+        skipEmpty();
+        return *this;
+    }
+
+    bool operator == (const_iterator const& other) const {
+        return mSlot == other.mSlot;
+    }
+
+    bool operator != (const_iterator const& other) const {
+        return mSlot != other.mSlot;
+    }
+
+private:
+
+    void skipEmpty() {
+        while (mSlot != mTable->mCapacity
+                        && mTable->mControl[mSlot] == Empty)
+            ++mSlot;
+    }
+
+    FrequencyTable const* mTable;
+    std::size_t mSlot;
+};
+
+inline FrequencyTable::const_iterator FrequencyTable::begin() const {
+    return const_iterator(this, 0);
+}
+
+inline FrequencyTable::const_iterator FrequencyTable::end() const {
+    return const_iterator(this, mCapacity);
+}
+
+inline FrequencyTable::GroupMatch
+FrequencyTable::matchGroup(std::uint8_t const* control, std::uint8_t tag) {
+#if defined(__SSE2__)
+    __m128i group = _mm_loadu_si128(reinterpret_cast<__m128i const*>(control));
+    __m128i tags  = _mm_set1_epi8(tag);
+
+    // Tags are 7 bits long, so only the empty slots have the top bit set.
+    return GroupMatch {
+        (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(group, tags)),
+        (unsigned)_mm_movemask_epi8(group) };
+#else
+    GroupMatch match {0, 0};
+    for (std::size_t i = 0; i < GroupSize; ++i) {
+        match.tagged |= unsigned(control[i] == tag)   << i;
+        match.empty  |= unsigned(control[i] == Empty) << i;
+    }
+    return match;
+#endif
+}
+
+inline void FrequencyTable::add(StringRef const& key, std::uint64_t hash,
+                                std::uint64_t count) {
+    if (mSize >= mGrowAt)
+        grow();
+
+    // The lowest bits go to the tag, the rest choose the group.
+    std::uint8_t tag = hash & 0x7F;
+    std::size_t groupMask = mCapacity / GroupSize - 1;
+    std::size_t group = (hash >> 7) & groupMask;
+
+    // Triangular probing visits every group when their number is a power
+    // of two, and there's always an empty slot somewhere.
+    for (std::size_t step = 1; ; ++step) {
+        std::size_t base = group * GroupSize;
+        GroupMatch match = matchGroup(&mControl[base], tag);
+
+        for (unsigned bits = match.tagged; bits != 0; bits &= bits - 1) {
+            Entry& entry = mEntries[base + __builtin_ctz(bits)];
+            if (entry.mHash == hash && entry.key() == key) {
+                entry.mCount += count;
+                Stats::add(Stats::TableProbes, step);
+                return;
+            }
+        }
+
+        // No deletions means that the key would've been put into the
+        // first empty slot on its way, had it been there.
+        if (match.empty != 0) {
+            std::size_t slot = base + __builtin_ctz(match.empty);
+            StringRef copy = mArena.copy(key);
+
+            Entry& entry = mEntries[slot];
+            entry.mData  = copy.data();
+            entry.mHash  = hash;
+            entry.mSize  = copy.size();
+            entry.mCount = count;
+
+            mControl[slot] = tag;
+            ++mSize;
+            Stats::add(Stats::TableProbes, step);
+            Stats::add(Stats::TableInserts, 1);
+            return;
+        }
+
+        group = (group + step) & groupMask;
+    }
+}
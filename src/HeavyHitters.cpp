@@ -0,0 +1,287 @@
+#include "HeavyHitters.hpp"
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+namespace {
+
+std::size_t roundUpToPowerOfTwo(std::size_t n) {
+    std::size_t result = 1;
+    while (result < n)
+        result <<= 1;
+
+    return result;
+}
+
+}
+
+CountMinSketch::CountMinSketch(std::size_t width, std::size_t depth)
+    : mWidth(roundUpToPowerOfTwo(width))
+    , mDepth(depth)
+    , mCells(mWidth * depth, 0)
+    {}
+
+std::uint64_t CountMinSketch::add(std::uint64_t hash, std::uint64_t count) {
+
+    // Conservative update: no cell is raised above the new estimate, which
+    // keeps all the guarantees and makes collisions hurt much less.
+    std::uint64_t target = estimate(hash) + count;
+    for (std::size_t row = 0; row < mDepth; ++row) {
+        std::uint64_t& value = mCells[cell(hash, row)];
+        value = std::max(value, target);
+    }
+
+    return target;
+}
+
+std::uint64_t CountMinSketch::estimate(std::uint64_t hash) const {
+    std::uint64_t result = UINT64_MAX;
+    for (std::size_t row = 0; row < mDepth; ++row)
+        result = std::min(result, mCells[cell(hash, row)]);
+
+    return result;
+}
+
+void CountMinSketch::merge(CountMinSketch const& other) {
+    if (other.mWidth != mWidth || other.mDepth != mDepth)
+        throw std::invalid_argument("sketch dimensions differ");
+
+    for (std::size_t i = 0; i < mCells.size(); ++i)
+        mCells[i] += other.mCells[i];
+}
+
+HeavyHitters::HeavyHitters(std::size_t capacity)
+    : mCapacity(std::max<std::size_t>(capacity, 1))
+    , mEvicted(false)
+    , mIndex(16, 0)
+    // With 4 cells per monitored key, the sketch's error is about the
+    // Space-Saving's N/capacity, but conservative update does much better
+    // than that in practice. Four rows are plenty.
+    , mSketch(mCapacity * 4, 4)
+    {}
+
+void HeavyHitters::add(StringRef const& key, std::uint64_t hash,
+                       std::uint64_t count) {
+    mSketch.add(hash, count);
+
+    std::uint32_t* cell = findCell(key, hash);
+    if (*cell != 0) {
+        std::uint32_t slot = *cell - 1;
+        mSlots[slot].count += count;
+        siftDown(mSlots[slot].heapPos);
+        return;
+    }
+
+    if (mSlots.size() < mCapacity) {
+        std::uint32_t slot = mSlots.size();
+        mSlots.push_back(Slot {key.str(), hash, count, 0, slot});
+        mHeap.push_back(slot);
+        siftUp(slot);
+
+        // Keep the index at most half full. Nothing is allocated up
+        // front, since a summary rarely fills up on small inputs.
+        if (mSlots.size() * 2 > mIndex.size()) {
+            mIndex.assign(mIndex.size() * 2, 0);
+            for (std::uint32_t i = 0; i < mSlots.size(); ++i)
+                insertCell(i);
+        } else {
+            *cell = slot + 1;
+        }
+        return;
+    }
+
+    // The least frequent key gives its counter away. The counter's value
+    // is how much the new key's count may be overestimated.
+    std::uint32_t slot = mHeap[0];
+    Slot& victim = mSlots[slot];
+    eraseCell(findCell(victim.key, victim.hash));
+
+    victim.key.assign(key.data(), key.size());
+    victim.hash   = hash;
+    victim.error  = victim.count;
+    victim.count += count;
+    insertCell(slot);
+    siftDown(0);
+
+    mEvicted = true;
+}
+
+void HeavyHitters::merge(HeavyHitters const& other) {
+
+    // This is the merge from "Mergeable Summaries" by Agarwal et al. A key
+    // missing from a full summary might have occurred there as many times
+    // as that summary's minimum counter, so this is added to its bounds.
+    std::uint64_t ownMin   = minCount();
+    std::uint64_t otherMin = other.minCount();
+
+    for (Slot& slot: mSlots) {
+        slot.count += otherMin;
+        slot.error += otherMin;
+    }
+
+    // Keys new to this summary are put aside, so that the index stays
+    // valid while the other summary is being walked.
+    std::vector<Slot> added;
+    for (Slot const& theirs: other.mSlots) {
+        std::uint32_t* cell = findCell(theirs.key, theirs.hash);
+        if (*cell != 0) {
+            Slot& ours = mSlots[*cell - 1];
+            ours.count += theirs.count - otherMin;
+            ours.error += theirs.error - otherMin;
+        } else {
+            added.push_back(Slot {theirs.key, theirs.hash,
+                                  theirs.count + ownMin,
+                                  theirs.error + ownMin, 0});
+        }
+    }
+
+    std::move(added.begin(), added.end(), std::back_inserter(mSlots));
+
+    // Only the largest counters survive, just like in a single summary.
+    mEvicted = mEvicted || other.mEvicted || mSlots.size() > mCapacity;
+    if (mSlots.size() > mCapacity) {
+        std::nth_element(mSlots.begin(), mSlots.begin() + mCapacity,
+                         mSlots.end(), [](Slot const& a, Slot const& b) {
+                             return a.count > b.count; });
+        mSlots.resize(mCapacity);
+    }
+
+    mIndex.assign(roundUpToPowerOfTwo(std::max<std::size_t>(
+                      mSlots.size() * 2, 16)), 0);
+    mSlots.shrink_to_fit();
+    rebuild();
+
+    mSketch.merge(other.mSketch);
+}
+
+std::vector<HeavyHitters::Item> HeavyHitters::top(std::size_t maxNum) const {
+    std::vector<Item> items;
+    items.reserve(mSlots.size());
+    for (Slot const& slot: mSlots) {
+        std::uint64_t upper = std::min(slot.count,
+                                       mSketch.estimate(slot.hash));
+        items.push_back(Item {slot.key, upper, slot.count - slot.error});
+    }
+
+    auto byCount = [](Item const& a, Item const& b) {
+        if (a.count == b.count)
+            return a.key < b.key;
+        return a.count > b.count;
+    };
+
+    std::size_t num = std::min(maxNum, items.size());
+    std::partial_sort(items.begin(), items.begin() + num, items.end(),
+                      byCount);
+    items.resize(num);
+    return items;
+}
+
+std::size_t HeavyHitters::memoryUsage() const {
+    std::size_t keys = 0;
+    for (Slot const& slot: mSlots)
+        keys += slot.key.capacity();
+
+    return mSlots.capacity() * sizeof(Slot) + keys
+         + mHeap.capacity()  * sizeof(std::uint32_t)
+         + mIndex.capacity() * sizeof(std::uint32_t)
+         + mSketch.memoryUsage();
+}
+
+std::uint32_t* HeavyHitters::findCell(StringRef const& key,
+                                      std::uint64_t hash) {
+    std::size_t mask = mIndex.size() - 1;
+    for (std::size_t pos = hash & mask; ; pos = (pos + 1) & mask) {
+        std::uint32_t& cell = mIndex[pos];
+        if (cell == 0)
+            return &cell;
+
+        Slot const& slot = mSlots[cell - 1];
+        if (slot.hash == hash && StringRef(slot.key) == key)
+            return &cell;
+    }
+}
+
+void HeavyHitters::insertCell(std::uint32_t slot) {
+    std::size_t mask = mIndex.size() - 1;
+    std::size_t pos = mSlots[slot].hash & mask;
+    while (mIndex[pos] != 0)
+        pos = (pos + 1) & mask;
+
+    mIndex[pos] = slot + 1;
+}
+
+void HeavyHitters::eraseCell(std::uint32_t* cell) {
+
+    // Backward shift deletion: the following cells of the same cluster
+    // move into the hole unless that would put them before their home.
+    std::size_t mask = mIndex.size() - 1;
+    std::size_t hole = cell - mIndex.data();
+    std::size_t pos  = hole;
+
+    while (1) {
+        pos = (pos + 1) & mask;
+        if (mIndex[pos] == 0)
+            break;
+
+        std::size_t home = mSlots[mIndex[pos] - 1].hash & mask;
+        if (((pos - home) & mask) >= ((pos - hole) & mask)) {
+            mIndex[hole] = mIndex[pos];
+            hole = pos;
+        }
+    }
+
+    mIndex[hole] = 0;
+}
+
+void HeavyHitters::siftUp(std::uint32_t pos) {
+    while (pos > 0) {
+        std::uint32_t parent = (pos - 1) / 2;
+        if (mSlots[mHeap[parent]].count <= mSlots[mHeap[pos]].count)
+            break;
+
+        swapHeap(parent, pos);
+        pos = parent;
+    }
+}
+
+void HeavyHitters::siftDown(std::uint32_t pos) {
+    std::uint32_t size = mHeap.size();
+    while (1) {
+        std::uint32_t least = pos;
+        std::uint32_t left  = 2*pos + 1;
+        std::uint32_t right = 2*pos + 2;
+
+        if (left < size &&
+                mSlots[mHeap[left]].count < mSlots[mHeap[least]].count)
+            least = left;
+        if (right < size &&
+                mSlots[mHeap[right]].count < mSlots[mHeap[least]].count)
+            least = right;
+
+        if (least == pos)
+            break;
+
+        swapHeap(pos, least);
+        pos = least;
+    }
+}
+
+void HeavyHitters::swapHeap(std::uint32_t a, std::uint32_t b) {
+    std::swap(mHeap[a], mHeap[b]);
+    mSlots[mHeap[a]].heapPos = a;
+    mSlots[mHeap[b]].heapPos = b;
+}
+
+void HeavyHitters::rebuild() {
+    std::fill(mIndex.begin(), mIndex.end(), 0);
+    mHeap.clear();
+
+    for (std::uint32_t slot = 0; slot < mSlots.size(); ++slot) {
+        insertCell(slot);
+        mHeap.push_back(slot);
+        mSlots[slot].heapPos = slot;
+    }
+
+    for (std::uint32_t pos = mHeap.size() / 2; pos-- > 0; )
+        siftDown(pos);
+}
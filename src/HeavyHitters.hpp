@@ -0,0 +1,128 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "StringRef.hpp"
+
+/*
+ * Count-Min sketch with conservative update. It never underestimates a
+ * count, and overestimates it by at most e/width of the total count with
+ * probability 1 - exp(-depth). Rows are indexed by double hashing of the
+ * key's 64-bit hash, so keys are never looked at.
+ */
+class CountMinSketch {
+public:
+
+    CountMinSketch(std::size_t width, std::size_t depth);
+
+    // Adds 'count' to the key, and returns the new estimate for it.
+    std::uint64_t add(std::uint64_t hash, std::uint64_t count);
+
+    std::uint64_t estimate(std::uint64_t hash) const;
+
+    // Both sketches must have the same dimensions.
+    void merge(CountMinSketch const& other);
+
+    std::size_t memoryUsage() const {
+        return mCells.size() * sizeof(std::uint64_t);
+    }
+
+private:
+
+    std::size_t cell(std::uint64_t hash, std::size_t row) const {
+        std::uint64_t h1 = hash;
+        std::uint64_t h2 = (hash >> 32) | (hash << 32) | 1;
+        return row * mWidth + ((h1 + row * h2) & (mWidth - 1));
+    }
+
+    std::size_t mWidth;
+    std::size_t mDepth;
+    std::vector<std::uint64_t> mCells;
+};
+
+/*
+ * Finds the most frequent keys of a stream in bounded memory. It's the
+ * Space-Saving algorithm by Metwally et al.: 'capacity' keys are monitored
+ * at most, and when a new key arrives to the full summary, it takes over
+ * the counter of the least frequent one. That counter's value becomes the
+ * new key's possible error. Every key which occurs more than N/capacity
+ * times in a stream of N is guaranteed to stay in the summary.
+ *
+ * Space-Saving counters are upper bounds of the true counts. A Count-Min
+ * sketch running alongside gives another upper bound, so the smaller of
+ * the two is reported. Both structures are mergeable, so summaries built
+ * by different threads, or for different files, can be combined.
+ */
+class HeavyHitters {
+public:
+
+    struct Item {
+        StringRef     key;
+        std::uint64_t count;    // Upper bound of the true count.
+        std::uint64_t lower;    // Guaranteed lower bound.
+    };
+
+    explicit HeavyHitters(std::size_t capacity);
+
+    HeavyHitters(HeavyHitters&&) = default;
+    HeavyHitters& operator = (HeavyHitters&&) = default;
+
+    void add(StringRef const& key, std::uint64_t count = 1) {
+        add(key, hashBytes(key), count);
+    }
+
+    void add(StringRef const& key, std::uint64_t hash, std::uint64_t count);
+
+    void merge(HeavyHitters const& other);
+
+    /*
+     * Returns no more than 'maxNum' most frequent keys, sorted by count
+     * descending, then by key. References are valid until the next change.
+     */
+    std::vector<Item> top(std::size_t maxNum) const;
+
+    std::size_t size()     const { return mSlots.size(); }
+    std::size_t capacity() const { return mCapacity; }
+
+    // 'false' until the first key has been evicted. Until then, the
+    // counts are exact and 'size' is the number of distinct keys.
+    bool evicted() const { return mEvicted; }
+
+    std::size_t memoryUsage() const;
+
+private:
+
+    struct Slot {
+        std::string   key;
+        std::uint64_t hash;
+        std::uint64_t count;
+        std::uint64_t error;
+        std::uint32_t heapPos;
+    };
+
+    // Linear probing index from keys to slots, with backward shift
+    // deletion. Zero means an empty cell, the rest are slot numbers + 1.
+    std::uint32_t* findCell(StringRef const& key, std::uint64_t hash);
+    void insertCell(std::uint32_t slot);
+    void eraseCell(std::uint32_t* cell);
+
+    // A min-heap of slot numbers ordered by their counts.
+    void siftUp(std::uint32_t pos);
+    void siftDown(std::uint32_t pos);
+    void swapHeap(std::uint32_t a, std::uint32_t b);
+
+    std::uint64_t minCount() const {
+        return mSlots.size() < mCapacity ? 0 : mSlots[mHeap[0]].count;
+    }
+
+    void rebuild();
+
+    std::size_t mCapacity;
+    bool mEvicted;
+
+    std::vector<Slot>          mSlots;
+    std::vector<std::uint32_t> mHeap;
+    std::vector<std::uint32_t> mIndex;
+
+    CountMinSketch mSketch;
+};
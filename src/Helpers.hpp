@@ -2,6 +2,7 @@
 #include <tuple>
 #include <boost/range/iterator_range.hpp>
 #include <boost/coroutine/coroutine.hpp>
+#include "DfaRegex.hpp"
 
 /*
  * Copies items from [first, last) to 'dest', but no more than 'count'.
@@ -43,6 +44,17 @@ auto regexSearchAll(BidirIt first, BidirIt last, std::regex const& rex)
     return {matchesBegin, matchesEnd};
 }
 
+/*
+ * The same for the in-tree DFA engine, which has matches of its own type
+ * but can be used in place of 'std::regex' for the patterns it supports.
+ */
+template <typename It>
+auto regexSearchAll(It first, It last, DfaRegex const& rex)
+                    -> boost::iterator_range<DfaRegexIterator<It>> {
+
+    return {DfaRegexIterator<It>(first, last, rex), DfaRegexIterator<It>()};
+}
+
 /*
  * Convenience function to spawn coroutines. The first argument of 'func'
  * must be of type 'Coro::push_type&', the rest of arguments are forwarded
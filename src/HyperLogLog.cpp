@@ -0,0 +1,248 @@
+#include "HyperLogLog.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+// Number of leading zeros plus one, or 'limit' if all the bits are zero.
+unsigned rank(std::uint64_t bits, unsigned limit) {
+    if (bits == 0)
+        return limit;
+
+    return std::min<unsigned>(__builtin_clzll(bits) + 1, limit);
+}
+
+std::uint32_t entryIndex(std::uint32_t entry) { return entry >> 6; }
+std::uint32_t entryValue(std::uint32_t entry) { return entry & 0x3F; }
+
+/*
+ * The improved raw estimator from "New cardinality estimation algorithms
+ * for HyperLogLog sketches" by Otmar Ertl. Unlike the original one, it
+ * needs neither linear counting for small cardinalities nor the empirical
+ * bias correction tables of HyperLogLog++. 'counts[k]' is the number of
+ * registers equal to 'k', where 'k' goes up to 65 - precision.
+ */
+double estimateFromHistogram(std::vector<std::uint64_t> const& counts,
+                             unsigned precision) {
+
+    double m = std::ldexp(1.0, precision);
+    unsigned q = 64 - precision;
+
+    auto sigma = [](double x) {
+        if (x == 1.0)
+            return std::numeric_limits<double>::infinity();
+
+        double y = 1.0, z = x;
+        while (1) {
+            x *= x;
+            double prev = z;
+            z += x * y;
+            y += y;
+            if (z == prev)
+                return z;
+        }
+    };
+
+    auto tau = [](double x) {
+        if (x == 0.0 || x == 1.0)
+            return 0.0;
+
+        double y = 1.0, z = 1.0 - x;
+        while (1) {
+            x = std::sqrt(x);
+            double prev = z;
+            y *= 0.5;
+            z -= (1.0 - x) * (1.0 - x) * y;
+            if (z == prev)
+                return z / 3.0;
+        }
+    };
+
+    double z = m * tau(1.0 - counts[q+1] / m);
+    for (unsigned k = q; k >= 1; --k)
+        z = 0.5 * (z + counts[k]);
+
+    z += m * sigma(counts[0] / m);
+    return m * m / (2.0 * std::log(2.0) * z);
+}
+
+}
+
+HyperLogLog::HyperLogLog(unsigned precision)
+    : mPrecision(precision) {
+
+    if (precision < MinPrecision || precision > MaxPrecision)
+        throw std::invalid_argument("HyperLogLog precision out of range");
+
+    // Sorting pending entries now and then is what keeps the sparse list
+    // small, but sorting them too often is slow.
+    mPendingLimit = std::max<std::size_t>(16,
+                                          (std::size_t(1) << precision) / 16);
+}
+
+std::uint32_t HyperLogLog::encodeSparse(std::uint64_t hash) {
+    std::uint32_t index = hash >> (64 - SparsePrecision);
+    std::uint32_t value = rank(hash << SparsePrecision,
+                               64 - SparsePrecision + 1);
+    return (index << 6) | value;
+}
+
+void HyperLogLog::addDense(std::vector<std::uint8_t>& registers,
+                           std::uint64_t hash) const {
+    std::uint8_t value = rank(hash << mPrecision, 64 - mPrecision + 1);
+    std::uint8_t& reg  = registers[hash >> (64 - mPrecision)];
+    reg = std::max(reg, value);
+}
+
+void HyperLogLog::addDense(std::vector<std::uint8_t>& registers,
+                           std::uint32_t entry) const {
+
+    // The dense index is the top of the sparse one. If the rest of the
+    // sparse index has a one bit, it determines the rank, otherwise the
+    // sparse rank continues the run of zeros.
+    unsigned extra = SparsePrecision - mPrecision;
+    std::uint32_t index = entryIndex(entry) >> extra;
+    std::uint32_t rest  = entryIndex(entry) & ((1u << extra) - 1);
+
+    std::uint8_t value = (rest != 0)
+        ? __builtin_clz(rest) - (32 - extra) + 1
+        : extra + entryValue(entry);
+
+    std::uint8_t& reg = registers[index];
+    reg = std::max(reg, value);
+}
+
+void HyperLogLog::flush() {
+    if (mPending.empty())
+        return;
+
+    // Entries are ordered by index, then by value, so that the last one
+    // of every index is the one to keep.
+    std::sort(mPending.begin(), mPending.end());
+
+    std::vector<std::uint32_t> merged;
+    merged.reserve(mSparse.size() + mPending.size());
+    std::merge(mSparse.begin(), mSparse.end(),
+               mPending.begin(), mPending.end(),
+               std::back_inserter(merged));
+
+    mSparse.clear();
+    for (std::uint32_t entry: merged) {
+        if (!mSparse.empty() &&
+                entryIndex(mSparse.back()) == entryIndex(entry))
+            mSparse.back() = entry;
+        else
+            mSparse.push_back(entry);
+    }
+
+    mPending.clear();
+
+    if (mSparse.size() * sizeof(std::uint32_t) >= (1u << mPrecision))
+        toDense();
+}
+
+void HyperLogLog::toDense() {
+    mRegisters.assign(std::size_t(1) << mPrecision, 0);
+    for (std::uint32_t entry: mSparse)
+        addDense(mRegisters, entry);
+    for (std::uint32_t entry: mPending)
+        addDense(mRegisters, entry);
+
+    std::vector<std::uint32_t>().swap(mSparse);
+    std::vector<std::uint32_t>().swap(mPending);
+}
+
+void HyperLogLog::merge(HyperLogLog const& other) {
+    if (other.mPrecision != mPrecision)
+        throw std::invalid_argument("HyperLogLog precisions differ");
+
+    if (isSparse() && other.isSparse()) {
+        mPending.insert(mPending.end(),
+                        other.mSparse.begin(), other.mSparse.end());
+        mPending.insert(mPending.end(),
+                        other.mPending.begin(), other.mPending.end());
+        flush();
+        return;
+    }
+
+    if (isSparse())
+        toDense();
+
+    if (other.isSparse()) {
+        for (std::uint32_t entry: other.mSparse)
+            addDense(mRegisters, entry);
+        for (std::uint32_t entry: other.mPending)
+            addDense(mRegisters, entry);
+    } else {
+        for (std::size_t i = 0; i < mRegisters.size(); ++i)
+            mRegisters[i] = std::max(mRegisters[i], other.mRegisters[i]);
+    }
+}
+
+void HyperLogLog::save(std::vector<std::uint32_t>& sparse,
+                       std::vector<std::uint8_t>& dense) const {
+    sparse.clear();
+    dense.clear();
+
+    // Folding the pending entries in may turn it dense.
+    HyperLogLog copy(*this);
+    copy.flush();
+
+    if (copy.isSparse())
+        sparse = copy.mSparse;
+    else
+        dense = copy.mRegisters;
+}
+
+void HyperLogLog::mergeSparse(std::uint32_t const* entries, std::size_t num) {
+    if (isSparse()) {
+        mPending.insert(mPending.end(), entries, entries + num);
+        flush();
+        return;
+    }
+
+    for (std::size_t i = 0; i < num; ++i)
+        addDense(mRegisters, entries[i]);
+}
+
+void HyperLogLog::mergeDense(std::uint8_t const* registers) {
+    if (isSparse())
+        toDense();
+
+    for (std::size_t i = 0; i < mRegisters.size(); ++i)
+        mRegisters[i] = std::max(mRegisters[i], registers[i]);
+}
+
+double HyperLogLog::estimate() const {
+    if (!isSparse()) {
+        std::vector<std::uint64_t> counts(64 - mPrecision + 2, 0);
+        for (std::uint8_t reg: mRegisters)
+            ++counts[reg];
+
+        return estimateFromHistogram(counts, mPrecision);
+    }
+
+    // The sparse list is a sketch of its own, with 2^25 registers most
+    // of which are zero. Pending entries haven't been folded in yet, so
+    // do this in a copy.
+    std::vector<std::uint32_t> entries(mSparse);
+    entries.insert(entries.end(), mPending.begin(), mPending.end());
+    std::sort(entries.begin(), entries.end());
+
+    std::vector<std::uint64_t> counts(64 - SparsePrecision + 2, 0);
+    std::uint64_t numZero = std::uint64_t(1) << SparsePrecision;
+    for (std::size_t i = 0; i < entries.size(); ++i) {
+        bool last = i + 1 == entries.size()
+                 || entryIndex(entries[i+1]) != entryIndex(entries[i]);
+        if (last) {
+            ++counts[entryValue(entries[i])];
+            --numZero;
+        }
+    }
+
+    counts[0] = numZero;
+    return estimateFromHistogram(counts, SparsePrecision);
+}
@@ -0,0 +1,95 @@
+#include "InputFiles.hpp"
+#include <algorithm>
+#include <ios>
+#include <memory>
+
+extern "C" {
+    #include <dirent.h>
+    #include <glob.h>
+    #include <sys/stat.h>
+}
+
+namespace {
+
+void addDirectory(std::string const& path, std::vector<InputFile>& files) {
+    DIR* dir = ::opendir(path.c_str());
+    if (!dir)
+        throw std::ios_base::failure(path);
+
+    // Sorted, so that the order of the files of the same size doesn't
+    // depend on the filesystem.
+    std::vector<std::string> names;
+    while (dirent* entry = ::readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name != "." && name != "..")
+            names.push_back(name);
+    }
+    ::closedir(dir);
+
+    std::sort(names.begin(), names.end());
+    for (auto const& name: names) {
+        std::string child = path + (path.back() == '/' ? "" : "/") + name;
+
+        // A link to a directory may lead back up, so only the directories
+        // themselves are walked into.
+        struct stat linkStat;
+        if (::lstat(child.c_str(), &linkStat) != 0)
+            continue;
+
+        if (S_ISDIR(linkStat.st_mode)) {
+            addDirectory(child, files);
+            continue;
+        }
+
+        struct stat fileStat;
+        if (::stat(child.c_str(), &fileStat) == 0
+                && S_ISREG(fileStat.st_mode))
+            files.push_back(InputFile{child, std::uint64_t(fileStat.st_size),
+                                      true});
+    }
+}
+
+void addPath(std::string const& path, std::vector<InputFile>& files) {
+    struct stat pathStat;
+    if (::stat(path.c_str(), &pathStat) != 0)
+        throw std::ios_base::failure(path);
+
+    if (S_ISDIR(pathStat.st_mode))
+        addDirectory(path, files);
+    else if (S_ISREG(pathStat.st_mode))
+        files.push_back(InputFile{path, std::uint64_t(pathStat.st_size),
+                                  true});
+    else
+        files.push_back(InputFile{path, 0, false});
+}
+
+} // namespace
+
+std::vector<InputFile> listInputFiles(std::vector<std::string> const& args) {
+    std::vector<InputFile> files;
+
+    for (auto const& arg: args) {
+        struct stat argStat;
+        bool exists = ::stat(arg.c_str(), &argStat) == 0;
+        if (exists || arg.find_first_of("*?[") == arg.npos) {
+            addPath(arg, files);
+            continue;
+        }
+
+        glob_t matches;
+        if (::glob(arg.c_str(), 0, nullptr, &matches) != 0)
+            throw std::ios_base::failure(arg);
+
+        // Freed however 'addPath' gets out.
+        std::unique_ptr<glob_t, decltype(&::globfree)> freeMatches(
+            &matches, &::globfree);
+        for (std::size_t k = 0; k < matches.gl_pathc; ++k)
+            addPath(matches.gl_pathv[k], files);
+    }
+
+    std::stable_sort(files.begin(), files.end(),
+                     [](InputFile const& a, InputFile const& b) {
+                         return a.size > b.size;
+                     });
+    return files;
+}
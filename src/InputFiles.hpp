@@ -0,0 +1,24 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct InputFile {
+    std::string path;
+
+    // Zero for pipes and such, whose size isn't known up front.
+    std::uint64_t size;
+
+    // Whether it's a regular file, which can be mapped, or read at any
+    // offset. Otherwise it can only be read front to back.
+    bool regular;
+};
+
+/*
+ * Turns the inputs given on the command line into a list of files. An
+ * input may be a file, a directory, whose regular files are taken at any
+ * depth, or a glob pattern, for when the shell hasn't expanded it. The
+ * largest files come first, so that they don't end up started last. Throws
+ * 'std::ios_base::failure' for an input which doesn't exist.
+ */
+std::vector<InputFile> listInputFiles(std::vector<std::string> const& args);
@@ -0,0 +1,290 @@
+#include "InputStream.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <system_error>
+#include <zlib.h>
+
+#if defined(HAVE_ZSTD)
+#include <zstd.h>
+#endif
+
+extern "C" {
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+}
+
+namespace {
+
+// Compressed data is read by blocks this large. The decompressed data
+// is as large as the reader asks for.
+const std::size_t RawBlockSize = 256*1024;
+const std::size_t SmallReadSize = 64*1024;
+
+Compression compressionOf(char const* magic, std::size_t size) {
+    if (size >= 2 && std::memcmp(magic, "\x1F\x8B", 2) == 0)
+        return Compression::Gzip;
+    if (size >= 4 && std::memcmp(magic, "\x28\xB5\x2F\xFD", 4) == 0)
+        return Compression::Zstd;
+    return Compression::None;
+}
+
+std::ios_base::failure corrupt(std::string const& filename,
+                               std::string const& what) {
+    return std::ios_base::failure(filename + ": " + what);
+}
+
+} // namespace
+
+Compression detectCompression(std::string const& filename) {
+    std::ifstream input(filename, std::ios_base::binary);
+    char magic[4];
+    input.read(magic, sizeof magic);
+    return compressionOf(magic, input.gcount());
+}
+
+/*
+ * Decompresses a piece of input at a time. Neither side has to be large
+ * enough for a whole member or frame, the codec keeps its state between
+ * the calls.
+ */
+class InputBuf::Codec {
+public:
+
+    virtual ~Codec() {}
+
+    // Decompresses [in, inEnd) into [out, outEnd), and moves both pointers
+    // past what has been consumed and produced.
+    virtual void run(char const*& in, char const* inEnd,
+                     char*& out, char* outEnd) = 0;
+
+    // Whether the last member or frame isn't over yet, so the file mustn't
+    // be either.
+    bool inside() const { return mInside; }
+
+protected:
+    bool mInside = false;
+};
+
+class InputBuf::GzipCodec: public Codec {
+public:
+
+    explicit GzipCodec(std::string const& filename)
+        : mFilename(filename) {
+        // Plus 16 means the gzip wrapper, rather than the zlib one.
+        mStream = z_stream {};
+        if (inflateInit2(&mStream, 16 + MAX_WBITS) != Z_OK)
+            throw std::bad_alloc();
+    }
+
+    ~GzipCodec() {
+        inflateEnd(&mStream);
+    }
+
+    void run(char const*& in, char const* inEnd,
+             char*& out, char* outEnd) override {
+
+        // Another member may follow the end of the last one.
+        if (mEnded && in != inEnd) {
+            inflateReset(&mStream);
+            mEnded = false;
+        }
+
+        mStream.next_in   = reinterpret_cast<Bytef*>(const_cast<char*>(in));
+        mStream.avail_in  = inEnd - in;
+        mStream.next_out  = reinterpret_cast<Bytef*>(out);
+        mStream.avail_out = outEnd - out;
+
+        int status = inflate(&mStream, Z_NO_FLUSH);
+
+        in  = reinterpret_cast<char const*>(mStream.next_in);
+        out = reinterpret_cast<char*>(mStream.next_out);
+
+        if (status != Z_OK && status != Z_STREAM_END && status != Z_BUF_ERROR)
+            throw corrupt(mFilename, mStream.msg ? mStream.msg
+                                                 : "corrupt gzip data");
+
+        mEnded = status == Z_STREAM_END;
+        mInside = !mEnded;
+    }
+
+private:
+    std::string mFilename;
+    z_stream mStream;
+    bool mEnded = false;
+};
+
+#if defined(HAVE_ZSTD)
+
+class InputBuf::ZstdCodec: public Codec {
+public:
+
+    explicit ZstdCodec(std::string const& filename)
+        : mFilename(filename)
+        , mContext(ZSTD_createDCtx()) {
+        if (!mContext)
+            throw std::bad_alloc();
+    }
+
+    ~ZstdCodec() {
+        ZSTD_freeDCtx(mContext);
+    }
+
+    void run(char const*& in, char const* inEnd,
+             char*& out, char* outEnd) override {
+
+        // Frames follow one another with no help needed.
+        ZSTD_inBuffer  input  { in, std::size_t(inEnd - in), 0 };
+        ZSTD_outBuffer output { out, std::size_t(outEnd - out), 0 };
+
+        std::size_t status = ZSTD_decompressStream(mContext, &output, &input);
+        if (ZSTD_isError(status))
+            throw corrupt(mFilename, ZSTD_getErrorName(status));
+
+        in  += input.pos;
+        out += output.pos;
+
+        // Zero means that the frame is over, and flushed.
+        mInside = status != 0;
+    }
+
+private:
+    std::string mFilename;
+    ZSTD_DCtx* mContext;
+};
+
+#endif
+
+InputBuf::InputBuf(std::string const& filename)
+    : mFd(::open(filename.c_str(), O_RDONLY, 0))
+    , mFilename(filename)
+    , mIn(RawBlockSize)
+    , mOut(SmallReadSize) {
+
+    if (mFd == -1)
+        throw std::ios_base::failure(filename);
+
+    // The destructor doesn't run for a constructor which throws, so the
+    // descriptor is closed by this guard until the end is reached.
+    auto closeFd = [](int* fd) { ::close(*fd); };
+    std::unique_ptr<int, decltype(closeFd)> fdGuard(&mFd, closeFd);
+
+    // The magic bytes are taken right from the data, so that a pipe
+    // needn't be read twice. A pipe may give less than asked for.
+    while (mInEnd < 4) {
+        ssize_t got = ::read(mFd, mIn.data() + mInEnd, 4 - mInEnd);
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got < 0)
+            throw std::ios_base::failure(filename);
+        if (got == 0)
+            break;
+        mInEnd += got;
+    }
+
+    mCompression = compressionOf(mIn.data(), mInEnd);
+    if (mCompression == Compression::Gzip)
+        mCodec.reset(new GzipCodec(filename));
+
+    if (mCompression == Compression::Zstd) {
+#if defined(HAVE_ZSTD)
+        mCodec.reset(new ZstdCodec(filename));
+#else
+        throw corrupt(filename, "zstd support isn't built in");
+#endif
+    }
+
+    fdGuard.release();
+}
+
+InputBuf::~InputBuf() {
+    ::close(mFd);
+}
+
+bool InputBuf::readRaw() {
+    mInBegin = mInEnd = 0;
+    while (1) {
+        ssize_t got = ::read(mFd, mIn.data(), mIn.size());
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got < 0)
+            throw std::ios_base::failure(mFilename);
+
+        mInEnd = got;
+        return got != 0;
+    }
+}
+
+std::size_t InputBuf::fill(char* dest, std::size_t size) {
+    if (!mCodec) {
+        // Whatever was read to tell the format goes first, and the rest
+        // is read right into 'dest'.
+        if (mInBegin == mInEnd) {
+            while (1) {
+                ssize_t got = ::read(mFd, dest, size);
+                if (got < 0 && errno == EINTR)
+                    continue;
+                if (got < 0)
+                    throw std::ios_base::failure(mFilename);
+                return got;
+            }
+        }
+
+        std::size_t num = std::min(size, mInEnd - mInBegin);
+        std::memcpy(dest, mIn.data() + mInBegin, num);
+        mInBegin += num;
+        return num;
+    }
+
+    char* out = dest;
+    while (out == dest) {
+        char const* in = mIn.data() + mInBegin;
+
+        if (mInBegin == mInEnd && !readRaw()) {
+            // The codec may still hold some output back, but nothing else
+            // is coming.
+            if (!mCodec->inside())
+                break;
+
+            mCodec->run(in, in, out, dest + size);
+            if (out == dest)
+                throw corrupt(mFilename, "unexpected end of file");
+            break;
+        }
+
+        in = mIn.data() + mInBegin;
+        mCodec->run(in, mIn.data() + mInEnd, out, dest + size);
+        mInBegin = in - mIn.data();
+    }
+
+    return out - dest;
+}
+
+InputBuf::int_type InputBuf::underflow() {
+    if (gptr() == egptr()) {
+        std::size_t num = fill(mOut.data(), mOut.size());
+        setg(mOut.data(), mOut.data(), mOut.data() + num);
+    }
+
+    return gptr() == egptr() ? traits_type::eof()
+                             : traits_type::to_int_type(*gptr());
+}
+
+std::streamsize InputBuf::xsgetn(char* dest, std::streamsize size) {
+    // What's left of the small reads goes first.
+    std::streamsize done = std::min<std::streamsize>(egptr() - gptr(), size);
+    if (done != 0) {
+        std::memcpy(dest, gptr(), done);
+        gbump(done);
+    }
+
+    while (done < size) {
+        std::size_t num = fill(dest + done, size - done);
+        if (num == 0)
+            break;
+        done += num;
+    }
+
+    return done;
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <istream>
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+enum class Compression { None, Gzip, Zstd };
+
+/*
+ * Tells how a file is compressed by its first bytes, not by its name.
+ * Reads them, so it's no good for pipes.
+ */
+Compression detectCompression(std::string const& filename);
+
+/*
+ * A stream buffer which reads a file, and decompresses it on the fly if it
+ * happens to be gzip or zstd compressed. Concatenated members and frames,
+ * which is what log rotation tends to produce, are read one after another.
+ *
+ * Large reads, like the ones of a ring buffer refill, are decompressed
+ * right into the reader's memory, with nothing copied on the way. Plain
+ * files are read into it directly, too.
+ *
+ * Corrupt or truncated data is thrown as 'std::ios_base::failure'.
+ */
+class InputBuf: public std::streambuf {
+public:
+
+    // Throws 'std::ios_base::failure' if the file can't be opened.
+    explicit InputBuf(std::string const& filename);
+    ~InputBuf();
+
+    Compression compression() const { return mCompression; }
+
+protected:
+
+    int_type underflow() override;
+    std::streamsize xsgetn(char* dest, std::streamsize size) override;
+
+private:
+
+    class Codec;
+    class GzipCodec;
+    class ZstdCodec;
+
+    // Puts up to 'size' bytes of decompressed data into 'dest', and
+    // returns how many, which is zero only at the end of the file.
+    std::size_t fill(char* dest, std::size_t size);
+
+    // Reads the next block of raw data into 'mIn', returns 'false' at
+    // the end of the file.
+    bool readRaw();
+
+    int mFd;
+    std::string mFilename;
+    Compression mCompression = Compression::None;
+    std::unique_ptr<Codec> mCodec;
+
+    // Raw data not consumed yet is [mInBegin, mInEnd) of 'mIn'.
+    std::vector<char> mIn;
+    std::size_t mInBegin = 0;
+    std::size_t mInEnd   = 0;
+
+    // Serves the small reads.
+    std::vector<char> mOut;
+};
+
+/*
+ * What 'std::ifstream' is for plain files, for possibly compressed ones.
+ * Errors are thrown, rather than just flagged, since otherwise a corrupt
+ * archive would simply look shorter than it is.
+ */
+class InputStream: public std::istream {
+public:
+
+    explicit InputStream(std::string const& filename)
+        : std::istream(nullptr)
+        , mBuf(filename) {
+        rdbuf(&mBuf);
+        exceptions(std::ios_base::badbit);
+    }
+
+    Compression compression() const { return mBuf.compression(); }
+
+private:
+    InputBuf mBuf;
+};
@@ -1,28 +1,61 @@
 #include "MemoryMappedFile.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <memory>
 #include <system_error>
 
 extern "C" {
     #include <errno.h>
     #include <fcntl.h>
     #include <sys/mman.h>
+    #include <unistd.h>
+}
+
+namespace {
+
+// The address must be page aligned, so the range's beginning is rounded
+// down to the page boundary. The length is rounded by the kernel.
+bool adviseRange(char const* addr, size_t length, int advice) {
+    size_t pageSize = ::sysconf(_SC_PAGESIZE);
+    size_t skew = reinterpret_cast<std::uintptr_t>(addr) % pageSize;
+
+    return ::madvise(const_cast<char*>(addr - skew), length + skew,
+                     advice) == 0;
+}
+
+} // namespace
+
+void adviseMapping(char const* addr, std::size_t length,
+                   MappingOptions const& options, int advice) {
+    if (advice != 0)
+        adviseRange(addr, length, advice);
+    if (options.sequential)
+        adviseRange(addr, length, MADV_SEQUENTIAL);
+    if (options.hugePages)
+        adviseRange(addr, length, MADV_HUGEPAGE);
 }
 
 MemoryMappedFile::MemoryMappedFile()
-    : mRegionAddr(nullptr)
+    : mFd(-1)
+    , mRegionAddr(nullptr)
     , mRegionLength(0)
     {}
 
-MemoryMappedFile::MemoryMappedFile(char const* filename)
+MemoryMappedFile::MemoryMappedFile(char const* filename,
+                                   MappingOptions const& options)
     : MemoryMappedFile() {
 
     mFilename = filename;
+    mOptions = options;
     open();
 }
 
-MemoryMappedFile::MemoryMappedFile(std::string const& filename)
+MemoryMappedFile::MemoryMappedFile(std::string const& filename,
+                                   MappingOptions const& options)
     : MemoryMappedFile() {
 
     mFilename = filename;
+    mOptions = options;
     open();
 }
 
@@ -46,6 +79,10 @@ void MemoryMappedFile::open() {
     int fd = -1;
     void *addr = MAP_FAILED;
     off_t length = 0;
+    int flags = MAP_SHARED;
+
+    if (isOpen())
+        return;
 
     fd = ::open(mFilename.c_str(), O_RDONLY, 0);
     if (fd == -1)
@@ -55,24 +92,38 @@ void MemoryMappedFile::open() {
     if (length == -1)
         goto e_failure;
 
-    if (length > SIZE_MAX)
+    if ((std::uint64_t)length > SIZE_MAX)
         goto e_failure;
 
-    addr = ::mmap(0, (size_t)length, PROT_READ, MAP_SHARED, fd, 0);
+    if (mOptions.populate)
+        flags |= MAP_POPULATE;
+
+    addr = ::mmap(0, (size_t)length, PROT_READ, flags, fd, 0);
     if (addr == MAP_FAILED)
         goto e_failure;
 
-    if (::close(fd) == -1)
-        goto e_failure;
+    // The descriptor is kept, since the page cache can only be told to
+    // drop the file's pages through it.
+    if (!mOptions.dropConsumed) {
+        if (::close(fd) == -1)
+            goto e_failure;
+        fd = -1;
+    }
 
     // Delay these assignments until the moment when nothing bad
     // can happen. Exception safety, kinda.
+    mFd = fd;
     mRegionAddr = addr;
     mRegionLength = (size_t)length;
+
+    adviseMapping(begin(), mRegionLength, mOptions);
     return;
 
 e_failure:
     int errorNo = errno;
+    if (addr != MAP_FAILED)
+        ::munmap(addr, (size_t)length);
+
     if (fd != -1) {
         // Sorry, no more error handling for today. To be honest,
         // I just don't know what the program should do if the following
@@ -92,6 +143,13 @@ void MemoryMappedFile::close(bool noThrow) {
 
     mRegionAddr = nullptr;
     mRegionLength = 0;
+
+    if (mFd != -1) {
+        int fd = mFd;
+        mFd = -1;
+        if (::close(fd) == -1)
+            goto e_failure;
+    }
     return;
 
 e_failure:
@@ -100,3 +158,197 @@ e_failure:
 
     throw std::system_error(errno, std::system_category(), mFilename);
 }
+
+bool MemoryMappedFile::advise(int advice, size_t offset, size_t length) {
+    if (mRegionAddr == nullptr || offset >= mRegionLength)
+        return false;
+
+    length = std::min(length, mRegionLength - offset);
+    return adviseRange(begin() + offset, length, advice);
+}
+
+bool MemoryMappedFile::release(size_t offset, size_t length) {
+    if (mRegionAddr == nullptr || offset >= mRegionLength)
+        return false;
+
+    length = std::min(length, mRegionLength - offset);
+
+    // Unlike with 'advise', a page which is only partially inside the range
+    // must be left alone, since somebody else may still be using the rest.
+    size_t pageSize = ::sysconf(_SC_PAGESIZE);
+    size_t first = (offset + pageSize - 1) / pageSize * pageSize;
+    size_t last  = (offset + length) / pageSize * pageSize;
+    if (offset + length == mRegionLength)
+        last = offset + length;
+    if (first >= last)
+        return true;
+
+    // Unmapping the pages is not enough, they stay in the page cache until
+    // the kernel is also told that the file's data won't be needed.
+    char* addr = static_cast<char*>(mRegionAddr) + first;
+    bool unmapped = ::madvise(addr, last - first, MADV_DONTNEED) == 0;
+    bool dropped = mFd != -1
+        && ::posix_fadvise(mFd, first, last - first, POSIX_FADV_DONTNEED) == 0;
+
+    return unmapped && dropped;
+}
+
+// Releasing is a system call, and not a cheap one, so it's done in steps.
+constexpr size_t ReleaseStep = 4*1024*1024;
+
+MappedScan::MappedScan(MemoryMappedFile& file, size_t begin, size_t end)
+    : mFile(file)
+    , mEnd(end)
+    , mReleased(begin)
+    , mPosition(begin)
+    , mStop(false) {
+
+    if (file.options().readAhead != 0 && begin < end)
+        mThread = std::thread(&MappedScan::readAhead, this);
+}
+
+MappedScan::~MappedScan() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStop = true;
+    }
+    mWake.notify_one();
+
+    if (mThread.joinable())
+        mThread.join();
+
+    if (mFile.options().dropConsumed)
+        mFile.release(mReleased, mPosition - mReleased);
+}
+
+void MappedScan::advance(size_t offset) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (offset <= mPosition)
+            return;
+        mPosition = offset;
+    }
+    mWake.notify_one();
+
+    if (mFile.options().dropConsumed && mPosition - mReleased >= ReleaseStep) {
+        mFile.release(mReleased, mPosition - mReleased);
+        mReleased = mPosition;
+    }
+}
+
+/*
+ * Touches a byte of every page up to 'readAhead' bytes ahead of the
+ * scanner, so that the page faults are taken here rather than by the
+ * scanner. The pages are shared, so once one is mapped for this thread,
+ * it's mapped for the scanner as well.
+ */
+void MappedScan::readAhead() {
+    size_t const pageSize = ::sysconf(_SC_PAGESIZE);
+    size_t const distance = mFile.options().readAhead;
+
+    size_t ahead;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        ahead = mPosition;
+    }
+
+    char const* data = mFile.begin();
+    while (1) {
+        size_t target;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mWake.wait(lock, [&]{
+                return mStop || ahead < std::min(mEnd, mPosition + distance);
+            });
+
+            if (mStop)
+                return;
+
+            // The scanner may have overtaken the thread, then there's no
+            // point in touching what it has already passed.
+            ahead  = std::max(ahead, mPosition);
+            target = std::min(mEnd, mPosition + distance);
+        }
+
+        // Not all of it at once, so that a stop request doesn't wait long.
+        target = std::min(target, ahead + ReleaseStep);
+
+        unsigned char sum = 0;
+        for (; ahead < target; ahead += pageSize)
+            sum += *reinterpret_cast<unsigned char volatile const*>(data + ahead);
+        (void)sum;
+
+        ahead = std::min(ahead, target);
+    }
+}
+
+MappedWindow::MappedWindow(std::string const& filename,
+                           MappingOptions const& options)
+    : mFilename(filename)
+    , mOptions(options)
+    , mFd(-1)
+    , mFileSize(0)
+    , mPageSize(::sysconf(_SC_PAGESIZE))
+    , mAddr(nullptr)
+    , mOffset(0)
+    , mLength(0) {
+
+    mWindowSize = std::max<std::size_t>(options.windowSize, 2 * mPageSize);
+    mWindowSize = (mWindowSize + mPageSize - 1) / mPageSize * mPageSize;
+
+    mFd = ::open(mFilename.c_str(), O_RDONLY, 0);
+    if (mFd == -1)
+        throw std::system_error(errno, std::system_category(), mFilename);
+
+    // The destructor doesn't run for a constructor which throws, so the
+    // descriptor is closed by this guard until the first window is mapped.
+    auto closeFd = [](int* fd) { ::close(*fd); };
+    std::unique_ptr<int, decltype(closeFd)> fdGuard(&mFd, closeFd);
+
+    off_t length = ::lseek(mFd, 0, SEEK_END);
+    if (length == -1)
+        throw std::system_error(errno, std::system_category(), mFilename);
+
+    mFileSize = length;
+    moveTo(0);
+    fdGuard.release();
+}
+
+MappedWindow::~MappedWindow() {
+    unmap();
+    ::close(mFd);
+}
+
+void MappedWindow::unmap() {
+    if (mAddr != nullptr)
+        ::munmap(mAddr, mLength);
+
+    mAddr = nullptr;
+}
+
+void MappedWindow::moveTo(std::uint64_t offset) {
+    std::uint64_t aligned = std::min(offset, mFileSize) / mPageSize * mPageSize;
+    std::uint64_t oldOffset = mOffset;
+
+    unmap();
+    mOffset = aligned;
+    mLength = std::min<std::uint64_t>(mWindowSize, mFileSize - aligned);
+
+    if (mOptions.dropConsumed && aligned > oldOffset)
+        ::posix_fadvise(mFd, oldOffset, aligned - oldOffset,
+                        POSIX_FADV_DONTNEED);
+
+    // Nothing left to map, which 'mmap()' doesn't like.
+    if (mLength == 0)
+        return;
+
+    int flags = MAP_SHARED | (mOptions.populate ? MAP_POPULATE : 0);
+    void *addr = ::mmap(0, mLength, PROT_READ, flags, mFd, aligned);
+    if (addr == MAP_FAILED) {
+        mLength = 0;
+        throw std::system_error(errno, std::system_category(), mFilename);
+    }
+
+    mAddr = addr;
+    adviseMapping(begin(), mLength, mOptions);
+}
@@ -1,23 +1,89 @@
 #pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <boost/noncopyable.hpp>
 
+/*
+ * What the kernel is told about a mapping. Everything is off by default,
+ * which is a plain 'mmap()' with no hints at all.
+ */
+struct MappingOptions {
+    // Read the whole file in and map every page right in 'open()', so
+    // that the scan never waits for a page fault. The price is that
+    // 'open()' doesn't return until the whole file is in memory.
+    bool populate = false;
+
+    // Read ahead aggressively, and drop the pages behind sooner.
+    bool sequential = false;
+
+    // Ask for transparent huge pages. Only a few filesystems can back
+    // a file mapping with them, elsewhere the hint is silently ignored.
+    bool hugePages = false;
+
+    // How many bytes a background thread keeps faulted in ahead of every
+    // 'MappedScan', no thread at all if zero.
+    std::size_t readAhead = 0;
+
+    // Release whatever a 'MappedScan' has passed, both from the mapping
+    // and from the page cache, so that a long scan doesn't push the rest
+    // of the system's files out of memory.
+    bool dropConsumed = false;
+
+    // Map the file by windows of that many bytes rather than all at once
+    // (see 'MappedWindow'), zero means the whole file.
+    std::size_t windowSize = 0;
+};
+
+/*
+ * Gives the kernel 'advice' for the [addr, addr+length) range of a mapping,
+ * which needn't begin at a page boundary, and then whatever hints 'options'
+ * ask for. They are all just hints, so nobody cares if the kernel disagrees.
+ * Zero is MADV_NORMAL, which asks for nothing besides the options.
+ */
+void adviseMapping(char const* addr, std::size_t length,
+                   MappingOptions const& options, int advice = 0);
+
 class MemoryMappedFile: public boost::noncopyable {
 public:
 
     using const_iterator = char*;
 
     MemoryMappedFile();
-    MemoryMappedFile(char const* filename);
-    MemoryMappedFile(std::string const& filename);
+    MemoryMappedFile(char const* filename,
+                     MappingOptions const& options = MappingOptions());
+    MemoryMappedFile(std::string const& filename,
+                     MappingOptions const& options = MappingOptions());
 
     ~MemoryMappedFile();
 
+    // Maps the file, unless it's already mapped.
     void open();
     void close(bool noThrow = false);
 
     bool isOpen() const { return mRegionAddr != nullptr; }
 
+    MappingOptions const& options() const { return mOptions; }
+
+    /*
+     * Passes 'madvise()' hint for the [offset, offset+length) range of
+     * the mapping, the whole file by default. Returns 'false' if the
+     * kernel didn't like the advice, which is not an error: the advice
+     * is just a hint.
+     */
+    bool advise(int advice, size_t offset = 0, size_t length = SIZE_MAX);
+
+    /*
+     * Releases the whole pages inside [offset, offset+length) from the
+     * mapping and from the page cache. The data is still there, it's just
+     * read from the file again if somebody looks at it. Returns 'false' if
+     * the kernel refused, which isn't an error either.
+     */
+    bool release(size_t offset, size_t length);
+
     const_iterator begin() const {
         return static_cast<char*>(mRegionAddr);
     }
@@ -29,6 +95,97 @@ public:
 private:
 
     std::string mFilename;
+    MappingOptions mOptions;
+    int    mFd;
     void  *mRegionAddr;
     size_t mRegionLength;
 };
+
+/*
+ * A front-to-back scan of the [begin, end) range of a mapping. The scanner
+ * reports how far it has got with 'advance', and the scan does what the
+ * mapping's options ask for: keeps the pages ahead faulted in by a thread
+ * of its own, and releases the pages behind. Several scans of different
+ * ranges of the same mapping may run at once.
+ */
+class MappedScan: public boost::noncopyable {
+public:
+
+    MappedScan(MemoryMappedFile& file, size_t begin, size_t end);
+    ~MappedScan();
+
+    // Everything before 'offset' has been looked at, and won't be again.
+    void advance(size_t offset);
+
+private:
+
+    void readAhead();
+
+    MemoryMappedFile& mFile;
+    size_t mEnd;
+    size_t mReleased;       // Everything before it has been released.
+
+    std::mutex mMutex;
+    std::condition_variable mWake;
+    size_t mPosition;       // Where the scanner is.
+    bool   mStop;
+
+    std::thread mThread;
+};
+
+/*
+ * Maps a file by windows of a fixed size rather than all at once, so that
+ * a file of any size can be scanned with a bounded address space footprint.
+ * Windows are page aligned, and the scanner moves the window forward as it
+ * goes, so that the new one overlaps the old one by as much as needed for
+ * whatever was cut by the old window's end.
+ *
+ * Offsets are file offsets. The window's own iterators are plain pointers,
+ * valid until it's moved, and 'begin()[k]' is the byte at 'offset() + k'.
+ */
+class MappedWindow: public boost::noncopyable {
+public:
+
+    using const_iterator = char const*;
+
+    // The window size is rounded up to a whole number of pages, two at
+    // least, so that a window moved to any offset has something past it.
+    MappedWindow(std::string const& filename,
+                 MappingOptions const& options);
+
+    ~MappedWindow();
+
+    std::uint64_t fileSize() const { return mFileSize; }
+
+    /*
+     * Maps the window which begins at the page boundary at or before
+     * 'offset'. The window before it is unmapped, and if the options ask
+     * for that, its pages which the new one doesn't cover are dropped
+     * from the page cache.
+     */
+    void moveTo(std::uint64_t offset);
+
+    std::uint64_t offset()    const { return mOffset; }
+    std::uint64_t endOffset() const { return mOffset + mLength; }
+
+    // There's nothing in the file past this window.
+    bool isLast() const { return endOffset() == mFileSize; }
+
+    const_iterator begin() const { return static_cast<char*>(mAddr); }
+    const_iterator end()   const { return begin() + mLength; }
+
+private:
+
+    void unmap();
+
+    std::string    mFilename;
+    MappingOptions mOptions;
+    int            mFd;
+    std::uint64_t  mFileSize;
+    std::size_t    mPageSize;
+    std::size_t    mWindowSize;
+
+    void         *mAddr;
+    std::uint64_t mOffset;
+    std::size_t   mLength;
+};
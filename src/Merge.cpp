@@ -0,0 +1,73 @@
+#include "Merge.hpp"
+#include <fstream>
+#include <ios>
+#include <memory>
+#include "InputFiles.hpp"
+#include "PartialResult.hpp"
+
+namespace {
+
+// Prints the merged top list of partial results, which is always exact.
+void printTop(std::ofstream& out, MergedTable const& table) {
+    for (auto const& entry: table.top)
+        out << entry.count << ' ' << entry.key << std::endl;
+}
+
+void printSize(std::ofstream& out, MergedTable const& table) {
+    if (table.estimated)
+        out << '~';
+    out << table.distinct;
+}
+
+} // namespace
+
+void printMergedReport(ThreadPool& pool,
+                       std::vector<std::string> const& partialArgs,
+                       unsigned maxNum, std::string const& outputFn) {
+    std::vector<std::unique_ptr<PartialResultFile>> files;
+    for (auto const& input: listInputFiles(partialArgs))
+        files.emplace_back(new PartialResultFile(input.path));
+
+    MergedTable urlDomains, urlPaths;
+    urlDomains.kind = PartialKind::Domains;
+    urlPaths.kind = PartialKind::Paths;
+    std::vector<MergedTable> extra;
+
+    for (auto& table: mergePartialResults(files, maxNum, pool)) {
+        if (table.kind == PartialKind::Domains)
+            urlDomains = std::move(table);
+        else if (table.kind == PartialKind::Paths)
+            urlPaths = std::move(table);
+        else
+            extra.push_back(std::move(table));
+    }
+
+    std::ofstream output(outputFn);
+    if (!output.is_open())
+        throw std::ios_base::failure(outputFn);
+
+    output << "total urls " << urlDomains.total << ", " << "domains ";
+    printSize(output, urlDomains);
+    output << ", paths ";
+    printSize(output, urlPaths);
+    output << std::endl << std::endl;
+
+    output << "top domains" << std::endl;
+    printTop(output, urlDomains);
+    output << std::endl;
+
+    output << "top paths" << std::endl;
+    printTop(output, urlPaths);
+
+    for (auto const& table: extra) {
+        output << std::endl;
+        output << "total " << table.name << ' ' << table.total
+               << ", distinct ";
+        printSize(output, table);
+        output << std::endl << std::endl;
+
+        output << "top " << table.name << std::endl;
+        printTop(output, table);
+    }
+
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "ThreadPool.hpp"
+
+/*
+ * Merges partial results of any number of scans, given the way inputs are
+ * (see 'listInputFiles'), and writes the same report a single scan of all
+ * their inputs would to 'outputFn'. The extra patterns come in the order
+ * they're first met in the files.
+ */
+void printMergedReport(ThreadPool& pool,
+                       std::vector<std::string> const& partialArgs,
+                       unsigned maxNum, std::string const& outputFn);
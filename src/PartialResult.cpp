@@ -0,0 +1,506 @@
+#include "PartialResult.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <ios>
+#include <map>
+#include <stdexcept>
+#include <utility>
+#include "FrequencyTable.hpp"
+#include "HyperLogLog.hpp"
+#include "ThreadPool.hpp"
+
+namespace {
+
+const char Magic[8] = {'S', 'P', 'D', 'R', 'U', 'N', 'P', 'R'};
+
+struct RawHeader {
+    char          magic[8];
+    std::uint32_t version;
+    std::uint32_t numTables;
+};
+
+struct RawTable {
+    std::uint32_t kind;
+    std::uint32_t nameSize;
+    std::uint64_t nameOffset;
+    std::uint64_t total;
+    std::uint64_t numEntries;
+    std::uint64_t entriesOffset;
+    std::uint64_t keysOffset;
+    std::uint64_t keysSize;
+    std::uint64_t sketchOffset;     // Zero if there's no estimator.
+};
+
+// Key offsets are from the beginning of the table's keys.
+struct RawEntry {
+    std::uint64_t keyOffset;
+    std::uint32_t keySize;
+    std::uint32_t reserved;
+    std::uint64_t count;
+};
+
+// Followed by the entries or the registers.
+struct RawSketch {
+    std::uint32_t precision;
+    std::uint32_t sparse;
+    std::uint64_t size;
+};
+
+// Follows everything else in a checkpoint, so that it's found at the end.
+struct RawProgress {
+    std::uint64_t fingerprint;
+    std::uint64_t inputIndex;
+    std::uint64_t offset;
+    char          magic[8];
+};
+
+const char ProgressMagic[8] = {'S', 'P', 'D', 'R', 'U', 'N', 'C', 'K'};
+
+static_assert(sizeof(RawHeader) == 16 && sizeof(RawTable) == 64
+              && sizeof(RawEntry) == 24 && sizeof(RawSketch) == 16
+              && sizeof(RawProgress) == 32,
+              "partial result structures mustn't have padding");
+
+// A sparse estimator entry is a 25-bit index and a 6-bit value.
+const std::uint32_t SparseEntryLimit = 1u << (HyperLogLog::SparsePrecision
+                                              + 6);
+
+std::uint64_t alignUp(std::uint64_t offset) {
+    return (offset + 7) & ~std::uint64_t(7);
+}
+
+// Writes zeroes from the end of 'size' bytes up to the next 8-byte boundary.
+void writePadding(std::ofstream& out, std::uint64_t size) {
+    static const char zeroes[8] = {};
+    out.write(zeroes, alignUp(size) - size);
+}
+
+void writeAligned(std::ofstream& out, void const* data, std::size_t size) {
+    out.write(static_cast<char const*>(data), size);
+    writePadding(out, size);
+}
+
+/*
+ * What a table turns into in the file, everything it takes to lay it out
+ * before anything is written.
+ */
+struct TableLayout {
+    RawTable raw;
+    std::vector<FrequencyTable::const_pointer> entries;
+    std::vector<std::uint32_t> sparse;
+    std::vector<std::uint8_t> dense;
+};
+
+using Entry = PartialResultFile::Entry;
+
+// The order of 'FrequencyTable::top': by count descending, then by key.
+bool comesBefore(Entry const& a, Entry const& b) {
+    if (a.count == b.count)
+        return a.key < b.key;
+    return a.count > b.count;
+}
+
+std::string titleOf(MergedTable const& table) {
+    if (table.kind == PartialKind::Domains)
+        return "domains";
+    if (table.kind == PartialKind::Paths)
+        return "paths";
+    return table.name;
+}
+
+/*
+ * Where a merge is in one of the tables. The heap of them has the cursor
+ * with the smallest key on top.
+ */
+struct Cursor {
+    PartialResultFile const* file;
+    PartialResultFile::Table const* table;
+    std::uint64_t index;
+    Entry entry;
+
+    bool operator < (Cursor const& other) const {
+        return other.entry.key < entry.key;
+    }
+};
+
+/*
+ * Merges the tables of the same kind and name. Keys come out of the heap
+ * of cursors in order, so the counts of the same key come out in a row,
+ * and only the best 'maxNum' of the sums are kept.
+ */
+MergedTable mergeTables(
+    std::vector<std::pair<PartialResultFile const*,
+                          PartialResultFile::Table const*>> const& group,
+    std::size_t maxNum) {
+
+    auto const& first = *group.front().second;
+
+    MergedTable merged;
+    merged.kind = first.kind;
+    merged.name = first.name.str();
+
+    std::unique_ptr<HyperLogLog> distinct;
+    if (first.precision != 0)
+        distinct.reset(new HyperLogLog(first.precision));
+
+    std::vector<Cursor> cursors;
+    for (auto const& item: group) {
+        auto const& table = *item.second;
+        merged.total += table.total;
+
+        if (table.precision != first.precision) {
+            throw std::invalid_argument(
+                "partial results of " + titleOf(merged) +
+                ((table.precision == 0 || first.precision == 0)
+                     ? " differ in having distinct key estimators"
+                     : " have estimators of different precisions"));
+        }
+
+        if (distinct && table.sparse) {
+            distinct->mergeSparse(
+                static_cast<std::uint32_t const*>(table.sketch),
+                table.sketchSize);
+        } else if (distinct) {
+            distinct->mergeDense(
+                static_cast<std::uint8_t const*>(table.sketch));
+        }
+
+        if (table.numEntries != 0) {
+            cursors.push_back(Cursor {item.first, &table, 0,
+                                      item.first->entry(table, 0)});
+        }
+    }
+
+    std::make_heap(cursors.begin(), cursors.end());
+
+    std::vector<Entry>& heap = merged.top;
+    while (!cursors.empty()) {
+        Entry sum {cursors.front().entry.key, 0};
+
+        while (!cursors.empty() && cursors.front().entry.key == sum.key) {
+            std::pop_heap(cursors.begin(), cursors.end());
+            Cursor& cursor = cursors.back();
+            sum.count += cursor.entry.count;
+
+            if (++cursor.index == cursor.table->numEntries) {
+                cursors.pop_back();
+                continue;
+            }
+
+            // Everything depends on the order, so it's not taken on trust.
+            Entry next = cursor.file->entry(*cursor.table, cursor.index);
+            if (!(cursor.entry.key < next.key)) {
+                throw std::ios_base::failure(cursor.file->filename()
+                                             + ": keys out of order");
+            }
+            cursor.entry = next;
+            std::push_heap(cursors.begin(), cursors.end());
+        }
+
+        ++merged.distinct;
+
+        if (maxNum == 0)
+            continue;
+
+        if (heap.size() < maxNum) {
+            heap.push_back(sum);
+            std::push_heap(heap.begin(), heap.end(), comesBefore);
+        } else if (comesBefore(sum, heap.front())) {
+            std::pop_heap(heap.begin(), heap.end(), comesBefore);
+            heap.back() = sum;
+            std::push_heap(heap.begin(), heap.end(), comesBefore);
+        }
+    }
+
+    std::sort_heap(heap.begin(), heap.end(), comesBefore);
+
+    if (distinct) {
+        merged.distinct = std::llround(distinct->estimate());
+        merged.estimated = true;
+    }
+
+    return merged;
+}
+
+} // namespace
+
+void writePartialResult(std::string const& filename,
+                        std::vector<PartialTable> const& tables,
+                        ScanProgress const* progress) {
+
+    std::vector<TableLayout> layouts(tables.size());
+    std::uint64_t offset = sizeof(RawHeader)
+                         + tables.size() * sizeof(RawTable);
+
+    for (std::size_t k = 0; k < tables.size(); ++k) {
+        PartialTable const& table = tables[k];
+        TableLayout& layout = layouts[k];
+        RawTable& raw = layout.raw;
+
+        for (auto const& entry: *table.counts)
+            layout.entries.push_back(&entry);
+
+        std::sort(layout.entries.begin(), layout.entries.end(),
+                  [](FrequencyTable::const_pointer a,
+                     FrequencyTable::const_pointer b) {
+                      return a->key() < b->key();
+                  });
+
+        raw = RawTable {};
+        raw.kind = static_cast<std::uint32_t>(table.kind);
+        raw.total = table.total;
+
+        raw.nameSize = table.name.size();
+        raw.nameOffset = offset;
+        offset += alignUp(raw.nameSize);
+
+        raw.numEntries = layout.entries.size();
+        raw.entriesOffset = offset;
+        offset += raw.numEntries * sizeof(RawEntry);
+
+        for (auto ptr: layout.entries)
+            raw.keysSize += ptr->key().size();
+        raw.keysOffset = offset;
+        offset += alignUp(raw.keysSize);
+
+        if (table.distinct) {
+            table.distinct->save(layout.sparse, layout.dense);
+            raw.sketchOffset = offset;
+            offset += sizeof(RawSketch) + alignUp(
+                layout.sparse.size() * sizeof(std::uint32_t)
+                + layout.dense.size());
+        }
+    }
+
+    std::ofstream out(filename, std::ios_base::binary);
+    if (!out.is_open())
+        throw std::ios_base::failure(filename);
+
+    RawHeader header {};
+    std::memcpy(header.magic, Magic, sizeof Magic);
+    header.version = PartialResultFile::Version;
+    header.numTables = tables.size();
+    out.write(reinterpret_cast<char const*>(&header), sizeof header);
+
+    for (auto const& layout: layouts)
+        out.write(reinterpret_cast<char const*>(&layout.raw), sizeof(RawTable));
+
+    for (std::size_t k = 0; k < tables.size(); ++k) {
+        TableLayout const& layout = layouts[k];
+
+        writeAligned(out, tables[k].name.data(), tables[k].name.size());
+
+        RawEntry raw {};
+        for (auto ptr: layout.entries) {
+            raw.keySize = ptr->key().size();
+            raw.count = ptr->count();
+            out.write(reinterpret_cast<char const*>(&raw), sizeof raw);
+            raw.keyOffset += raw.keySize;
+        }
+
+        std::uint64_t keysSize = 0;
+        for (auto ptr: layout.entries) {
+            out.write(ptr->key().data(), ptr->key().size());
+            keysSize += ptr->key().size();
+        }
+        writePadding(out, keysSize);
+
+        if (tables[k].distinct) {
+            RawSketch sketch {};
+            sketch.precision = tables[k].distinct->precision();
+            sketch.sparse = layout.dense.empty();
+            sketch.size = sketch.sparse ? layout.sparse.size()
+                                        : layout.dense.size();
+            out.write(reinterpret_cast<char const*>(&sketch), sizeof sketch);
+
+            if (sketch.sparse) {
+                writeAligned(out, layout.sparse.data(),
+                             layout.sparse.size() * sizeof(std::uint32_t));
+            } else {
+                writeAligned(out, layout.dense.data(), layout.dense.size());
+            }
+        }
+    }
+
+    if (progress) {
+        RawProgress raw {};
+        raw.fingerprint = progress->fingerprint;
+        raw.inputIndex = progress->inputIndex;
+        raw.offset = progress->offset;
+        std::memcpy(raw.magic, ProgressMagic, sizeof ProgressMagic);
+        out.write(reinterpret_cast<char const*>(&raw), sizeof raw);
+    }
+
+    out.close();
+    if (!out)
+        throw std::ios_base::failure(filename);
+}
+
+PartialResultFile::PartialResultFile(std::string const& filename)
+    : mFilename(filename)
+    , mFile(filename) {
+
+    char const* data = mFile.begin();
+    std::uint64_t fileSize = mFile.end() - mFile.begin();
+
+    auto bad = [&](char const* what) {
+        return std::ios_base::failure(filename + ": " + what);
+    };
+
+    // Whether [offset, offset + size) is inside the file, with no overflow.
+    auto inside = [&](std::uint64_t offset, std::uint64_t size) {
+        return offset % 8 == 0 && offset <= fileSize
+            && size <= fileSize - offset;
+    };
+
+    if (fileSize < sizeof(RawHeader)
+            || std::memcmp(data, Magic, sizeof Magic) != 0)
+        throw bad("not a partial result");
+
+    auto const& header = *reinterpret_cast<RawHeader const*>(data);
+    if (header.version != Version)
+        throw bad("unsupported partial result version");
+
+    if (!inside(sizeof(RawHeader),
+                std::uint64_t(header.numTables) * sizeof(RawTable)))
+        throw bad("truncated");
+
+    // Whatever follows the last section may be the progress of a scan.
+    std::uint64_t dataEnd = sizeof(RawHeader)
+                          + std::uint64_t(header.numTables) * sizeof(RawTable);
+    auto section = [&](std::uint64_t offset, std::uint64_t size) {
+        dataEnd = std::max(dataEnd, offset + alignUp(size));
+    };
+
+    auto raws = reinterpret_cast<RawTable const*>(data + sizeof(RawHeader));
+    for (std::uint32_t k = 0; k < header.numTables; ++k) {
+        RawTable const& raw = raws[k];
+
+        if (raw.kind > static_cast<std::uint32_t>(PartialKind::Pattern))
+            throw bad("unknown table kind");
+
+        if (!inside(raw.nameOffset, raw.nameSize)
+                || raw.numEntries > fileSize / sizeof(RawEntry)
+                || !inside(raw.entriesOffset,
+                           raw.numEntries * sizeof(RawEntry))
+                || !inside(raw.keysOffset, raw.keysSize))
+            throw bad("truncated");
+
+        section(raw.nameOffset, raw.nameSize);
+        section(raw.entriesOffset, raw.numEntries * sizeof(RawEntry));
+        section(raw.keysOffset, raw.keysSize);
+
+        Table table;
+        table.kind = static_cast<PartialKind>(raw.kind);
+        table.name = StringRef(data + raw.nameOffset, raw.nameSize);
+        table.total = raw.total;
+        table.numEntries = raw.numEntries;
+        table.entries = data + raw.entriesOffset;
+        table.keys = data + raw.keysOffset;
+        table.keysSize = raw.keysSize;
+
+        table.precision = 0;
+        table.sparse = false;
+        table.sketchSize = 0;
+        table.sketch = nullptr;
+
+        if (raw.sketchOffset != 0) {
+            if (!inside(raw.sketchOffset, sizeof(RawSketch)))
+                throw bad("truncated");
+
+            auto const& sketch = *reinterpret_cast<RawSketch const*>(
+                data + raw.sketchOffset);
+            std::uint64_t sketchOffset = raw.sketchOffset + sizeof sketch;
+
+            if (sketch.precision < HyperLogLog::MinPrecision
+                    || sketch.precision > HyperLogLog::MaxPrecision
+                    || sketch.sparse > 1
+                    || (!sketch.sparse
+                        && sketch.size != (1u << sketch.precision)))
+                throw bad("corrupt distinct key estimator");
+
+            std::uint64_t itemSize = sketch.sparse ? sizeof(std::uint32_t)
+                                                   : 1;
+            if (sketch.size > fileSize
+                    || !inside(sketchOffset, sketch.size * itemSize))
+                throw bad("truncated");
+
+            table.precision = sketch.precision;
+            table.sparse = sketch.sparse;
+            table.sketchSize = sketch.size;
+            table.sketch = data + sketchOffset;
+            section(sketchOffset, sketch.size * itemSize);
+
+            // An index out of range would be written past the registers.
+            auto entries = static_cast<std::uint32_t const*>(table.sketch);
+            if (table.sparse && std::any_of(entries, entries + sketch.size,
+                    [](std::uint32_t entry) {
+                        return entry >= SparseEntryLimit;
+                    }))
+                throw bad("corrupt distinct key estimator");
+        }
+
+        mTables.push_back(table);
+    }
+
+    mHasProgress = fileSize >= dataEnd
+        && fileSize - dataEnd == sizeof(RawProgress)
+        && std::memcmp(data + fileSize - sizeof ProgressMagic,
+                       ProgressMagic, sizeof ProgressMagic) == 0;
+
+    if (mHasProgress) {
+        auto const& raw = *reinterpret_cast<RawProgress const*>(data
+                                                                + dataEnd);
+        mProgress = ScanProgress {raw.fingerprint, raw.inputIndex,
+                                  raw.offset};
+    }
+}
+
+PartialResultFile::Entry PartialResultFile::entry(Table const& table,
+                                                  std::uint64_t index) const {
+    auto const& raw = static_cast<RawEntry const*>(table.entries)[index];
+    if (raw.keyOffset > table.keysSize
+            || raw.keySize > table.keysSize - raw.keyOffset)
+        throw std::ios_base::failure(mFilename + ": key out of the file");
+
+    return Entry {StringRef(table.keys + raw.keyOffset, raw.keySize),
+                  raw.count};
+}
+
+std::vector<MergedTable> mergePartialResults(
+    std::vector<std::unique_ptr<PartialResultFile>> const& files,
+    std::size_t maxNum, ThreadPool& pool) {
+
+    using Group = std::vector<std::pair<PartialResultFile const*,
+                                        PartialResultFile::Table const*>>;
+
+    std::vector<Group> groups;
+    std::map<std::pair<PartialKind, std::string>, std::size_t> groupOf;
+
+    for (auto const& file: files) {
+        for (auto const& table: file->tables()) {
+            auto key = std::make_pair(table.kind, table.name.str());
+            auto found = groupOf.find(key);
+            if (found == groupOf.end()) {
+                found = groupOf.emplace(key, groups.size()).first;
+                groups.emplace_back();
+            }
+            groups[found->second].emplace_back(file.get(), &table);
+        }
+    }
+
+    std::vector<MergedTable> merged(groups.size());
+    std::vector<Task<void>> tasks;
+    for (std::size_t k = 0; k < groups.size(); ++k) {
+        tasks.push_back(pool.submit([&, k]{
+            merged[k] = mergeTables(groups[k], maxNum);
+        }));
+    }
+
+    for (auto& task: tasks)
+        task.get();
+
+    return merged;
+}
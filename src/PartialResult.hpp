@@ -0,0 +1,145 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include "MemoryMappedFile.hpp"
+#include "StringRef.hpp"
+
+class FrequencyTable;
+class HyperLogLog;
+class ThreadPool;
+
+/*
+ * A partial result is the counting state of a scan written to a file, so
+ * that scans of different parts of the input, on different machines even,
+ * can be merged into the same top lists a single scan would print.
+ *
+ * The file is read by mapping it, so it's nothing but plain structures in
+ * the host's byte order, each of them 8-byte aligned, and offsets counted
+ * from the beginning of the file:
+ *
+ *   header      the magic, the format version, the number of tables
+ *   tables      per table: what it counts, the total, and where its name,
+ *               entries, keys and sketch are
+ *   ...         per table: the name, the entries sorted by key, the keys
+ *               and, if the scan had one, the distinct keys estimator
+ *   progress    only in a checkpoint, see 'ScanProgress'
+ *
+ * It's the sorted entries which make merging cheap: any number of files
+ * is merged in a single pass, with no hash table of all the keys.
+ */
+
+enum class PartialKind: std::uint32_t { Domains = 0, Paths = 1, Pattern = 2 };
+
+// A table to write: the counts and, optionally, the estimator.
+struct PartialTable {
+    PartialKind kind;
+    std::string name;       // The title, for the extra patterns.
+    std::uint64_t total;
+    FrequencyTable const* counts;
+    HyperLogLog const* distinct;
+};
+
+/*
+ * Where a scan of many inputs has stopped. Written after the tables, it
+ * makes a partial result a checkpoint to resume the scan from, which is
+ * still a partial result, and merges just like any other.
+ */
+struct ScanProgress {
+    // Tells the inputs and the options of the scan, so that a checkpoint
+    // isn't resumed by a different one.
+    std::uint64_t fingerprint;
+
+    // The input to go on with, and the offset in it.
+    std::uint64_t inputIndex;
+    std::uint64_t offset;
+};
+
+// Throws 'std::ios_base::failure' if the file can't be written.
+void writePartialResult(std::string const& filename,
+                        std::vector<PartialTable> const& tables,
+                        ScanProgress const* progress = nullptr);
+
+/*
+ * A partial result file mapped into memory. Everything the header says is
+ * checked to be inside the file when it's opened, so a file which isn't
+ * a partial result, or is one of another version, or is cut short, is
+ * thrown as 'std::ios_base::failure'.
+ */
+class PartialResultFile: public boost::noncopyable {
+public:
+
+    static const std::uint32_t Version = 1;
+
+    struct Entry {
+        StringRef key;
+        std::uint64_t count;
+    };
+
+    struct Table {
+        PartialKind kind;
+        StringRef name;
+        std::uint64_t total;
+        std::uint64_t numEntries;
+
+        // The estimator, if 'precision' isn't zero: either 'sketchSize'
+        // sparse entries, or that many dense registers.
+        unsigned precision;
+        bool sparse;
+        std::uint64_t sketchSize;
+        void const* sketch;
+
+        void const* entries;
+        char const* keys;
+        std::uint64_t keysSize;
+    };
+
+    explicit PartialResultFile(std::string const& filename);
+
+    std::string const& filename() const { return mFilename; }
+
+    std::vector<Table> const& tables() const { return mTables; }
+
+    // Whether it's a checkpoint, and if it is, where the scan has stopped.
+    bool hasProgress() const { return mHasProgress; }
+    ScanProgress const& progress() const { return mProgress; }
+
+    // The 'index'th entry of 'table', in the order of keys. Throws if its
+    // key isn't inside the file.
+    Entry entry(Table const& table, std::uint64_t index) const;
+
+private:
+    std::string mFilename;
+    MemoryMappedFile mFile;
+    std::vector<Table> mTables;
+    bool mHasProgress;
+    ScanProgress mProgress;
+};
+
+/*
+ * A table merged over all the files. The number of distinct keys is exact
+ * unless the tables had estimators. The keys of the top list point into
+ * the files' mappings.
+ */
+struct MergedTable {
+    PartialKind kind;
+    std::string name;
+    std::uint64_t total = 0;
+    std::uint64_t distinct = 0;
+    bool estimated = false;
+    std::vector<PartialResultFile::Entry> top;
+};
+
+/*
+ * Merges the tables of the same kind and name over all of 'files', each
+ * group of them on a worker of 'pool', and keeps no more than 'maxNum'
+ * keys with the largest counts, in the order of 'FrequencyTable::top'.
+ * The merged tables are in the order they first appear in. Throws
+ * 'std::invalid_argument' for tables which can't be merged, like the ones
+ * with estimators of different precisions, or with and without them.
+ */
+std::vector<MergedTable> mergePartialResults(
+    std::vector<std::unique_ptr<PartialResultFile>> const& files,
+    std::size_t maxNum, ThreadPool& pool);
@@ -0,0 +1,46 @@
+#include "Patterns.hpp"
+#include <stdexcept>
+
+std::vector<std::string> splitList(std::string const& list) {
+    std::vector<std::string> items;
+    std::size_t pos = 0;
+    while (pos <= list.size()) {
+        std::size_t comma = std::min(list.find(',', pos), list.size());
+        items.push_back(list.substr(pos, comma - pos));
+        pos = comma + 1;
+    }
+
+    return items;
+}
+
+PatternSet::PatternSet(std::string const& list) {
+    add(PatternKind::Url, "urls", UrlTables<UrlGrammar>::literals());
+
+    for (auto const& name: splitList(list)) {
+        if (name == "email")
+            add(PatternKind::Email, "emails", {"@"});
+        else if (name == "ipv4")
+            add(PatternKind::Ipv4, "ipv4 addresses", {"."});
+        else if (name == "ftp")
+            add(PatternKind::Ftp, "ftp hosts", {"ftp://"});
+        else if (name == "ws")
+            add(PatternKind::Ws, "ws hosts", {"ws://", "wss://"});
+        else if (name.compare(0, 3, "id=") == 0 && name.size() > 3)
+            add(PatternKind::RequestId, name.substr(3) + " ids",
+                {name.substr(3)});
+        else
+            throw std::invalid_argument("unknown pattern: " + name);
+    }
+
+    mLiterals.build();
+}
+
+void PatternSet::add(PatternKind kind, std::string const& title,
+                     std::vector<std::string> const& literals) {
+    for (auto const& literal: literals) {
+        mLiterals.add(literal);
+        mPatternOf.push_back(mPatterns.size());
+    }
+
+    mPatterns.push_back(Pattern{kind, title});
+}
@@ -0,0 +1,286 @@
+#pragma once
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "AhoCorasick.hpp"
+#include "UrlSearch.hpp"
+
+/*
+ * Besides URLs, a few more kinds of things can be looked for. They are all
+ * found by a single Aho-Corasick automaton (see 'PatternSet'), which stops
+ * at a literal every one of them must contain, and then a validator looks
+ * around the literal to tell whether it's a real thing, and where it ends.
+ */
+enum class PatternKind {
+    Url,        // The literals of 'UrlGrammar', see 'parseUrl'.
+    Email,      // '@', with a local part before it, and a domain after.
+    Ipv4,       // '.', with four decimal octets around it.
+    Ftp,        // "ftp://" followed by a host name.
+    Ws,         // "ws://" or "wss://" followed by a host name.
+    RequestId   // A user-supplied prefix followed by [A-Za-z0-9_-]+.
+};
+
+/*
+ * Cuts a comma separated list of the command line into its items. An empty
+ * list is a single empty item, which is refused like any unknown one.
+ */
+std::vector<std::string> splitList(std::string const& list);
+
+struct Pattern {
+    PatternKind kind;
+    std::string title;      // How the report calls the things found.
+};
+
+/*
+ * The patterns to look for, and the literals which lead to them. URLs are
+ * always pattern zero, the extra ones follow in the order they were asked
+ * for on the command line.
+ */
+class PatternSet {
+public:
+
+    // Takes a comma separated list like "email,ipv4,ftp,ws,id=REQ-", and
+    // throws 'std::invalid_argument' on anything it doesn't know.
+    explicit PatternSet(std::string const& list);
+
+    std::size_t size() const { return mPatterns.size(); }
+
+    Pattern const& operator [] (unsigned pattern) const {
+        return mPatterns[pattern];
+    }
+
+    AhoCorasick const& literals() const { return mLiterals; }
+
+    unsigned patternOf(unsigned literal) const { return mPatternOf[literal]; }
+
+private:
+
+    void add(PatternKind kind, std::string const& title,
+             std::vector<std::string> const& literals);
+
+    std::vector<Pattern>  mPatterns;
+    std::vector<unsigned> mPatternOf;
+    AhoCorasick           mLiterals;
+};
+
+inline bool isDigit(char ch) { return ch >= '0' && ch <= '9'; }
+
+inline bool isAlnum(char ch) {
+    return isDigit(ch) || (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z');
+}
+
+inline bool isHostChar(char ch) { return isAlnum(ch) || ch == '.' || ch == '-'; }
+inline bool isIdChar(char ch)   { return isAlnum(ch) || ch == '_' || ch == '-'; }
+
+inline bool isEmailLocal(char ch) {
+    return isAlnum(ch) || ch == '.' || ch == '_' || ch == '%'
+        || ch == '+' || ch == '-';
+}
+
+/*
+ * Whitespace can't be a part of anything any of the patterns matches, so
+ * with extra patterns, chunks are cut at it (see 'allowedInUrl').
+ */
+inline bool isSpace(char ch) {
+    return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r'
+        || ch == '\f' || ch == '\v';
+}
+
+// RFC 5321 doesn't allow local parts any longer, and it's also how far
+// a validator ever looks behind the literal it was called for.
+constexpr UIndex MaxLocalPart = 64;
+constexpr UIndex LookBehind = MaxLocalPart + 1;
+
+/*
+ * What a validator has found: the whole match, and the key to count.
+ * Only 'begin' is meaningful unless the match has been found.
+ */
+struct Candidate {
+    UIndex begin;
+    UIndex end;
+    UIndex keyBegin;
+    UIndex keyEnd;
+};
+
+/*
+ * Finds the end of a host name starting at 'begin'. A trailing dot is more
+ * likely a full stop than a part of the name, so it's left out.
+ */
+template <typename Buffer>
+MatchStatus parseHost(Buffer const& buf, UIndex begin, UIndex end, bool final,
+                      UIndex& hostEnd) {
+    UIndex idx = begin;
+    while (idx != end && isHostChar(buf[idx]))
+        ++idx;
+
+    if (idx == end && !final)
+        return MatchStatus::NeedMore;
+
+    while (idx != begin && buf[idx-1] == '.')
+        --idx;
+
+    if (idx == begin)
+        return MatchStatus::Rejected;
+
+    hostEnd = idx;
+    return MatchStatus::Found;
+}
+
+/*
+ * Validators are given the literal they were called for at [at, atEnd),
+ * and 'floor', behind which they must not look: it's either the beginning
+ * of the chunk, or the end of the previous match of the same pattern.
+ */
+template <typename Buffer>
+MatchStatus parseEmail(Buffer const& buf, UIndex at, UIndex atEnd,
+                       UIndex floor, UIndex end, bool final, Candidate& c) {
+
+    UIndex limit = at - std::min(at - floor, MaxLocalPart);
+    UIndex begin = at;
+    while (begin != limit && isEmailLocal(buf[begin-1]))
+        --begin;
+
+    // Rather than counting a tail of something too long to be an address.
+    if (begin == limit && begin != floor && isEmailLocal(buf[begin-1]))
+        return MatchStatus::Rejected;
+
+    while (begin != at && buf[begin] == '.')
+        ++begin;
+
+    c.begin = begin;
+    if (begin == at)
+        return MatchStatus::Rejected;
+
+    UIndex hostEnd;
+    MatchStatus status = parseHost(buf, atEnd, end, final, hostEnd);
+    if (status != MatchStatus::Found)
+        return status;
+
+    // The domain needs a dot with something on both sides of it.
+    UIndex dot = atEnd;
+    while (dot != hostEnd && buf[dot] != '.')
+        ++dot;
+
+    if (dot == atEnd || dot == hostEnd)
+        return MatchStatus::Rejected;
+
+    c.end = c.keyEnd = hostEnd;
+    c.keyBegin = begin;
+    return MatchStatus::Found;
+}
+
+/*
+ * Called for every dot, but it's only an address if the dot is the first
+ * one of four decimal octets, neither of them greater than 255. A number
+ * glued to more digits or dots on either side is something else, like a
+ * version number.
+ */
+template <typename Buffer>
+MatchStatus parseIpv4(Buffer const& buf, UIndex at, UIndex,
+                      UIndex floor, UIndex end, bool final, Candidate& c) {
+
+    UIndex begin = at;
+    while (begin != floor && at - begin < 3 && isDigit(buf[begin-1]))
+        --begin;
+
+    c.begin = begin;
+    if (begin == at)
+        return MatchStatus::Rejected;
+
+    if (begin != floor && (isDigit(buf[begin-1]) || buf[begin-1] == '.'))
+        return MatchStatus::Rejected;
+
+    UIndex idx = begin;
+    for (int octet = 0; ; ++octet) {
+        UIndex digits = idx;
+        unsigned value = 0;
+        while (idx != end && idx - digits < 4 && isDigit(buf[idx]))
+            value = value * 10 + (buf[idx++] - '0');
+
+        if (idx == end && !final)
+            return MatchStatus::NeedMore;
+
+        if (idx == digits || idx - digits > 3 || value > 255)
+            return MatchStatus::Rejected;
+
+        if (octet == 3)
+            break;
+
+        if (idx == end || buf[idx] != '.')
+            return MatchStatus::Rejected;
+        ++idx;
+    }
+
+    if (idx != end && buf[idx] == '.') {
+        if (idx + 1 == end && !final)
+            return MatchStatus::NeedMore;
+        if (idx + 1 != end && isDigit(buf[idx+1]))
+            return MatchStatus::Rejected;
+    }
+
+    c.end = c.keyEnd = idx;
+    c.keyBegin = begin;
+    return MatchStatus::Found;
+}
+
+// The key of "ftp://" and "ws://" matches is the host name alone, just
+// like URL domains.
+template <typename Buffer>
+MatchStatus parseSchemeHost(Buffer const& buf, UIndex at, UIndex atEnd,
+                            UIndex, UIndex end, bool final, Candidate& c) {
+    c.begin = at;
+
+    UIndex hostEnd;
+    MatchStatus status = parseHost(buf, atEnd, end, final, hostEnd);
+    if (status != MatchStatus::Found)
+        return status;
+
+    c.end = c.keyEnd = hostEnd;
+    c.keyBegin = atEnd;
+    return MatchStatus::Found;
+}
+
+template <typename Buffer>
+MatchStatus parseRequestId(Buffer const& buf, UIndex at, UIndex atEnd,
+                           UIndex floor, UIndex end, bool final, Candidate& c) {
+    c.begin = at;
+
+    // The prefix must start a word, "xREQ-1" isn't a request ID.
+    if (at != floor && isIdChar(buf[at-1]))
+        return MatchStatus::Rejected;
+
+    UIndex idx = atEnd;
+    while (idx != end && isIdChar(buf[idx]))
+        ++idx;
+
+    if (idx == end && !final)
+        return MatchStatus::NeedMore;
+
+    if (idx == atEnd)
+        return MatchStatus::Rejected;
+
+    c.end = c.keyEnd = idx;
+    c.keyBegin = at;
+    return MatchStatus::Found;
+}
+
+template <typename Buffer>
+MatchStatus validate(PatternKind kind, Buffer const& buf,
+                     UIndex at, UIndex atEnd, UIndex floor,
+                     UIndex end, bool final, Candidate& c) {
+    switch (kind) {
+    case PatternKind::Email:
+        return parseEmail(buf, at, atEnd, floor, end, final, c);
+    case PatternKind::Ipv4:
+        return parseIpv4(buf, at, atEnd, floor, end, final, c);
+    case PatternKind::Ftp:
+    case PatternKind::Ws:
+        return parseSchemeHost(buf, at, atEnd, floor, end, final, c);
+    case PatternKind::RequestId:
+        return parseRequestId(buf, at, atEnd, floor, end, final, c);
+    case PatternKind::Url:
+        break;
+    }
+
+    return MatchStatus::Rejected;
+}
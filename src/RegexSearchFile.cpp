@@ -1,84 +1,209 @@
 #include "RegexSearchFile.hpp"
 
-#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
 #include "Helpers.hpp"
+#include "InputStream.hpp"
 #include "MemoryMappedFile.hpp"
+#include "Stats.hpp"
+#include "ThreadPool.hpp"
 
-/*
- * Boost.CircularBuffer is too peaky about its iterators in debug mode and
- * triggers an *assert* even on innocent-looking code like this:
- *
- *     boost::circular_buffer<char> cb;
- *     cb.begin() == circular_buffer<char>::const_iterator();
- *
- * This was presented as a debug helper, hah.
- */
-#define BOOST_CB_DISABLE_DEBUG
-#include <boost/circular_buffer.hpp>
+// Large enough to make the coroutine switches negligible, and small enough
+// for the offsets to stay in the processor cache.
+constexpr std::size_t MaxBatchSize = 4096;
 
 void regexSearchFileMmap(RegexSearchCo::push_type& yield,
                          std::string const& inputFn,
-                         std::regex  const& rex) {
+                         DfaRegex    const& rex) {
 
     MemoryMappedFile file(inputFn);
-    file.open();
+    Stats::add(Stats::BytesRead, file.end() - file.begin());
+
+    MatchBatch batch(rex.mark_count() + 1);
+    batch.reset(file.begin());
 
+    // The mapping stays in place, so a batch is only handed over when
+    // it's full.
     for (auto const& m: regexSearchAll(file.begin(), file.end(), rex)) {
-        RegexMatch match ([&m](int gidx) {return m[gidx].str(); });
-        yield(match);
+        batch.add(m);
+        if (batch.size() == MaxBatchSize) {
+            yield(batch);
+            batch.reset(file.begin());
+        }
     }
+
+    if (!batch.empty())
+        yield(batch);
 }
 
-void regexSearchFileBuf(RegexSearchCo::push_type& yield,
-                        std::string const& inputFn,
-                        std::regex  const& rex,
-                        size_t maxMatchLen,
-                        size_t bufferSize) {
+/*
+ * Maps the file by windows rather than all at once (see 'MappedWindow'),
+ * and searches every window just like 'regexSearchFileBuf' searches its
+ * blocks: the next window begins where the matches can't be known to be
+ * complete anymore. So the window must be larger than a page plus the
+ * longest match.
+ */
+void regexSearchFileWindow(RegexSearchCo::push_type& yield,
+                           std::string const& inputFn,
+                           DfaRegex    const& rex,
+                           size_t maxMatchLen,
+                           size_t windowSize) {
 
-    std::ifstream input;
-    input.open(inputFn);
-    input.unsetf(std::ios_base::skipws);
+    MappingOptions options;
+    options.sequential = true;
+    options.windowSize = windowSize;
 
-    // Unfortunately, one cannot simply call input.exceptions() and live
-    // happily (I know, I tried): exceptions and istream iterators are
-    // notoriously hard to combine.
-    if (!input.is_open())
-        throw std::ios_base::failure(inputFn);
+    MappedWindow window(inputFn, options);
+    MatchBatch batch(rex.mark_count() + 1);
 
-    auto fileIter = std::istream_iterator<char>(input);
-    auto fileEnd  = std::istream_iterator<char>();
+    // The window begins at a page boundary, and the search at the carry.
+    std::uint64_t resume = 0;
+    std::uint64_t mappedEnd = 0;
 
-    boost::circular_buffer<char> buf(bufferSize);
+    while (1) {
+        bool final = window.isLast();
+
+        char const* begin = window.begin() + (resume - window.offset());
+        char const* end   = window.end();
+
+        // Only what no window has had before counts as read.
+        std::uint64_t windowEnd = window.offset() + (end - window.begin());
+        Stats::add(Stats::BytesRead, windowEnd - mappedEnd);
+        mappedEnd = windowEnd;
+        char const* limit = final ? end
+                          : end - std::min<size_t>(end - begin, maxMatchLen);
+
+        char const* carry = limit;
+        batch.reset(begin);
+        for (auto const& m: regexSearchAll(begin, end, rex)) {
+            if (m[0].first >= limit && !final)
+                break;
+
+            batch.add(m);
+            carry = std::max(carry, m[0].second);
+
+            if (batch.size() == MaxBatchSize) {
+                yield(batch);
+                batch.reset(begin);
+            }
+        }
 
-    // A shorthand for convenience.
-    auto populate = [&fileIter, &fileEnd, &buf](size_t n) {
-        for (size_t i=0; i<n; ++i)
-            buf.push_back(*fileIter++);
+        // The window is about to be unmapped.
+        if (!batch.empty())
+            yield(batch);
+
+        if (final)
+            break;
+
+        std::uint64_t oldOffset = window.offset();
+        resume += carry - begin;
+        window.moveTo(resume);
+        if (window.offset() == oldOffset)
+            throw std::invalid_argument("the window is too small");
+    }
+}
+
+/*
+ * Reads the file by large blocks, so that the regex runs over plain
+ * pointers. There are two windows, each with room for 'maxMatchLen' bytes
+ * in front of its block: the next block is read right into the other one
+ * by a worker thread while the current one is searched, and only what's
+ * carried over is copied in front of it. A gzip or zstd compressed file is
+ * decompressed on that thread, too.
+ *
+ * Matches are assumed to be no longer than 'maxMatchLen'. Then a match
+ * which starts at least 'maxMatchLen' bytes before the window's end is
+ * known to be complete, and so is the fact that there's no match at any
+ * such position. Everything after the last of them is carried over to the
+ * next window, which is never more than 'maxMatchLen' bytes.
+ */
+void regexSearchFileBuf(RegexSearchCo::push_type& yield,
+                        std::string const& inputFn,
+                        DfaRegex    const& rex,
+                        size_t maxMatchLen,
+                        size_t bufferSize) {
+
+    InputStream input(inputFn);
+
+    std::vector<char> windows[2] = {
+        std::vector<char>(maxMatchLen + bufferSize),
+        std::vector<char>(maxMatchLen + bufferSize) };
+    unsigned current = 0;
+    size_t carrySize = 0;
+
+    // Unlike 'read()' system call, 'istream::read' doesn't return until
+    // the whole block is read, or the file is over. Pipes are fine, too.
+    auto readBlock = [&input, &windows, maxMatchLen,
+                      bufferSize](unsigned into) -> size_t {
+        input.read(windows[into].data() + maxMatchLen, bufferSize);
+        Stats::add(Stats::BytesRead, input.gcount());
+        return input.gcount();
     };
 
-    populate(buf.capacity());
+    MatchBatch batch(rex.mark_count() + 1);
+
+    // A single worker does every read, rather than a new thread per block.
+    ThreadPool reader(1);
+    auto pending = reader.submit([&readBlock]{ return readBlock(0); });
     while (1) {
-        auto lastMatchEnd = buf.end();
-        bool hadMatches = false;
-        for (auto const& m: regexSearchAll(buf.begin(), buf.end(), rex)) {
-            RegexMatch match ([&m](int gidx) {return m[gidx].str(); });
-            lastMatchEnd = m[0].second;
-            hadMatches = true;
-
-            // Let the caller examine the match.
-            yield(match);
+        size_t numRead;
+        {
+            Stats::Timer timer(Stats::ReadWaitNanos);
+            numRead = pending.get();
+        }
+        bool final = numRead < bufferSize;
+
+        // The other window has been searched, and its carry is copied
+        // out, so the next block goes right there.
+        unsigned other = current ^ 1;
+        if (!final)
+            pending = reader.submit([&readBlock, other]{
+                return readBlock(other);
+            });
+
+        char const* block = windows[current].data() + maxMatchLen;
+        char const* begin = block - carrySize;
+        char const* end   = block + numRead;
+        size_t windowSize = end - begin;
+        char const* limit = final ? end
+                          : begin + (windowSize - std::min(windowSize,
+                                                           maxMatchLen));
+
+        char const* carry = limit;
+        batch.reset(begin);
+        for (auto const& m: regexSearchAll(begin, end, rex)) {
+
+            // This match may be cut by the window's end, and shall be
+            // found again in the next window.
+            if (m[0].first >= limit && !final)
+                break;
+
+            batch.add(m);
+            carry = std::max(carry, m[0].second);
+
+            if (batch.size() == MaxBatchSize) {
+                yield(batch);
+                batch.reset(begin);
+            }
         }
 
-        if (fileIter == fileEnd)
-            break;
+        // Let the caller examine the matches while the window still
+        // holds them.
+        if (!batch.empty())
+            yield(batch);
 
-        size_t margin = hadMatches
-                ? size_t(buf.end() - lastMatchEnd)
-                : maxMatchLen;
+        if (final)
+            break;
 
-        populate(buf.capacity() - margin);
+        // Right in front of the block being read, which it doesn't touch.
+        carrySize = end - carry;
+        std::memcpy(windows[other].data() + maxMatchLen - carrySize, carry,
+                    carrySize);
+        current = other;
     }
 
-    if (!input.eof())
+    if (input.bad())
         throw std::ios_base::failure("cannot read the whole file");
 }
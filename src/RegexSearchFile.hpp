@@ -1,31 +1,71 @@
 #pragma once
-#include <regex>
-#include <functional>
+#include <string>
+#include <vector>
 #include <boost/noncopyable.hpp>
 #include <boost/coroutine/coroutine.hpp>
+#include "DfaRegex.hpp"
+#include "StringRef.hpp"
 
-class RegexMatch: public boost::noncopyable {
+/*
+ * Matches found in a piece of the input, handed over to the consumer all
+ * at once, instead of a coroutine switch per match. A match is nothing but
+ * the offsets of its groups' bounds from the base of the data, no strings
+ * are copied. So the data is only valid until the next batch is asked for.
+ */
+class MatchBatch: public boost::noncopyable {
 public:
 
-    RegexMatch(std::function<std::string(int)> retriever)
-        : mRetriever(retriever) {}
+    // Number of groups of every match, including the whole match.
+    explicit MatchBatch(std::size_t numGroups)
+        : mNumGroups(numGroups) {}
 
-    std::string str(int groupIdx) const {
-        return mRetriever(groupIdx);
+    std::size_t size()  const { return mOffsets.size() / (2 * mNumGroups); }
+    bool        empty() const { return mOffsets.empty(); }
+
+    /*
+     * Group 'gidx' of the match number 'idx'. A group which didn't take
+     * part in the match is an empty string.
+     */
+    StringRef group(std::size_t idx, int gidx) const {
+        std::size_t const* bounds = &mOffsets[2 * (idx * mNumGroups + gidx)];
+        return StringRef(mBase + bounds[0], bounds[1] - bounds[0]);
+    }
+
+    // The rest is for the searching side. It starts every batch with
+    // 'reset' and fills it with 'add'.
+    void reset(char const* base) {
+        mBase = base;
+        mOffsets.clear();
+    }
+
+    template <typename Match>
+    void add(Match const& match) {
+        for (std::size_t g = 0; g < mNumGroups; ++g) {
+            mOffsets.push_back(match[g].first  - mBase);
+            mOffsets.push_back(match[g].second - mBase);
+        }
     }
 
 private:
-    std::function<std::string(int)> mRetriever;
+    std::size_t mNumGroups;
+    char const* mBase = nullptr;
+    std::vector<std::size_t> mOffsets;
 };
 
-using RegexSearchCo = boost::coroutines::coroutine<RegexMatch const&>;
+using RegexSearchCo = boost::coroutines::coroutine<MatchBatch const&>;
 
 void regexSearchFileBuf(RegexSearchCo::push_type& yield,
                         std::string const& inputFn,
-                        std::regex  const& rex,
+                        DfaRegex    const& rex,
                         size_t maxMatchLen,
                         size_t bufferSize);
 
 void regexSearchFileMmap(RegexSearchCo::push_type& yield,
                          std::string const& inputFn,
-                         std::regex  const& rex);
+                         DfaRegex    const& rex);
+
+void regexSearchFileWindow(RegexSearchCo::push_type& yield,
+                           std::string const& inputFn,
+                           DfaRegex    const& rex,
+                           size_t maxMatchLen,
+                           size_t windowSize);
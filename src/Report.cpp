@@ -0,0 +1,102 @@
+#include "Report.hpp"
+#include <cmath>
+#include <ios>
+#include <vector>
+
+namespace {
+
+// Prints the most frequent items of 'map' as a text table.
+void printTop(std::ofstream& out, FrequencyTable const& map, UIndex maxNum,
+              ThreadPool& pool) {
+    for (auto const& ptr: map.top(maxNum, &pool))
+        out << ptr->count() << ' ' << ptr->key() << std::endl;
+}
+
+// Prints the most frequent items of an approximate summary. Whenever a
+// count isn't known exactly, the guaranteed lower bound follows it.
+void printTop(std::ofstream& out, HeavyHitters const& summary, UIndex maxNum){
+    for (auto const& item: summary.top(maxNum)) {
+        out << item.count << ' ' << item.key;
+        if (item.lower != item.count)
+            out << " (>= " << item.lower << ")";
+        out << std::endl;
+    }
+}
+
+} // namespace
+
+void printTop(std::ofstream& out, KeyCounter const& counter, UIndex maxNum,
+              ThreadPool& pool) {
+    if (counter.approx())
+        printTop(out, *counter.approx(), maxNum);
+    else
+        printTop(out, counter.exact(), maxNum, pool);
+}
+
+void printSize(std::ofstream& out, KeyCounter const& counter) {
+    HeavyHitters const* approx = counter.approx();
+    if (counter.distinct())
+        out << '~' << std::llround(counter.distinct()->estimate());
+    else if (!approx)
+        out << counter.exact().size();
+    else if (!approx->evicted())
+        out << approx->size();
+    else
+        out << "over " << approx->capacity();
+}
+
+void printReport(std::string const& outputFn, ScanResult const& result,
+                 unsigned maxNum, ThreadPool& pool) {
+    KeyCounter const& urlDomains = result.urlDomains;
+    KeyCounter const& urlPaths   = result.urlPaths;
+    std::uint64_t numMatches     = result.numMatches;
+
+    std::ofstream output(outputFn);
+    if (!output.is_open())
+        throw std::ios_base::failure(outputFn);
+
+    output << "total urls " << numMatches << ", " << "domains ";
+    printSize(output, urlDomains);
+    output << ", paths ";
+    printSize(output, urlPaths);
+    output << std::endl << std::endl;
+
+    output << "top domains" << std::endl;
+    printTop(output, urlDomains, maxNum, pool);
+    output << std::endl;
+
+    output << "top paths" << std::endl;
+    printTop(output, urlPaths, maxNum, pool);
+
+    for (std::size_t k = 0; k < result.extraKeys.size(); ++k) {
+        std::string const& title = (*result.patterns)[k+1].title;
+
+        output << std::endl;
+        output << "total " << title << ' ' << result.extraMatches[k]
+               << ", distinct ";
+        printSize(output, result.extraKeys[k]);
+        output << std::endl << std::endl;
+
+        output << "top " << title << std::endl;
+        printTop(output, result.extraKeys[k], maxNum, pool);
+    }
+}
+
+
+void writePartial(std::string const& filename, ScanResult const& result,
+                  ScanProgress const* progress) {
+    std::vector<PartialTable> tables {
+        { PartialKind::Domains, "", result.numMatches,
+          &result.urlDomains.exact(), result.urlDomains.distinct() },
+        { PartialKind::Paths, "", result.numMatches,
+          &result.urlPaths.exact(), result.urlPaths.distinct() } };
+
+    for (std::size_t k = 0; k < result.extraKeys.size(); ++k) {
+        tables.push_back(PartialTable {
+            PartialKind::Pattern, (*result.patterns)[k+1].title,
+            result.extraMatches[k], &result.extraKeys[k].exact(),
+            result.extraKeys[k].distinct() });
+    }
+
+    writePartialResult(filename, tables, progress);
+}
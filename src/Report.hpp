@@ -0,0 +1,32 @@
+#pragma once
+#include <fstream>
+#include <string>
+#include "PartialResult.hpp"
+#include "RingArray.hpp"
+#include "ScanResult.hpp"
+#include "ThreadPool.hpp"
+
+// Prints the most frequent keys of 'counter' as a text table, whichever
+// way they were counted.
+void printTop(std::ofstream& out, KeyCounter const& counter, UIndex maxNum,
+              ThreadPool& pool);
+
+// Prints the number of distinct keys, estimated if there's an estimator.
+// Once an approximate summary has evicted something, it only knows there
+// were more than it could keep.
+void printSize(std::ofstream& out, KeyCounter const& counter);
+
+/*
+ * Writes the report of 'result', with the top 'maxNum' keys of everything
+ * counted, to 'outputFn'.
+ */
+void printReport(std::string const& outputFn, ScanResult const& result,
+                 unsigned maxNum, ThreadPool& pool);
+
+/*
+ * Writes what a scan has counted as a partial result, to be merged with
+ * the others by "speedrun merge" later. Only the exact tables can be
+ * merged exactly, so there's no such thing for the approximate summaries.
+ */
+void writePartial(std::string const& filename, ScanResult const& result,
+                  ScanProgress const* progress = nullptr);
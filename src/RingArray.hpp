@@ -0,0 +1,77 @@
+#pragma once
+#include <cstddef>
+
+/*
+ * Integral type to store ring buffer index. This type is intentionally
+ * made unsigned, since we're going to do shifts and bitwise operations
+ * which are well-defined by the C++ standard only for unsigned types.
+ * This makes some things less convenient, but there're no other option.
+ */
+using UIndex = std::size_t;
+
+/*
+ * Unfortunately, we cannot use 'boost::circular_buffer', so must roll out
+ * our own implementation. The main point of the implementation is the
+ * following: if we restrict buffer size to the power of two values, we can
+ * get very cheap implementation of index wrap-around (single bitwise and).
+ * If the size of buffer known at compile time, the compiler is able to
+ * statically calculate the mask and inline it.
+ */
+template <typename T, UIndex N>
+class RingArray {
+public:
+
+    UIndex   size()  const { return N; }
+    T const* begin() const { return buf; }
+    T      * begin()       { return buf; }
+    T const* end()   const { return buf + N; }
+    T      * end()         { return buf + N; }
+
+    /*
+     * Returns the canonical representation of 'idx'. Whatever 'idx' is,
+     * return value fits the range [0, size()-1].
+     */
+    UIndex wrap(UIndex idx) const { return idx % N; }
+
+    /*
+     * Index the underlying array with a wrapped around index value. Since
+     * every possible 'idx' value is correct, these functions must be used
+     * with care. More over, to tell the truth, dealing with ring buffer
+     * indices really hurts.
+     */
+    T const& operator [] (UIndex idx) const { return buf[idx % N]; }
+    T      & operator [] (UIndex idx)       { return buf[idx % N]; }
+
+private:
+
+    T buf[N];
+};
+
+/*
+ * A read-only window into a contiguous array, which pretends to be a ring
+ * buffer that never wraps around. It lets the search functions work right
+ * on a memory mapped file, with indices being just file offsets. When only
+ * a window of the file is mapped, 'first' is the offset it starts at, and
+ * only the indices inside the window are valid.
+ */
+template <typename T>
+class ArrayView {
+public:
+
+    ArrayView(T const* data, UIndex size, UIndex first = 0)
+        : data(data), length(size), first(first) {}
+
+    UIndex   size()  const { return length; }
+    T const* begin() const { return data; }
+    T const* end()   const { return data + length; }
+
+    UIndex wrap(UIndex idx) const { return idx - first; }
+
+    T const& operator [] (UIndex idx) const { return data[idx - first]; }
+
+private:
+
+    T const* data;
+    UIndex   length;
+    UIndex   first;
+};
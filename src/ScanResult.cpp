@@ -0,0 +1,77 @@
+#include "ScanResult.hpp"
+#include <stdexcept>
+
+void KeyCounter::merge(KeyCounter const& other) {
+    if (mDistinct)
+        mDistinct->merge(*other.mDistinct);
+
+    if (mApprox)
+        mApprox->merge(*other.mApprox);
+    else
+        mExact.merge(other.mExact);
+}
+
+void KeyCounter::load(PartialResultFile const& file,
+                      PartialResultFile::Table const& table) {
+    // No key is seen more times than all of them together, which is
+    // what keeps the sums of the counts from overflowing as long as
+    // the totals don't.
+    for (std::uint64_t k = 0; k < table.numEntries; ++k) {
+        auto entry = file.entry(table, k);
+        if (entry.count > table.total)
+            throw std::invalid_argument(file.filename()
+                                        + ": a count exceeds the total");
+        mExact.add(entry.key, entry.count);
+    }
+
+    if (!mDistinct)
+        return;
+
+    if (table.precision != mDistinct->precision())
+        throw std::invalid_argument(file.filename()
+                                    + ": estimator precisions differ");
+
+    if (table.sparse) {
+        mDistinct->mergeSparse(
+            static_cast<std::uint32_t const*>(table.sketch),
+            table.sketchSize);
+    } else {
+        mDistinct->mergeDense(
+            static_cast<std::uint8_t const*>(table.sketch));
+    }
+}
+
+std::size_t KeyCounter::memoryUsage() const {
+    return mExact.memoryUsage()
+         + (mApprox ? mApprox->memoryUsage() : 0)
+         + (mDistinct ? mDistinct->memoryUsage() : 0);
+}
+
+ScanResult::ScanResult(ScanConfig const& config)
+    : urlDomains(config)
+    , urlPaths(config)
+    , patterns(config.patterns) {
+
+    for (std::size_t k = 1; patterns && k < patterns->size(); ++k) {
+        extraKeys.emplace_back(config);
+        extraMatches.push_back(0);
+    }
+}
+
+std::size_t ScanResult::memoryUsage() const {
+    std::size_t total = urlDomains.memoryUsage() + urlPaths.memoryUsage();
+    for (auto const& counter: extraKeys)
+        total += counter.memoryUsage();
+    return total;
+}
+
+void ScanResult::merge(ScanResult const& other) {
+    urlDomains.merge(other.urlDomains);
+    urlPaths.merge(other.urlPaths);
+    numMatches += other.numMatches;
+
+    for (std::size_t k = 0; k < extraKeys.size(); ++k) {
+        extraKeys[k].merge(other.extraKeys[k]);
+        extraMatches[k] += other.extraMatches[k];
+    }
+}
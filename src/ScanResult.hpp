@@ -0,0 +1,122 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "FrequencyTable.hpp"
+#include "HeavyHitters.hpp"
+#include "HyperLogLog.hpp"
+#include "PartialResult.hpp"
+#include "Patterns.hpp"
+
+/*
+ * What and how a scanning pass should count. Every worker thread builds
+ * its own result from the same configuration.
+ */
+struct ScanConfig {
+    // Zero means exact counting, anything else is the number of keys
+    // the approximate heavy hitters summary may keep track of.
+    std::size_t approxCapacity = 0;
+
+    // Zero means that distinct keys are counted by the top-N tables, and
+    // anything else is the precision of HyperLogLog estimators to use.
+    unsigned distinctPrecision = 0;
+
+    // Without top-N tables, the memory usage is fixed no matter how large
+    // the input is. They can only be dropped if there are estimators.
+    bool keepTop = true;
+
+    // Extra patterns to look for besides URLs, none if it's null.
+    PatternSet const* patterns = nullptr;
+};
+
+/*
+ * Counts URL domains or paths, or keys of the extra patterns. The exact
+ * table keeps every distinct key, which doesn't fit into memory on some
+ * inputs. So optionally, there is a bounded memory heavy hitters summary
+ * instead, which still finds the most frequent keys, but knows their
+ * counts only approximately. Also optionally, a HyperLogLog estimates the
+ * number of distinct keys, and then the top-N tables may be dropped
+ * altogether.
+ */
+class KeyCounter {
+public:
+
+    explicit KeyCounter(ScanConfig const& config)
+        : mKeepTop(config.keepTop) {
+
+        if (config.approxCapacity != 0)
+            mApprox.reset(new HeavyHitters(config.approxCapacity));
+        if (config.distinctPrecision != 0)
+            mDistinct.reset(new HyperLogLog(config.distinctPrecision));
+    }
+
+    void add(StringRef const& key) {
+        std::uint64_t hash = hashBytes(key);
+        if (mDistinct)
+            mDistinct->add(hash);
+
+        if (!mKeepTop)
+            return;
+
+        if (mApprox)
+            mApprox->add(key, hash, 1);
+        else
+            mExact.add(key, hash, 1);
+    }
+
+    void merge(KeyCounter const& other);
+
+    // Adds the counts of a table of a partial result, like the checkpoint
+    // a scan is resumed from. Throws 'std::invalid_argument' on a table
+    // which doesn't fit.
+    void load(PartialResultFile const& file,
+              PartialResultFile::Table const& table);
+
+    FrequencyTable const& exact()    const { return mExact; }
+    HeavyHitters   const* approx()   const { return mApprox.get(); }
+    HyperLogLog    const* distinct() const { return mDistinct.get(); }
+
+    std::size_t memoryUsage() const;
+
+private:
+
+    bool mKeepTop;
+    FrequencyTable mExact;
+    std::unique_ptr<HeavyHitters> mApprox;
+    std::unique_ptr<HyperLogLog>  mDistinct;
+};
+
+/*
+ * Everything a single scanning pass collects. Every worker thread has
+ * its own instance, so no locking is needed, and all of them are merged
+ * together after the workers have finished.
+ */
+struct ScanResult {
+    KeyCounter urlDomains;
+    KeyCounter urlPaths;
+    std::uint64_t numMatches = 0;
+
+    // Counters of the extra patterns, 'extraKeys[k]' is for pattern k+1.
+    PatternSet const* patterns;
+    std::vector<KeyCounter>    extraKeys;
+    std::vector<std::uint64_t> extraMatches;
+
+    explicit ScanResult(ScanConfig const& config);
+
+    std::size_t memoryUsage() const;
+
+    void merge(ScanResult const& other);
+};
+
+/*
+ * What a scan of a stream or of a chunk has to remember between the calls
+ * of 'collectMatches': where the last match of every pattern has ended.
+ * Matches of the same pattern never overlap, and the validators never look
+ * behind the beginning of the chunk.
+ */
+struct ScanCursor {
+    std::vector<UIndex> lastEnds;
+
+    ScanCursor(ScanResult const& result, UIndex start)
+        : lastEnds(result.patterns ? result.patterns->size() : 1, start) {}
+};
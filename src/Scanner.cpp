@@ -0,0 +1,348 @@
+#include "Scanner.hpp"
+#include <fstream>
+#include <ios>
+#include "InputStream.hpp"
+
+extern "C" {
+    #include <sys/mman.h>
+}
+
+namespace {
+
+/*
+ * Cuts the [begin, end) range of the input into 'numChunks' chunks of
+ * roughly equal size and scans them simultaneously on 'pool' with
+ * 'scanChunk'. A chunk boundary is moved forward by 'findStart' to the
+ * nearest byte which can't be a part of a match, so every match lies
+ * entirely inside one of the chunks, and the merged result is the same as
+ * if the input was scanned sequentially. It's added to 'result', which the
+ * first chunk is scanned right into.
+ */
+template <typename FindStart, typename ScanChunk>
+void scanParallel(ThreadPool& pool, ScanConfig const& config,
+                  std::uint64_t begin, std::uint64_t end, unsigned numChunks,
+                  FindStart findStart, ScanChunk scanChunk,
+                  ScanResult& result) {
+
+    std::vector<std::uint64_t> bounds {begin};
+    for (unsigned k = 1; k < numChunks; ++k) {
+        auto offset = std::max(begin + (end - begin) * k / numChunks,
+                               bounds.back());
+        bounds.push_back(findStart(offset));
+    }
+    bounds.push_back(end);
+
+    std::vector<ScanResult> results;
+    results.push_back(std::move(result));
+    for (unsigned k = 1; k < numChunks; ++k)
+        results.emplace_back(config);
+
+    std::vector<Task<void>> tasks;
+    for (unsigned k = 0; k < numChunks; ++k) {
+        if (bounds[k] == bounds[k+1])
+            continue;
+
+        tasks.push_back(pool.submit([&, k]{
+            scanChunk(bounds[k], bounds[k+1], results[k]);
+        }));
+    }
+
+    // Wait for everyone before merging, get() rethrows workers' errors.
+    for (auto& task: tasks)
+        task.get();
+
+    result = mergeResults(pool, results);
+}
+
+/*
+ * The same as 'scanFileMapped', but every thread maps a window of its own
+ * chunk at a time, so the address space used doesn't depend on the size of
+ * the file. When a window is over, the next one begins a bit behind the
+ * re-run point, so that whatever was cut by the window's end, and whatever
+ * the validators want to look behind, is mapped again.
+ */
+void scanFileWindowed(ThreadPool& pool, ScanConfig const& config,
+                      std::string const& inputFn, unsigned numChunks,
+                      MappingOptions const& mapping, ScanResult& result) {
+
+    // Every thread has its own file descriptor, so chunk boundaries are
+    // looked for through a stream, just like in the buffered mode.
+    std::ifstream input(inputFn, std::ios_base::binary);
+    if (!input.is_open())
+        throw std::ios_base::failure(inputFn);
+
+    input.seekg(0, std::ios_base::end);
+    std::uint64_t fileSize = input.tellg();
+
+    auto findStart = [&](std::uint64_t offset) {
+        return findChunkStart(input, syncFuncOf(config), offset, fileSize);
+    };
+
+    auto scanChunk = [&](std::uint64_t begin, std::uint64_t end,
+                         ScanResult& result) {
+        MappedWindow window(inputFn, mapping);
+        ScanCursor cursor(result, begin);
+        Stats::add(Stats::BytesRead, end - begin);
+
+        UIndex pos = begin;
+        window.moveTo(pos);
+        while (1) {
+            ArrayView<char> view(window.begin(),
+                                 window.endOffset() - window.offset(),
+                                 window.offset());
+
+            UIndex windowEnd = std::min<UIndex>(end, window.endOffset());
+            bool final = windowEnd == end;
+            UIndex rerun = collectMatches(view, pos, windowEnd, final,
+                                          cursor, result);
+            if (final)
+                break;
+
+            UIndex keep = rerun - std::min(rerun - begin, LookBehind);
+            UIndex oldOffset = window.offset();
+            window.moveTo(keep);
+
+            // An URL which occupies the whole window leaves no room to map
+            // its tail. It's hardly a real URL, so just step over it.
+            pos = window.offset() == oldOffset ? std::max(rerun, pos) + 1
+                                               : rerun;
+        }
+    };
+
+    scanParallel(pool, config, 0, fileSize, numChunks, findStart, scanChunk,
+                 result);
+}
+
+} // namespace
+
+SyncFunc syncFuncOf(ScanConfig const& config) {
+    return config.patterns ? isSpace : isUrlSync;
+}
+
+std::uint64_t findChunkStart(std::istream& input, SyncFunc isSync,
+                             std::uint64_t offset, std::uint64_t limit) {
+    char block[4096];
+
+    input.clear();
+    input.seekg(offset);
+    while (offset < limit) {
+        input.read(block, std::min<std::uint64_t>(sizeof block,
+                                                  limit - offset));
+        std::streamsize read = input.gcount();
+        if (read == 0)
+            break;
+
+        auto it = std::find_if(block, block + read, isSync);
+        if (it != block + read)
+            return offset + (it - block);
+
+        offset += read;
+    }
+
+    return limit;
+}
+
+std::uint64_t findChunkEnd(std::istream& input, SyncFunc isSync,
+                           std::uint64_t offset, std::uint64_t limit) {
+    char block[4096];
+
+    input.clear();
+    while (limit > offset) {
+        std::uint64_t size = std::min<std::uint64_t>(sizeof block,
+                                                     limit - offset);
+        input.seekg(limit - size);
+        input.read(block, size);
+        if ((std::uint64_t)input.gcount() != size)
+            break;
+
+        auto it = std::find_if(std::reverse_iterator<char*>(block + size),
+                               std::reverse_iterator<char*>(block), isSync);
+        if (it.base() != block)
+            return limit - size + (it.base() - 1 - block);
+
+        limit -= size;
+    }
+
+    return offset;
+}
+
+ScanResult mergeResults(ThreadPool& pool, std::vector<ScanResult>& results) {
+    for (std::size_t step = 1; step < results.size(); step *= 2) {
+        std::vector<Task<void>> tasks;
+        for (std::size_t k = 0; k + step < results.size(); k += 2*step) {
+            tasks.push_back(pool.submit([&results, k, step]{
+                results[k].merge(results[k + step]);
+            }));
+        }
+
+        for (auto& task: tasks)
+            task.get();
+    }
+
+    return std::move(results[0]);
+}
+
+void scanFileBuffered(ThreadPool& pool, ScanConfig const& config,
+                      std::string const& inputFn,
+                      std::uint64_t begin, std::uint64_t end,
+                      unsigned numChunks, ReaderOptions const& reading,
+                      ScanResult& result) {
+
+    std::ifstream input(inputFn, std::ios_base::binary);
+    if (!input.is_open())
+        throw std::ios_base::failure(inputFn);
+
+    auto findStart = [&](std::uint64_t offset) {
+        return findChunkStart(input, syncFuncOf(config), offset, end);
+    };
+
+    auto scanChunk = [&](std::uint64_t begin, std::uint64_t end,
+                         ScanResult& result) {
+        // Every worker keeps its ring from file to file, faulting fresh
+        // pages in for every one of many small files costs more than
+        // reading them. So does its reader: starting threads or setting
+        // up a ring for every file would cost more still.
+        static thread_local auto buf = makeBlockRing<BlockRingSize>();
+        static thread_local std::unique_ptr<BlockReader> reader;
+        static thread_local ReaderOptions::Backend backend;
+
+        if (reader && backend == reading.backend) {
+            reader->reopen(inputFn, reading);
+        } else {
+            reader = BlockReader::open(inputFn, buf->begin(), buf->size(),
+                                       BlockRingSize / BlockSize, reading);
+            backend = reading.backend;
+        }
+
+        // A failed scan may leave reads in flight, and their completions
+        // would confuse the next one, so its reader goes away with it.
+        auto dropReader = [](std::unique_ptr<BlockReader>* failed) {
+            failed->reset();
+        };
+        std::unique_ptr<std::unique_ptr<BlockReader>, decltype(dropReader)>
+            readerGuard(&reader, dropReader);
+
+        scanBlocks<BlockRingSize, BlockSize>(*buf, *reader, begin, end,
+                                             result);
+        readerGuard.release();
+    };
+
+    scanParallel(pool, config, begin, end, numChunks, findStart, scanChunk,
+                 result);
+}
+
+void scanFileMapped(ThreadPool& pool, ScanConfig const& config,
+                    std::string const& inputFn, unsigned numChunks,
+                    MappingOptions const& mapping, ScanResult& result) {
+    if (mapping.windowSize != 0)
+        return scanFileWindowed(pool, config, inputFn, numChunks, mapping,
+                                result);
+
+    MemoryMappedFile file(inputFn, mapping);
+    ArrayView<char> view(file.begin(), file.end() - file.begin());
+
+    // The kernel is asked to start fetching the beginning of every chunk
+    // right away.
+    const std::size_t warmUp = 16*1024*1024;
+
+    // Every chunk is scanned by slices, so that its 'MappedScan' knows how
+    // far the scan has got.
+    const UIndex slice = 1024*1024;
+
+    auto findStart = [&](std::uint64_t offset) -> std::uint64_t {
+        auto it = std::find_if(view.begin() + offset, view.end(),
+                               syncFuncOf(config));
+        return it - view.begin();
+    };
+
+    auto scanChunk = [&](std::uint64_t begin, std::uint64_t end,
+                         ScanResult& result) {
+        adviseMapping(file.begin() + begin,
+                      std::min<UIndex>(end - begin, warmUp), file.options(),
+                      MADV_WILLNEED);
+        MappedScan scan(file, begin, end);
+        ScanCursor cursor(result, begin);
+        Stats::add(Stats::BytesRead, end - begin);
+
+        // The slice's end grows no matter where the re-run point is, so an
+        // URL longer than a slice is simply looked at once again.
+        UIndex pos = begin;
+        for (UIndex sliceEnd = begin; sliceEnd != end; ) {
+            sliceEnd = std::min<UIndex>(end, sliceEnd + slice);
+            pos = collectMatches(view, pos, sliceEnd, sliceEnd == end,
+                                 cursor, result);
+            scan.advance(pos);
+        }
+    };
+
+    scanParallel(pool, config, 0, view.size(), numChunks, findStart,
+                 scanChunk, result);
+}
+
+void scanInput(ThreadPool& pool, ScanConfig const& config,
+               InputFile const& input, unsigned numChunks,
+               InputOptions const& options, ScanResult& result) {
+
+    // Pipes and other non-seekable files can be neither mapped nor cut
+    // into chunks, nor read at offsets, so they are read as streams. Empty
+    // files can't be mapped either, but who cares. Compressed files can
+    // only be decompressed from the beginning, so they are streams too.
+    bool isRegular = input.regular && input.size > 0
+                  && detectCompression(input.path) == Compression::None;
+
+    if (options.method == "mmap" && isRegular)
+        return scanFileMapped(pool, config, input.path, numChunks,
+                              options.mapping, result);
+
+    if (isRegular)
+        return scanFileBuffered(pool, config, input.path, 0, input.size,
+                                numChunks, options.reading, result);
+
+    // Sorry, I'm not in mood to print errors nicely. Decompression runs
+    // on a worker, along with the reads.
+    InputStream stream(input.path);
+    scanStream<BufferSize>(pool, stream, UINT64_MAX, result);
+}
+
+void scanInputs(ThreadPool& pool, ScanConfig const& config,
+                std::vector<InputFile> const& inputs,
+                InputOptions const& options, ScanResult& result) {
+
+    if (inputs.empty())
+        return;
+
+    std::uint64_t totalSize = 0;
+    for (auto const& input: inputs)
+        totalSize += input.size;
+
+    std::vector<ScanResult> results;
+    results.push_back(std::move(result));
+    for (std::size_t k = 1; k < inputs.size(); ++k)
+        results.emplace_back(config);
+
+    std::vector<Task<void>> tasks;
+    for (std::size_t k = 0; k < inputs.size(); ++k) {
+        std::uint64_t share = totalSize == 0 ? 0 : (inputs[k].size *
+            pool.size() + totalSize/2) / totalSize;
+        unsigned numChunks = std::max<std::uint64_t>(1,
+                                 std::min<std::uint64_t>(share, pool.size()));
+
+        tasks.push_back(pool.submit([&, k, numChunks]{
+            scanInput(pool, config, inputs[k], numChunks, options,
+                      results[k]);
+        }));
+    }
+
+    for (auto& task: tasks)
+        task.get();
+
+    result = mergeResults(pool, results);
+}
+
+ScanResult scanInputs(ThreadPool& pool, ScanConfig const& config,
+                      std::vector<InputFile> const& inputs,
+                      InputOptions const& options) {
+    ScanResult result(config);
+    scanInputs(pool, config, inputs, options, result);
+    return result;
+}
@@ -0,0 +1,472 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <istream>
+#include <memory>
+#include <new>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "BlockReader.hpp"
+#include "InputFiles.hpp"
+#include "MemoryMappedFile.hpp"
+#include "RingArray.hpp"
+#include "ScanResult.hpp"
+#include "Stats.hpp"
+#include "ThreadPool.hpp"
+
+/*
+ * Only a key which wraps around the end of a ring buffer has to be copied
+ * somewhere to be looked up, the rest are looked up in place.
+ */
+template <typename Buffer>
+StringRef viewString(Buffer const& buf, UIndex begin, UIndex end,
+                     std::string& scratch) {
+    if (buf.wrap(begin) + (end - begin) <= buf.size())
+        return StringRef(&buf[begin], end - begin);
+
+    scratch.clear();
+    for (UIndex i = begin; i != end; ++i)
+        scratch.push_back(buf[i]);
+
+    return StringRef(scratch);
+}
+
+template <typename Buffer>
+void countUrl(Buffer const& buf, UIndex domainBegin, UIndex pathBegin,
+              UIndex urlEnd, std::string& scratch, ScanResult& result) {
+
+    ++result.numMatches;
+
+    // The scratch is shared, so the domain has to be counted before
+    // the path is looked at.
+    result.urlDomains.add(viewString(buf, domainBegin, pathBegin, scratch));
+
+    if (pathBegin == urlEnd)
+        result.urlPaths.add(StringRef("/", 1));
+    else
+        result.urlPaths.add(viewString(buf, pathBegin, urlEnd, scratch));
+}
+
+/*
+ * Runs the literals automaton of the extra patterns over [begin, end),
+ * validates every literal found, and counts the matches. Literals are
+ * reported by where they end, so matches of different patterns may
+ * overlap: the result is the same as if every pattern was looked for
+ * in a pass of its own.
+ */
+template <typename Buffer>
+UIndex collectPatterns(Buffer const& buf, UIndex begin, UIndex end,
+                       bool final, ScanCursor& cursor, ScanResult& result) {
+
+    PatternSet const& patterns = *result.patterns;
+    AhoCorasick const& literals = patterns.literals();
+    std::string scratch;
+
+    std::string const& firstBytes = literals.firstBytes();
+    bool skip = firstBytes.size() <= MaxFindAnyBytes;
+
+    AhoCorasick::State state = literals.start();
+    for (UIndex idx = begin; idx != end; ++idx) {
+        if (state == literals.start() && skip) {
+            idx = skipToAny(buf, idx, end, firstBytes);
+            if (idx == end)
+                break;
+        }
+
+        state = literals.next(state, buf[idx]);
+        if (!AhoCorasick::hasOutput(state))
+            continue;
+
+        for (unsigned literal: literals.outputs(state)) {
+            UIndex atEnd = idx + 1;
+            UIndex at = atEnd - literals.length(literal);
+            unsigned pattern = patterns.patternOf(literal);
+
+            // Inside a match of the same pattern, like "http" in the path
+            // of an URL.
+            UIndex& lastEnd = cursor.lastEnds[pattern];
+            if (at < lastEnd)
+                continue;
+
+            MatchStatus status;
+            if (pattern == 0) {
+                UIndex domainBegin, pathBegin, urlEnd;
+                status = parseUrl(buf, at, end, final,
+                                  domainBegin, pathBegin, urlEnd);
+                Stats::add(Stats::HttpCandidates, 1);
+
+                if (status == MatchStatus::Found) {
+                    Stats::add(Stats::UrlsFound, 1);
+                    countUrl(buf, domainBegin, pathBegin, urlEnd, scratch,
+                             result);
+                    lastEnd = urlEnd;
+                }
+            } else {
+                Candidate c;
+                status = validate(patterns[pattern].kind, buf, at, atEnd,
+                                  lastEnd, end, final, c);
+
+                if (status == MatchStatus::Found) {
+                    ++result.extraMatches[pattern-1];
+                    result.extraKeys[pattern-1].add(
+                        viewString(buf, c.keyBegin, c.keyEnd, scratch));
+                    lastEnd = c.end;
+                }
+            }
+
+            // Everything before it is done, and the literal will be found
+            // again by the next run. What the validator may want to look
+            // behind it is kept by the caller (see 'LookBehind').
+            if (status == MatchStatus::NeedMore)
+                return at;
+        }
+    }
+
+    if (final)
+        return end;
+
+    // A literal may have started in the last few bytes.
+    return end - std::min(end - begin, literals.maxLength() - 1);
+}
+
+/*
+ * Counts every URL found in the [begin, end) range of 'buf' into 'result'
+ * and returns the search re-run point. With extra patterns, their matches
+ * are counted too, see 'collectPatterns'.
+ */
+template <typename Buffer>
+UIndex collectMatches(Buffer const& buf, UIndex begin, UIndex end,
+                      bool final, ScanCursor& cursor, ScanResult& result) {
+
+    Stats::Timer timer(Stats::ScanNanos);
+
+    if (result.patterns)
+        return collectPatterns(buf, begin, end, final, cursor, result);
+
+    std::string scratch;
+
+    UIndex urlBegin, domainBegin, pathBegin, urlEnd = begin;
+    while (findUrl(buf, urlEnd, end, final,
+                   urlBegin, domainBegin, pathBegin, urlEnd)) {
+        countUrl(buf, domainBegin, pathBegin, urlEnd, scratch, result);
+    }
+
+    return urlEnd;
+}
+
+/*
+ * Where the part of a ring which can't be read into yet begins, given the
+ * search re-run point. The validators of the extra patterns may look a bit
+ * behind the re-run point, so that much isn't overwritten by the next read.
+ */
+inline UIndex keepFrom(UIndex searchBegin, ScanResult const& result) {
+    return searchBegin - (result.patterns ? std::min(searchBegin, LookBehind)
+                                          : 0);
+}
+
+// I thought that the buffer size of 8 kB would be large enough for
+// batch reading, yet small enough to fit the processor cache. However,
+// tests had shown that larger buffers operate faster. The "scanStream"
+// lines of the benchmark (see 'bench/') show it for a given machine.
+constexpr UIndex BufferSize = 512*1024;
+
+/*
+ * Reads no more than 'length' bytes from 'input' and collects every URL
+ * found there into 'result'. The end of the range is treated as the end
+ * of the stream, so an URL running up to it is counted in. The reads are
+ * done on 'pool', while the scan goes on in the calling thread.
+ */
+template <UIndex N>
+void scanStream(ThreadPool& pool, std::istream& input, std::uint64_t length,
+                ScanResult& result) {
+
+    // Half a megabyte is too much for a thread's stack.
+    std::unique_ptr<RingArray<char, N>> bufPtr(new RingArray<char, N>);
+    RingArray<char, N>& buf = *bufPtr;
+
+    using OpState = std::tuple<bool, UIndex>;
+    using Future = Task<OpState>;
+
+    // Starts a background file read operation to populate the [begin, end)
+    // range of the circular buffer with fresh data.
+    auto populate = [&](UIndex begin, UIndex end) -> Future {
+        return pool.submit([&input, &buf, &length,
+                            begin, end]() -> OpState {
+            std::uint64_t want = std::min<std::uint64_t>(end - begin, length);
+            if (!input.good() || want == 0)
+                return std::make_tuple(false, begin);
+
+            // The range may wrap around the end of the buffer, in which
+            // case it has to be read in two pieces.
+            std::streamsize head = std::min<std::uint64_t>(
+                                       want, buf.size() - buf.wrap(begin));
+
+            input.read(&buf[begin], head);
+            std::streamsize read = input.gcount();
+
+            if (read == head && want > (std::uint64_t)head) {
+                input.read(&buf[0], want - head);
+                read += input.gcount();
+            }
+
+            if (read == 0)
+                return std::make_tuple(false, begin);
+
+            Stats::add(Stats::BytesRead, read);
+            length -= read;
+            return std::make_tuple(true, begin + read);
+        });
+    };
+
+    // What is waited for is the read and the decompression, if any.
+    auto wait = [](Future& future) {
+        Stats::Timer timer(Stats::ReadWaitNanos);
+        return future.get();
+    };
+
+    auto future = populate(0, buf.size()/2);
+
+    bool readAny;
+    UIndex readEnd;
+    std::tie(readAny, readEnd) = wait(future);
+
+    UIndex searchBegin = 0;
+    UIndex searchEnd   = readEnd;
+    ScanCursor cursor(result, 0);
+
+    while (readAny) {
+        auto future = populate(searchEnd,
+                               keepFrom(searchBegin, result) + buf.size());
+        UIndex matchEnd = collectMatches(buf, searchBegin, searchEnd, false,
+                                         cursor, result);
+
+        std::tie(readAny, readEnd) = wait(future);
+
+        searchBegin = matchEnd;
+        searchEnd = readEnd;
+
+        // A full buffer leaves no room to read into. A single read may
+        // fill it up, so it's scanned first. If that doesn't free anything,
+        // there's an URL which occupies the whole buffer. It's hardly a real
+        // URL, so just step over it.
+        if (searchEnd - keepFrom(searchBegin, result) == buf.size()) {
+            searchBegin = collectMatches(buf, searchBegin, searchEnd, false,
+                                         cursor, result);
+            if (searchEnd - keepFrom(searchBegin, result) == buf.size())
+                ++searchBegin;
+        }
+    }
+
+    collectMatches(buf, searchBegin, searchEnd, true, cursor, result);
+}
+
+// Several reads in flight keep a fast device busy while the blocks read
+// before are scanned. The ring is just as large as before, but it's read
+// by quarter megabyte blocks, rather than by halves.
+constexpr UIndex BlockSize = 256*1024;
+constexpr UIndex BlockRingSize = 8*BlockSize;
+
+/*
+ * A ring buffer for 'BlockReader', aligned the way O_DIRECT wants it,
+ * which plain 'new' doesn't care about.
+ */
+template <UIndex N>
+std::shared_ptr<RingArray<char, N>> makeBlockRing() {
+    void* ptr = nullptr;
+    if (::posix_memalign(&ptr, BlockReader::DirectAlignment,
+                         sizeof(RingArray<char, N>)) != 0)
+        throw std::bad_alloc();
+
+    return std::shared_ptr<RingArray<char, N>>(
+               new (ptr) RingArray<char, N>, [](RingArray<char, N>* p) {
+                   std::free(p);
+               });
+}
+
+/*
+ * Collects every match in the [begin, end) range of the file behind
+ * 'reader' into 'result', the same as 'scanStream' does for a stream.
+ * The ring is cut into slots of 'S' bytes, and every slot is read on
+ * its own, as soon as the scan lets it go. So there are up to N/S reads
+ * in flight, and they may complete in any order: the scan only goes as
+ * far as the blocks before it have all arrived.
+ *
+ * Indices are offsets from 'base', which is 'begin' aligned down the way
+ * the reader wants.
+ */
+template <UIndex N, UIndex S>
+void scanBlocks(RingArray<char, N>& buf, BlockReader& reader,
+                std::uint64_t begin, std::uint64_t end, ScanResult& result) {
+
+    static_assert(N % S == 0, "the ring must consist of whole blocks");
+    static_assert(S % BlockReader::DirectAlignment == 0,
+                  "a block must be good for O_DIRECT");
+    constexpr UIndex NumSlots = N / S;
+
+    UIndex align = reader.alignment();
+    std::uint64_t base = begin / align * align;
+    UIndex limit = end - base;
+
+    // How much has been asked for, and how much has come, by slot.
+    std::size_t wanted[NumSlots];
+    std::size_t got[NumSlots];
+    bool arrived[NumSlots] = {};
+
+    UIndex nextBlock = 0;     // Block to submit next.
+    UIndex readBlock = 0;     // First block which hasn't arrived yet.
+    unsigned inFlight = 0;
+
+    UIndex searchBegin = begin - base;
+    UIndex searchEnd   = searchBegin;
+    UIndex readEnd     = 0;
+    bool final = false;
+    ScanCursor cursor(result, searchBegin);
+
+    while (!final) {
+        while (nextBlock*S < limit
+                && (nextBlock + 1)*S <= keepFrom(searchBegin, result) + N) {
+            unsigned slot = nextBlock % NumSlots;
+            UIndex length = std::min(S, limit - nextBlock*S);
+
+            wanted[slot] = (length + align - 1) / align * align;
+            arrived[slot] = false;
+            reader.submit(slot, &buf[nextBlock*S], wanted[slot],
+                          base + nextBlock*S);
+            ++nextBlock;
+            ++inFlight;
+        }
+
+        if (readEnd > searchEnd) {
+            searchBegin = collectMatches(buf, searchBegin, readEnd, false,
+                                         cursor, result);
+            searchEnd = readEnd;
+            continue;
+        }
+
+        // Everything read is scanned, and there's no room to read into.
+        // There's an URL which occupies the whole buffer. It's hardly a real
+        // URL, so just step over it.
+        if (inFlight == 0) {
+            searchBegin = collectMatches(buf, searchBegin + 1, readEnd,
+                                         false, cursor, result);
+            continue;
+        }
+
+        BlockReader::Completion done;
+        {
+            Stats::Timer timer(Stats::ReadWaitNanos);
+            done = reader.wait();
+        }
+        Stats::add(Stats::BytesRead, done.length);
+        got[done.tag] = done.length;
+        arrived[done.tag] = true;
+        --inFlight;
+
+        while (readBlock != nextBlock && arrived[readBlock % NumSlots]) {
+            unsigned slot = readBlock % NumSlots;
+            readEnd = readBlock*S + got[slot];
+            ++readBlock;
+
+            if (got[slot] < wanted[slot] || readEnd >= limit) {
+                final = true;
+                break;
+            }
+        }
+    }
+
+    // The reads past the end of the file still target the buffer.
+    while (inFlight--)
+        reader.wait();
+
+    collectMatches(buf, searchBegin, std::min<UIndex>(readEnd, limit), true,
+                   cursor, result);
+}
+
+
+/*
+ * Tells whether no match can span over a byte, so that a chunk may start
+ * at it. Extra patterns allow more characters than URLs do.
+ */
+using SyncFunc = bool (*)(char ch);
+
+inline bool isUrlSync(char ch) { return !allowedInUrl(ch); }
+
+SyncFunc syncFuncOf(ScanConfig const& config);
+
+/*
+ * Returns the offset of the first byte in [offset, limit) for which
+ * 'isSync' is true, or 'limit' if there is none.
+ */
+std::uint64_t findChunkStart(std::istream& input, SyncFunc isSync,
+                             std::uint64_t offset, std::uint64_t limit);
+
+/*
+ * Returns the offset of the last byte in [offset, limit) for which 'isSync'
+ * is true, or 'offset' if there is none. Everything before it can be
+ * scanned, whatever comes after it.
+ */
+std::uint64_t findChunkEnd(std::istream& input, SyncFunc isSync,
+                           std::uint64_t offset, std::uint64_t limit);
+
+/*
+ * Merges all of 'results' on 'pool' pairwise, so that it takes log(N)
+ * rounds rather than N merges in a row, and returns the sum.
+ */
+ScanResult mergeResults(ThreadPool& pool, std::vector<ScanResult>& results);
+
+/*
+ * Scans the [begin, end) range of a regular file by 'numChunks' chunks on
+ * 'pool', each of them read through the ring buffer and the 'BlockReader'
+ * of the worker it's scanned on, and adds what's found to 'result'.
+ */
+void scanFileBuffered(ThreadPool& pool, ScanConfig const& config,
+                      std::string const& inputFn,
+                      std::uint64_t begin, std::uint64_t end,
+                      unsigned numChunks, ReaderOptions const& reading,
+                      ScanResult& result);
+
+/*
+ * Scans a memory mapped file by 'numChunks' chunks on 'pool' into 'result'.
+ * Nothing is copied: the search functions walk the mapping directly, and
+ * it's the kernel's business to bring the pages in. The 'mapping' options
+ * decide how much it's helped with that. With a window size, every thread
+ * maps a window of its own chunk at a time, so the address space used
+ * doesn't depend on the size of the file.
+ */
+void scanFileMapped(ThreadPool& pool, ScanConfig const& config,
+                    std::string const& inputFn, unsigned numChunks,
+                    MappingOptions const& mapping, ScanResult& result);
+
+/*
+ * How the input files are read, as the command line says.
+ */
+struct InputOptions {
+    std::string    method = "buf";
+    MappingOptions mapping;
+    ReaderOptions  reading;
+};
+
+/*
+ * Scans a single input file, cut into up to 'numChunks' chunks, with the
+ * method of 'options', or the only one which is possible, into 'result'.
+ */
+void scanInput(ThreadPool& pool, ScanConfig const& config,
+               InputFile const& input, unsigned numChunks,
+               InputOptions const& options, ScanResult& result);
+
+/*
+ * Scans every file of 'inputs' into its own result, and merges them into
+ * 'result'. The first file is scanned right into it. The files are started
+ * largest first, and a file gets a share of the workers as large as its
+ * share of the data, so that a single huge file is still scanned by all
+ * of them.
+ */
+void scanInputs(ThreadPool& pool, ScanConfig const& config,
+                std::vector<InputFile> const& inputs,
+                InputOptions const& options, ScanResult& result);
+
+ScanResult scanInputs(ThreadPool& pool, ScanConfig const& config,
+                      std::vector<InputFile> const& inputs,
+                      InputOptions const& options);
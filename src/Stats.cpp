@@ -0,0 +1,102 @@
+#include "Stats.hpp"
+#include <array>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+
+extern "C" {
+    #include <sys/resource.h>
+}
+
+namespace {
+
+char const* const CounterNames[Stats::NumCounters] = {
+    "bytes_read",
+    "read_wait_ns",
+    "scan_ns",
+    "http_candidates",
+    "urls_found",
+    "table_probes",
+    "table_inserts",
+    "table_growths",
+};
+
+#if defined(WITH_STATS)
+
+using Counters = std::array<std::uint64_t, Stats::NumCounters>;
+
+// The counters of every thread which has ever counted anything. A deque
+// never moves what it has, so the threads keep pointers into it.
+std::mutex threadsMutex;
+std::deque<Counters> threadCounters;
+
+#endif
+
+} // namespace
+
+#if defined(WITH_STATS)
+
+std::uint64_t* Stats::registerThread() {
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    threadCounters.emplace_back();
+    threadCounters.back().fill(0);
+    return threadCounters.back().data();
+}
+
+std::uint64_t Stats::total(Counter counter) {
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    std::uint64_t sum = 0;
+    for (auto const& counters: threadCounters)
+        sum += counters[counter];
+    return sum;
+}
+
+#else
+
+std::uint64_t Stats::total(Counter) {
+    return 0;
+}
+
+#endif
+
+void Stats::writeJson(
+        std::ostream& out,
+        std::vector<std::pair<std::string, std::uint64_t>> const& facts) {
+
+    out << "{\n";
+    for (auto const& fact: facts)
+        out << "  \"" << fact.first << "\": " << fact.second << ",\n";
+
+    // Kilobytes, on Linux.
+    rusage usage;
+    if (::getrusage(RUSAGE_SELF, &usage) == 0)
+        out << "  \"peak_rss_bytes\": " << usage.ru_maxrss * 1024 << ",\n";
+
+    out << "  \"instrumented\": " << (Enabled ? "true" : "false");
+    if (Enabled) {
+        out << ",\n  \"counters\": {\n";
+        for (int k = 0; k < NumCounters; ++k) {
+            out << "    \"" << CounterNames[k] << "\": "
+                << total(static_cast<Counter>(k))
+                << (k + 1 < NumCounters ? ",\n" : "\n");
+        }
+        out << "  }";
+    }
+    out << "\n}\n";
+}
+
+void Stats::writeJson(
+        std::string const& filename,
+        std::vector<std::pair<std::string, std::uint64_t>> const& facts) {
+
+    if (filename == "-") {
+        writeJson(std::cerr, facts);
+        return;
+    }
+
+    std::ofstream out(filename);
+    if (!out.is_open())
+        throw std::ios_base::failure(filename);
+    writeJson(out, facts);
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+ * Counters of where the time of a run goes, for "--stats": how much was
+ * read and how long the readers were waited for, how many candidates the
+ * prefilter gave and how many of them were real, how hard the hash tables
+ * have worked.
+ *
+ * They are only compiled in with WITH_STATS defined (see CMakeLists.txt).
+ * Otherwise every call here is an empty inline function, and the hot paths
+ * are exactly what they are without the counters. With them, every thread
+ * counts into counters of its own, with no atomics, and the counters of
+ * all the threads are summed up when the report is written. So it should
+ * be written once the threads are done counting.
+ */
+class Stats {
+public:
+
+    enum Counter {
+        BytesRead,          // Read, or scanned right in a mapping.
+        ReadWaitNanos,      // Waiting for reads to complete.
+        ScanNanos,          // Searching and counting.
+        HttpCandidates,     // "http" found by the prefilter.
+        UrlsFound,          // Candidates which were URLs indeed.
+        TableProbes,        // Groups of hash table slots looked at.
+        TableInserts,       // Keys a hash table hasn't seen before.
+        TableGrowths,
+        NumCounters
+    };
+
+#if defined(WITH_STATS)
+    static const bool Enabled = true;
+
+    static void add(Counter counter, std::uint64_t value) {
+        local()[counter] += value;
+    }
+#else
+    static const bool Enabled = false;
+
+    static void add(Counter, std::uint64_t) {}
+#endif
+
+    // The sum over all the threads, zero if it's not compiled in.
+    static std::uint64_t total(Counter counter);
+
+    /*
+     * Writes the counters, along with 'facts' of the run, which are known
+     * without any counters, as a JSON object. The names are plain
+     * identifiers, and need no escaping.
+     */
+    static void writeJson(
+        std::ostream& out,
+        std::vector<std::pair<std::string, std::uint64_t>> const& facts);
+
+    // The same, to a file, or to stderr if it's "-".
+    static void writeJson(
+        std::string const& filename,
+        std::vector<std::pair<std::string, std::uint64_t>> const& facts);
+
+    /*
+     * Adds the time from its construction to its destruction to a counter.
+     * Reading the clock takes a few dozens of nanoseconds, so it's meant
+     * for things which take much longer, like a refill of a buffer.
+     */
+    class Timer {
+    public:
+#if defined(WITH_STATS)
+        explicit Timer(Counter counter)
+            : mCounter(counter)
+            , mStart(std::chrono::steady_clock::now()) {}
+
+        ~Timer() {
+            add(mCounter, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                              std::chrono::steady_clock::now() - mStart)
+                              .count());
+        }
+
+    private:
+        Counter mCounter;
+        std::chrono::steady_clock::time_point mStart;
+#else
+        explicit Timer(Counter) {}
+#endif
+    };
+
+private:
+
+#if defined(WITH_STATS)
+    // The counters of the calling thread.
+    static std::uint64_t* local() {
+        thread_local std::uint64_t* counters = registerThread();
+        return counters;
+    }
+
+    static std::uint64_t* registerThread();
+#endif
+};
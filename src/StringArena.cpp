@@ -0,0 +1,24 @@
+#include "StringArena.hpp"
+
+char* StringArena::allocate(std::size_t size) {
+
+    // Large enough to make allocation calls rare, small enough to not
+    // waste much memory on a nearly empty table.
+    const std::size_t blockSize = 256*1024;
+
+    // Long strings get blocks of their own, so that the rest of the
+    // current block isn't thrown away because of a single monster.
+    if (size > blockSize / 16) {
+        mBlocks.emplace_back(new char[size]);
+        mCapacity += size;
+        return mBlocks.back().get();
+    }
+
+    // The rest of the current block is lost, but it's never much.
+    mBlocks.emplace_back(new char[blockSize]);
+    mCapacity += blockSize;
+
+    mCursor = mBlocks.back().get() + size;
+    mLeft = blockSize - size;
+    return mBlocks.back().get();
+}
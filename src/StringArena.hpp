@@ -0,0 +1,85 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "StringRef.hpp"
+
+/*
+ * A bump allocator for strings which are never freed one by one, but all
+ * at once when the arena dies. Copying a string costs a 'memcpy' and
+ * a pointer increment, and there's no per-string bookkeeping at all.
+ *
+ * The arena can be moved, but not copied. The strings stay where they
+ * are when the arena is moved, so references to them remain valid.
+ */
+class StringArena {
+public:
+
+    StringArena()
+        : mCursor(nullptr)
+        , mLeft(0)
+        , mCapacity(0)
+        {}
+
+    // The blocks go to the new arena, and so do the cursor and the rest of
+    // the current block. The old arena is left empty, rather than with
+    // a cursor into a block which isn't its own anymore.
+    StringArena(StringArena&& other)
+        : mBlocks(std::move(other.mBlocks))
+        , mCursor(other.mCursor)
+        , mLeft(other.mLeft)
+        , mCapacity(other.mCapacity) {
+        other.clear();
+    }
+
+    StringArena& operator = (StringArena&& other) {
+        if (this != &other) {
+            mBlocks   = std::move(other.mBlocks);
+            mCursor   = other.mCursor;
+            mLeft     = other.mLeft;
+            mCapacity = other.mCapacity;
+            other.clear();
+        }
+        return *this;
+    }
+
+    StringArena(StringArena const&) = delete;
+    StringArena& operator = (StringArena const&) = delete;
+
+    // Copies 'str' into the arena and returns a reference to the copy.
+    StringRef copy(StringRef const& str) {
+        char* dest;
+        if (str.size() <= mLeft) {
+            dest = mCursor;
+            mCursor += str.size();
+            mLeft   -= str.size();
+        } else {
+            dest = allocate(str.size());
+        }
+
+        std::memcpy(dest, str.data(), str.size());
+        return StringRef(dest, str.size());
+    }
+
+    // How many bytes the arena has taken from the system allocator.
+    std::size_t capacity() const { return mCapacity; }
+
+private:
+
+    // The slow path of 'copy', which gets a new block from the system.
+    char* allocate(std::size_t size);
+
+    // Forgets the blocks, which must have been moved away.
+    void clear() {
+        mBlocks.clear();
+        mCursor   = nullptr;
+        mLeft     = 0;
+        mCapacity = 0;
+    }
+
+    std::vector<std::unique_ptr<char[]>> mBlocks;
+    char*       mCursor;
+    std::size_t mLeft;
+    std::size_t mCapacity;
+};
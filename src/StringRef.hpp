@@ -0,0 +1,103 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+
+/*
+ * A non-owning reference to a piece of characters somewhere in memory,
+ * like the C++17 'std::string_view' which I'm not allowed to use yet.
+ * Whoever creates an instance is responsible for keeping the characters
+ * alive while the reference is in use.
+ */
+class StringRef {
+public:
+
+    StringRef(): mData(""), mSize(0) {}
+
+    StringRef(char const* data, std::size_t size)
+        : mData(data)
+        , mSize(size)
+        {}
+
+    StringRef(std::string const& str)
+        : mData(str.data())
+        , mSize(str.size())
+        {}
+
+    char const* data()  const { return mData; }
+    std::size_t size()  const { return mSize; }
+    bool        empty() const { return mSize == 0; }
+
+    char const* begin() const { return mData; }
+    char const* end()   const { return mData + mSize; }
+
+    std::string str() const { return std::string(mData, mSize); }
+
+private:
+
+    char const* mData;
+    std::size_t mSize;
+};
+
+inline bool operator == (StringRef const& a, StringRef const& b) {
+    return a.size() == b.size()
+        && std::memcmp(a.data(), b.data(), a.size()) == 0;
+}
+
+inline bool operator != (StringRef const& a, StringRef const& b) {
+    return !(a == b);
+}
+
+// The same order as 'std::string' has, so that sorting doesn't change.
+inline bool operator < (StringRef const& a, StringRef const& b) {
+    int cmp = std::memcmp(a.data(), b.data(), std::min(a.size(), b.size()));
+    return cmp < 0 || (cmp == 0 && a.size() < b.size());
+}
+
+inline std::ostream& operator << (std::ostream& out, StringRef const& s) {
+    return out.write(s.data(), s.size());
+}
+
+/*
+ * MurmurHash64A by Austin Appleby (public domain), which eats eight bytes
+ * per step. The tail is read with a single 'memcpy', which gives the same
+ * result as the original on little-endian machines.
+ */
+inline std::uint64_t hashBytes(char const* data, std::size_t size) {
+    const std::uint64_t m = 0xc6a4a7935bd1e995ULL;
+    const int r = 47;
+
+    std::uint64_t h = 0x9747b28c ^ (size * m);
+
+    char const* blocksEnd = data + (size & ~std::size_t(7));
+    for (; data != blocksEnd; data += 8) {
+        std::uint64_t k;
+        std::memcpy(&k, data, 8);
+
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+
+        h ^= k;
+        h *= m;
+    }
+
+    if (size & 7) {
+        std::uint64_t k = 0;
+        std::memcpy(&k, data, size & 7);
+
+        h ^= k;
+        h *= m;
+    }
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
+
+inline std::uint64_t hashBytes(StringRef const& s) {
+    return hashBytes(s.data(), s.size());
+}
@@ -0,0 +1,109 @@
+#include "ThreadPool.hpp"
+#include <algorithm>
+
+namespace {
+
+// Which pool the current thread works for, and which queue is its own.
+thread_local ThreadPool const* currentPool = nullptr;
+thread_local std::size_t currentQueue = 0;
+
+// Takes either the newest or the oldest job out of 'jobs', if any.
+bool takeJob(std::mutex& mutex, std::deque<std::function<void()>>& jobs,
+             bool newest, std::function<void()>& job) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (jobs.empty())
+        return false;
+
+    if (newest) {
+        job = std::move(jobs.back());
+        jobs.pop_back();
+    } else {
+        job = std::move(jobs.front());
+        jobs.pop_front();
+    }
+    return true;
+}
+
+} // namespace
+
+ThreadPool::ThreadPool(unsigned numThreads)
+    : mPending(0) {
+
+    numThreads = std::max(numThreads, 1u);
+    for (unsigned k = 0; k < numThreads; ++k)
+        mQueues.emplace_back(new Queue);
+
+    for (unsigned k = 0; k < numThreads; ++k)
+        mThreads.emplace_back(&ThreadPool::work, this, k);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStop = true;
+    }
+    mWake.notify_all();
+
+    for (auto& thread: mThreads)
+        thread.join();
+}
+
+void ThreadPool::push(Job job) {
+    Queue& queue = currentPool == this ? *mQueues[currentQueue] : mShared;
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(std::move(job));
+    }
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        ++mPending;
+    }
+    mWake.notify_one();
+}
+
+bool ThreadPool::pop(Job& job) {
+    bool isWorker = currentPool == this;
+    std::size_t self = isWorker ? currentQueue : 0;
+
+    // A worker takes its own latest task first, then the oldest ones of
+    // the outside world, and of the others.
+    bool found = (isWorker && takeJob(mQueues[self]->mutex,
+                                      mQueues[self]->jobs, true, job))
+              || takeJob(mShared.mutex, mShared.jobs, false, job);
+
+    for (std::size_t k = isWorker ? 1 : 0; !found && k < mQueues.size(); ++k) {
+        Queue& queue = *mQueues[(self + k) % mQueues.size()];
+        found = takeJob(queue.mutex, queue.jobs, false, job);
+    }
+
+    if (found)
+        --mPending;
+    return found;
+}
+
+bool ThreadPool::runPending() {
+    Job job;
+    if (!pop(job))
+        return false;
+
+    job();
+    return true;
+}
+
+void ThreadPool::work(std::size_t self) {
+    currentPool = this;
+    currentQueue = self;
+
+    while (1) {
+        Job job;
+        if (pop(job)) {
+            job();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mMutex);
+        mWake.wait(lock, [this]{ return mStop || mPending != 0; });
+        if (mStop && mPending == 0)
+            return;
+    }
+}
@@ -0,0 +1,142 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <boost/noncopyable.hpp>
+
+class ThreadPool;
+
+/*
+ * A handle of a task submitted to a 'ThreadPool', much like 'std::future'.
+ * The difference is that whoever waits for it runs other pending tasks of
+ * the pool meanwhile. So a task may submit tasks of its own and wait for
+ * them without tying up a worker, and the pool never deadlocks on that.
+ */
+template <typename T>
+class Task {
+public:
+
+    Task() = default;
+
+    Task(Task&&) = default;
+
+    Task& operator = (Task&& other) {
+        if (valid())
+            wait();
+
+        mPool = other.mPool;
+        mFuture = std::move(other.mFuture);
+        return *this;
+    }
+
+    // Like the future of 'std::async', waits for the task, which is likely
+    // to refer to the locals of whoever has submitted it.
+    ~Task() {
+        if (valid())
+            wait();
+    }
+
+    bool valid() const { return mFuture.valid(); }
+
+    void wait();
+
+    // Waits for the task, and returns what it has returned, or rethrows
+    // what it has thrown.
+    T get() {
+        wait();
+        return mFuture.get();
+    }
+
+private:
+    friend class ThreadPool;
+
+    Task(ThreadPool* pool, std::future<T>&& future)
+        : mPool(pool), mFuture(std::move(future)) {}
+
+    ThreadPool*    mPool = nullptr;
+    std::future<T> mFuture;
+};
+
+/*
+ * A fixed set of worker threads, started once, which run whatever is
+ * submitted. Starting a thread per task, like 'std::async' does, costs
+ * a lot more than the tasks here are worth.
+ *
+ * Every worker has a queue of its own. A task submitted by a worker goes
+ * to its own queue, and the worker takes the latest one first, while it's
+ * still in cache. An idle worker steals the oldest tasks of the others.
+ * Tasks submitted from the outside go to a shared queue, and are started
+ * in the order they were submitted.
+ */
+class ThreadPool: public boost::noncopyable {
+public:
+
+    explicit ThreadPool(unsigned numThreads);
+
+    // Runs every task already submitted, then stops the workers.
+    ~ThreadPool();
+
+    unsigned size() const { return mThreads.size(); }
+
+    template <typename F>
+    Task<typename std::result_of<F()>::type> submit(F fn) {
+        using Result = typename std::result_of<F()>::type;
+
+        // 'std::function' wants something copyable.
+        auto task = std::make_shared<std::packaged_task<Result()>>(
+                        std::move(fn));
+        Task<Result> handle(this, task->get_future());
+
+        push([task]{ (*task)(); });
+        return handle;
+    }
+
+    // Runs a single pending task in the calling thread. Returns 'false'
+    // if there was none.
+    bool runPending();
+
+private:
+
+    using Job = std::function<void()>;
+
+    struct Queue {
+        std::mutex      mutex;
+        std::deque<Job> jobs;
+    };
+
+    void push(Job job);
+    bool pop(Job& job);
+    void work(std::size_t self);
+
+    std::vector<std::unique_ptr<Queue>> mQueues;
+    Queue mShared;
+    std::vector<std::thread> mThreads;
+
+    // Only changed under the lock when it grows, so that a worker going
+    // to sleep can't miss a task.
+    std::atomic<std::size_t> mPending;
+    std::mutex mMutex;
+    std::condition_variable mWake;
+    bool mStop = false;
+};
+
+template <typename T>
+void Task<T>::wait() {
+    while (mFuture.wait_for(std::chrono::seconds(0))
+                != std::future_status::ready) {
+
+        // Nothing is pending, so the task is already running somewhere.
+        if (!mPool->runPending()) {
+            mFuture.wait();
+            return;
+        }
+    }
+}
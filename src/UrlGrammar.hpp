@@ -0,0 +1,385 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * The grammar of the URLs 'speedrun' looks for, and the tables its scanner
+ * is generated from. A grammar is a plain struct like the ones at the end
+ * of this file: a list of schemes, and the sets of characters domain names
+ * and paths consist of. An URL is one of the schemes, "://", one or more
+ * domain characters, and optionally '/' followed by any number of path
+ * characters.
+ *
+ * Everything 'UrlTables' derives from a grammar is computed by the
+ * compiler: the literals the prefilter looks for, its skip table, the
+ * schemes to check once a literal is found, and the tables of the vector
+ * spans. So another grammar is another struct, rather than another set of
+ * tables computed by hand, and it costs nothing at run time.
+ *
+ * It's C++11, so every constexpr function is a single return statement,
+ * and loops are recursions. Sorry for that.
+ */
+
+/*
+ * A set of ASCII characters. Non-ASCII bytes never belong to an URL, and
+ * are silently left out of any set.
+ */
+struct CharSet {
+    std::uint64_t low;      // 0x00..0x3F.
+    std::uint64_t high;     // 0x40..0x7F.
+
+    constexpr bool has(unsigned char ch) const {
+        return ch < 0x40 ? (low >> ch) & 1
+             : ch < 0x80 ? (high >> (ch - 0x40)) & 1
+             : false;
+    }
+
+    constexpr CharSet operator | (CharSet other) const {
+        return CharSet{low | other.low, high | other.high};
+    }
+};
+
+constexpr CharSet charOf(unsigned char ch) {
+    return ch < 0x40 ? CharSet{std::uint64_t(1) << ch, 0}
+         : ch < 0x80 ? CharSet{0, std::uint64_t(1) << (ch - 0x40)}
+         : CharSet{0, 0};
+}
+
+constexpr CharSet charRange(unsigned char first, unsigned char last) {
+    return first > last ? CharSet{0, 0}
+         : charOf(first) | charRange(first + 1, last);
+}
+
+// Every character of 'list' but the separators, if there are any.
+constexpr CharSet charsOf(char const* list, char separator = 0) {
+    return *list == 0 ? CharSet{0, 0}
+         : (*list == separator ? CharSet{0, 0} : charOf(*list))
+           | charsOf(list + 1, separator);
+}
+
+constexpr CharSet alnumChars() {
+    return charRange('0', '9') | charRange('A', 'Z') | charRange('a', 'z');
+}
+
+/*
+ * The schemes of a grammar are a single string, separated by '|', like
+ * "http|https". These functions pick it apart.
+ */
+constexpr unsigned schemeCount(char const* s) {
+    return *s == 0 ? 1 : (*s == '|') + schemeCount(s + 1);
+}
+
+constexpr unsigned schemeLength(char const* s) {
+    return *s == 0 || *s == '|' ? 0 : 1 + schemeLength(s + 1);
+}
+
+constexpr unsigned schemeOffset(char const* s, unsigned k) {
+    return k == 0 ? 0
+         : schemeLength(s) + 1 + schemeOffset(s + schemeLength(s) + 1, k-1);
+}
+
+constexpr bool equalPrefix(char const* a, char const* b, unsigned length) {
+    return length == 0 || (*a == *b && equalPrefix(a + 1, b + 1, length - 1));
+}
+
+constexpr unsigned minOf(unsigned a, unsigned b) { return a < b ? a : b; }
+
+/*
+ * What the tables are computed from. The prefilter looks for the schemes
+ * cut to the length of the shortest one, every distinct piece once: for
+ * "http|https" it's just "http", and for "http|https|ftp" it's "htt" and
+ * "ftp". Then the whole schemes are checked where a literal is found.
+ */
+template <typename Grammar>
+struct GrammarTraits {
+
+    static constexpr char const* scheme(unsigned k) {
+        return Grammar::schemes() + schemeOffset(Grammar::schemes(), k);
+    }
+
+    static constexpr unsigned numSchemes() {
+        return schemeCount(Grammar::schemes());
+    }
+
+    static constexpr unsigned literalLength(unsigned k = 0) {
+        return k + 1 == numSchemes() ? schemeLength(scheme(k))
+             : minOf(schemeLength(scheme(k)), literalLength(k + 1));
+    }
+
+    // Whether no scheme before 'k' is cut to the same literal.
+    static constexpr bool isNewLiteral(unsigned k, unsigned j = 0) {
+        return j == k || (!equalPrefix(scheme(j), scheme(k), literalLength())
+                          && isNewLiteral(k, j + 1));
+    }
+
+    static constexpr unsigned numLiterals(unsigned k = 0) {
+        return k == numSchemes() ? 0 : isNewLiteral(k) + numLiterals(k + 1);
+    }
+
+    // The scheme the 'i'-th literal is cut from.
+    static constexpr unsigned literalScheme(unsigned i, unsigned k = 0) {
+        return !isNewLiteral(k) ? literalScheme(i, k + 1)
+             : i == 0 ? k : literalScheme(i - 1, k + 1);
+    }
+
+    static constexpr char literalByte(unsigned i, unsigned j) {
+        return scheme(literalScheme(i))[j];
+    }
+
+    /*
+     * Horspool's skip: how far the prefilter's window may move on when its
+     * last byte is 'ch'. That's how far it is from the end of the window
+     * to the last 'ch' of any literal, not counting its last byte.
+     */
+    static constexpr unsigned skip(unsigned char ch, unsigned i = 0,
+                                   unsigned j = 0) {
+        return i == numLiterals() ? literalLength()
+             : j + 1 >= literalLength() ? skip(ch, i + 1, 0)
+             : minOf(literalByte(i, j) == char(ch) ? literalLength() - 1 - j
+                                                   : literalLength(),
+                     skip(ch, i, j + 1));
+    }
+
+    // Whether literal 'b' may begin 'shift' bytes after literal 'a' does.
+    static constexpr bool overlaps(unsigned a, unsigned b, unsigned shift) {
+        return equalPrefix(scheme(literalScheme(a)) + shift,
+                           scheme(literalScheme(b)), literalLength() - shift);
+    }
+
+    static constexpr bool anyOverlaps(unsigned shift, unsigned a = 0,
+                                      unsigned b = 0) {
+        return a == numLiterals() ? false
+             : b == numLiterals() ? anyOverlaps(shift, a + 1, 0)
+             : overlaps(a, b, shift) || anyOverlaps(shift, a, b + 1);
+    }
+
+    /*
+     * How far after a literal the next one may begin. For "http" it's right
+     * after its end, but "abab" may begin again two bytes later.
+     */
+    static constexpr unsigned restart(unsigned shift = 1) {
+        return shift == literalLength() || anyOverlaps(shift)
+             ? shift : restart(shift + 1);
+    }
+
+    // What an URL may consist of, scheme included.
+    static constexpr CharSet urlChars() {
+        return charsOf(Grammar::schemes(), '|') | charsOf(":/")
+             | Grammar::domain() | Grammar::path();
+    }
+};
+
+template <std::size_t... I>
+struct IndexList {};
+
+template <std::size_t N, std::size_t... I>
+struct MakeIndexList: MakeIndexList<N - 1, N - 1, I...> {};
+
+template <std::size_t... I>
+struct MakeIndexList<0, I...> { using type = IndexList<I...>; };
+
+/*
+ * An array of 'Generator::Size' bytes, the k-th of which is
+ * 'Generator::at(k)', all of them computed by the compiler.
+ */
+template <typename Generator,
+          typename Indices = typename MakeIndexList<Generator::Size>::type>
+struct GeneratedTable;
+
+// Aligned for the widest vector a table may be loaded into.
+template <typename Generator, std::size_t... I>
+struct GeneratedTable<Generator, IndexList<I...>> {
+    alignas(64) static constexpr std::uint8_t values[] = {Generator::at(I)...};
+};
+
+template <typename Generator, std::size_t... I>
+alignas(64) constexpr std::uint8_t
+GeneratedTable<Generator, IndexList<I...>>::values[];
+
+// Whether a byte belongs to 'Chars::chars()', by byte.
+template <typename Chars>
+struct MembershipOf {
+    static const std::size_t Size = 256;
+
+    static constexpr std::uint8_t at(std::size_t ch) {
+        return Chars::chars().has(ch);
+    }
+};
+
+/*
+ * The low nibble half of the 'pshufb' classification of the vector spans.
+ * Bit 'h' of the entry for a low nibble 'l' is set when byte 0xhl belongs
+ * to the set, and the high nibble half just has bit 'h' set for every 'h'
+ * up to 7. So a byte belongs when both halves agree on some bit.
+ */
+template <typename Chars>
+struct LowNibblesOf {
+    static const std::size_t Size = 16;
+
+    static constexpr std::uint8_t bits(std::size_t low, unsigned high = 0) {
+        return high == 8 ? 0
+             : (Chars::chars().has(high*16 + low) << high)
+               | bits(low, high + 1);
+    }
+
+    static constexpr std::uint8_t at(std::size_t low) { return bits(low); }
+};
+
+// The high nibble half, the same for every set.
+struct HighNibbles {
+    static const std::size_t Size = 16;
+
+    static constexpr std::uint8_t at(std::size_t high) {
+        return high < 8 ? 1 << high : 0;
+    }
+};
+
+/*
+ * 'Generator' over and over. 'vpshufb' looks up within 128-bit lanes, so
+ * a wider table is a copy of a 16 bytes one in every lane, and it's loaded
+ * as a whole rather than broadcast.
+ */
+template <typename Generator, std::size_t Times>
+struct RepeatedOf {
+    static const std::size_t Size = Generator::Size * Times;
+
+    static constexpr std::uint8_t at(std::size_t k) {
+        return Generator::at(k % Generator::Size);
+    }
+};
+
+template <typename Grammar>
+struct LiteralBytesOf {
+    using Traits = GrammarTraits<Grammar>;
+    static const std::size_t Size = Traits::numLiterals()
+                                  * Traits::literalLength();
+
+    static constexpr std::uint8_t at(std::size_t k) {
+        return Traits::literalByte(k / Traits::literalLength(),
+                                   k % Traits::literalLength());
+    }
+};
+
+template <typename Grammar>
+struct SkipOf {
+    static const std::size_t Size = 256;
+
+    static constexpr std::uint8_t at(std::size_t ch) {
+        return GrammarTraits<Grammar>::skip(ch);
+    }
+};
+
+template <typename Grammar>
+struct SchemeOffsetsOf {
+    static const std::size_t Size = GrammarTraits<Grammar>::numSchemes();
+
+    static constexpr std::uint8_t at(std::size_t k) {
+        return schemeOffset(Grammar::schemes(), k);
+    }
+};
+
+template <typename Grammar>
+struct SchemeLengthsOf {
+    static const std::size_t Size = GrammarTraits<Grammar>::numSchemes();
+
+    static constexpr std::uint8_t at(std::size_t k) {
+        return schemeLength(GrammarTraits<Grammar>::scheme(k));
+    }
+};
+
+template <typename Grammar>
+struct DomainChars {
+    static constexpr CharSet chars() { return Grammar::domain(); }
+};
+
+template <typename Grammar>
+struct PathChars {
+    static constexpr CharSet chars() { return Grammar::path(); }
+};
+
+template <typename Grammar>
+struct UrlChars {
+    static constexpr CharSet chars() {
+        return GrammarTraits<Grammar>::urlChars();
+    }
+};
+
+/*
+ * Everything the scanner of a grammar needs, in the form it needs it.
+ */
+template <typename Grammar>
+struct UrlTables {
+    using Traits = GrammarTraits<Grammar>;
+
+    static constexpr unsigned NumSchemes    = Traits::numSchemes();
+    static constexpr unsigned NumLiterals   = Traits::numLiterals();
+    static constexpr unsigned LiteralLength = Traits::literalLength();
+    static constexpr unsigned Restart       = Traits::restart();
+
+    static_assert(LiteralLength > 0, "a scheme can't be empty");
+    static_assert(Grammar::path().has('/'), "a path begins with '/'");
+
+    using Literals       = GeneratedTable<LiteralBytesOf<Grammar>>;
+    using Skip           = GeneratedTable<SkipOf<Grammar>>;
+    using SchemeOffsets  = GeneratedTable<SchemeOffsetsOf<Grammar>>;
+    using SchemeLengths  = GeneratedTable<SchemeLengthsOf<Grammar>>;
+    using UrlMembership  = GeneratedTable<MembershipOf<UrlChars<Grammar>>>;
+    using DomainMembership = GeneratedTable<MembershipOf<DomainChars<Grammar>>>;
+
+    static constexpr char literal(unsigned k, unsigned j) {
+        return Literals::values[k * LiteralLength + j];
+    }
+
+    static char const* scheme(unsigned k) {
+        return Grammar::schemes() + SchemeOffsets::values[k];
+    }
+
+    // The literals, for the automaton of the extra patterns.
+    static std::vector<std::string> literals() {
+        std::vector<std::string> result;
+        for (unsigned k = 0; k < NumLiterals; ++k) {
+            result.emplace_back(reinterpret_cast<char const*>(
+                                    Literals::values + k * LiteralLength),
+                                LiteralLength);
+        }
+        return result;
+    }
+};
+
+template <typename Grammar> constexpr unsigned UrlTables<Grammar>::NumSchemes;
+template <typename Grammar> constexpr unsigned UrlTables<Grammar>::NumLiterals;
+template <typename Grammar>
+constexpr unsigned UrlTables<Grammar>::LiteralLength;
+template <typename Grammar> constexpr unsigned UrlTables<Grammar>::Restart;
+
+/*
+ * What the original task has asked for.
+ */
+struct HttpGrammar {
+    static constexpr char const* schemes() { return "http|https"; }
+
+    static constexpr CharSet domain() {
+        return alnumChars() | charsOf("-.");
+    }
+
+    static constexpr CharSet path() {
+        return domain() | charsOf("/_+,");
+    }
+};
+
+/*
+ * Queries, fragments, escapes and home directories are kept in the paths,
+ * rather than cut off.
+ */
+struct HttpQueryGrammar: HttpGrammar {
+    static constexpr CharSet path() {
+        return HttpGrammar::path() | charsOf("?#%~=&");
+    }
+};
+
+// FTP servers host paths, too.
+struct HttpFtpGrammar: HttpGrammar {
+    static constexpr char const* schemes() { return "http|https|ftp"; }
+};
@@ -0,0 +1,98 @@
+#include "UrlSearch.hpp"
+#include <cstdlib>
+
+SimdLevel detectSimdLevel() {
+    char const* env = std::getenv("SPEEDRUN_SIMD");
+    std::string limit = env ? env : "avx512";
+
+    SimdLevel level = SimdLevel::Scalar;
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("sse2"))
+        level = SimdLevel::Sse2;
+    if (__builtin_cpu_supports("avx2"))
+        level = SimdLevel::Avx2;
+    if (__builtin_cpu_supports("avx512bw"))
+        level = SimdLevel::Avx512;
+#endif
+
+    SimdLevel maxLevel = limit == "scalar" ? SimdLevel::Scalar
+                       : limit == "sse2"   ? SimdLevel::Sse2
+                       : limit == "avx2"   ? SimdLevel::Avx2
+                       :                     SimdLevel::Avx512;
+
+    return std::min(level, maxLevel);
+}
+
+// Before 'findAny', which is chosen by it.
+SimdLevel const simdLevel = detectSimdLevel();
+
+namespace {
+
+char const* findAnyScalar(char const* first, char const* last,
+                          char const* bytes, unsigned numBytes) {
+    return std::find_first_of(first, last, bytes, bytes + numBytes);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+__attribute__((target("sse2")))
+char const* findAnySse2(char const* first, char const* last,
+                        char const* bytes, unsigned numBytes) {
+    __m128i needles[MaxFindAnyBytes];
+    for (unsigned k = 0; k < numBytes; ++k)
+        needles[k] = _mm_set1_epi8(bytes[k]);
+
+    for (; last - first >= 16; first += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(first));
+        __m128i eq = _mm_setzero_si128();
+        for (unsigned k = 0; k < numBytes; ++k)
+            eq = _mm_or_si128(eq, _mm_cmpeq_epi8(v, needles[k]));
+
+        unsigned mask = _mm_movemask_epi8(eq);
+        if (mask != 0)
+            return first + __builtin_ctz(mask);
+    }
+
+    return findAnyScalar(first, last, bytes, numBytes);
+}
+
+__attribute__((target("avx2")))
+char const* findAnyAvx2(char const* first, char const* last,
+                        char const* bytes, unsigned numBytes) {
+    __m256i needles[MaxFindAnyBytes];
+    for (unsigned k = 0; k < numBytes; ++k)
+        needles[k] = _mm256_set1_epi8(bytes[k]);
+
+    for (; last - first >= 32; first += 32) {
+        __m256i v = _mm256_loadu_si256(
+                               reinterpret_cast<__m256i const*>(first));
+        __m256i eq = _mm256_setzero_si256();
+        for (unsigned k = 0; k < numBytes; ++k)
+            eq = _mm256_or_si256(eq, _mm256_cmpeq_epi8(v, needles[k]));
+
+        unsigned mask = _mm256_movemask_epi8(eq);
+        if (mask != 0)
+            return first + __builtin_ctz(mask);
+    }
+
+    return findAnySse2(first, last, bytes, numBytes);
+}
+
+#endif
+
+FindAnyFunc selectFindAny(SimdLevel level) {
+#if defined(__x86_64__) || defined(__i386__)
+    if (level >= SimdLevel::Avx2)
+        return findAnyAvx2;
+    if (level >= SimdLevel::Sse2)
+        return findAnySse2;
+#endif
+
+    return findAnyScalar;
+}
+
+} // namespace
+
+FindAnyFunc const findAny = selectFindAny(simdLevel);
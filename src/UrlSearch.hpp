@@ -0,0 +1,621 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include "RingArray.hpp"
+#include "Stats.hpp"
+#include "UrlGrammar.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+/*
+ * The grammar the scanner is generated from, see 'UrlGrammar.hpp' for what
+ * there is. It's chosen at build time, so that a variant costs no more
+ * than the default one does.
+ */
+#if !defined(URL_GRAMMAR)
+#define URL_GRAMMAR HttpGrammar
+#endif
+
+using UrlGrammar = URL_GRAMMAR;
+
+/*
+ * A search function looks for the literals of a grammar, which is just
+ * "http" by default, in the contiguous range [first, last). It returns
+ * a pointer to the first occurrence which lies entirely inside the range,
+ * or 'last' if there is none.
+ */
+using LiteralSearchFunc = char const* (*)(char const* first, char const* last);
+
+// Whether any of the literals begins at 'at' of 'bytes', a plain pointer
+// or a buffer.
+template <typename Grammar, typename Bytes>
+inline bool isLiteralAt(Bytes const& bytes, UIndex at) {
+    using Tables = UrlTables<Grammar>;
+
+#pragma GCC unroll 8
+    for (unsigned k = 0; k < Tables::NumLiterals; ++k) {
+        unsigned j = 0;
+#pragma GCC unroll 16
+        for (; j < Tables::LiteralLength; ++j) {
+            if (bytes[at + j] != Tables::literal(k, j))
+                break;
+        }
+        if (j == Tables::LiteralLength)
+            return true;
+    }
+
+    return false;
+}
+
+/*
+ * It used to be Wikipedia's implementation of Boyer-Moore string search
+ * algorithm with search tables pre-calculated for "http" by hand. Shodan,
+ * that was written especially for you. Now the compiler calculates them,
+ * for any number of literals, so it's Horspool's simpler take on it: the
+ * window is moved by its last byte alone.
+ *
+ * Nowadays it's only a fallback for processors without vector extensions.
+ */
+template <typename Grammar>
+char const* searchLiteralScalar(char const* first, char const* last) {
+    using Tables = UrlTables<Grammar>;
+    const std::ptrdiff_t patlen = Tables::LiteralLength;
+
+    for (char const* it = first; last - it >= patlen; ) {
+        if (isLiteralAt<Grammar>(it, 0))
+            return it;
+
+        // Mind the cast: 'char' is signed on x86, and non-ASCII bytes
+        // would otherwise index the table with negative numbers.
+        it += Tables::Skip::values[(unsigned char)it[patlen-1]];
+    }
+
+    return last;
+}
+
+/*
+ * The vector versions compare a few overlapping unaligned blocks, shifted
+ * by one byte each, against the letters of a literal. Bit 'k' of the
+ * combined mask is set when a literal starts at 'k'-th byte of the block,
+ * so a rejected block costs a handful of instructions regardless of its
+ * contents. The loops over the literals and their letters are unrolled
+ * by the compiler, so for "http" it's four compares, just like it was
+ * when they were written by hand. The tail which is too short for a whole
+ * block (plus the look-ahead) is searched byte by byte.
+ *
+ * Instruction sets are enabled per function, so the program still runs
+ * on any x86-64, and 'detectSimdLevel' decides what's safe to call.
+ */
+#if defined(__x86_64__) || defined(__i386__)
+
+template <typename Grammar>
+__attribute__((target("sse2")))
+char const* searchLiteralSse2(char const* first, char const* last) {
+    using Tables = UrlTables<Grammar>;
+    const std::ptrdiff_t patlen = Tables::LiteralLength;
+
+    char const* it = first;
+    for (; last - it >= 16 + patlen - 1; it += 16) {
+        __m128i any = _mm_setzero_si128();
+
+#pragma GCC unroll 8
+        for (unsigned k = 0; k < Tables::NumLiterals; ++k) {
+            __m128i eq = _mm_set1_epi8(-1);
+
+#pragma GCC unroll 16
+            for (unsigned j = 0; j < Tables::LiteralLength; ++j) {
+                __m128i v = _mm_loadu_si128(
+                                reinterpret_cast<__m128i const*>(it + j));
+                eq = _mm_and_si128(eq, _mm_cmpeq_epi8(v,
+                                    _mm_set1_epi8(Tables::literal(k, j))));
+            }
+
+            any = _mm_or_si128(any, eq);
+        }
+
+        unsigned mask = _mm_movemask_epi8(any);
+        if (mask != 0)
+            return it + __builtin_ctz(mask);
+    }
+
+    for (; last - it >= patlen; ++it)
+        if (isLiteralAt<Grammar>(it, 0))
+            return it;
+
+    return last;
+}
+
+template <typename Grammar>
+__attribute__((target("avx2")))
+char const* searchLiteralAvx2(char const* first, char const* last) {
+    using Tables = UrlTables<Grammar>;
+    const std::ptrdiff_t patlen = Tables::LiteralLength;
+
+    char const* it = first;
+    for (; last - it >= 32 + patlen - 1; it += 32) {
+        __m256i any = _mm256_setzero_si256();
+
+#pragma GCC unroll 8
+        for (unsigned k = 0; k < Tables::NumLiterals; ++k) {
+            __m256i eq = _mm256_set1_epi8(-1);
+
+#pragma GCC unroll 16
+            for (unsigned j = 0; j < Tables::LiteralLength; ++j) {
+                __m256i v = _mm256_loadu_si256(
+                                reinterpret_cast<__m256i const*>(it + j));
+                eq = _mm256_and_si256(eq, _mm256_cmpeq_epi8(v,
+                                    _mm256_set1_epi8(Tables::literal(k, j))));
+            }
+
+            any = _mm256_or_si256(any, eq);
+        }
+
+        unsigned mask = _mm256_movemask_epi8(any);
+        if (mask != 0)
+            return it + __builtin_ctz(mask);
+    }
+
+    return searchLiteralSse2<Grammar>(it, last);
+}
+
+template <typename Grammar>
+__attribute__((target("avx512f,avx512bw")))
+char const* searchLiteralAvx512(char const* first, char const* last) {
+    using Tables = UrlTables<Grammar>;
+    const std::ptrdiff_t patlen = Tables::LiteralLength;
+
+    char const* it = first;
+    for (; last - it >= 64 + patlen - 1; it += 64) {
+        __mmask64 any = 0;
+
+#pragma GCC unroll 8
+        for (unsigned k = 0; k < Tables::NumLiterals; ++k) {
+            __mmask64 eq = ~__mmask64(0);
+
+#pragma GCC unroll 16
+            for (unsigned j = 0; j < Tables::LiteralLength; ++j) {
+                eq &= _mm512_cmpeq_epi8_mask(_mm512_loadu_si512(it + j),
+                                    _mm512_set1_epi8(Tables::literal(k, j)));
+            }
+
+            any |= eq;
+        }
+
+        if (any != 0)
+            return it + __builtin_ctzll(any);
+    }
+
+    return searchLiteralAvx2<Grammar>(it, last);
+}
+
+#endif
+
+/*
+ * Vector extensions the search functions are allowed to use. The level
+ * is asked from the processor once, at start-up. Setting SPEEDRUN_SIMD
+ * environment variable to "avx512", "avx2", "sse2" or "scalar" limits
+ * the choice, which is handy for comparing the implementations.
+ */
+enum class SimdLevel { Scalar, Sse2, Avx2, Avx512 };
+
+SimdLevel detectSimdLevel();
+
+// Chosen once at start-up, before any thread has a chance to need it.
+extern SimdLevel const simdLevel;
+
+template <typename Grammar>
+LiteralSearchFunc selectLiteralSearch(SimdLevel level) {
+#if defined(__x86_64__) || defined(__i386__)
+    if (level >= SimdLevel::Avx512)
+        return searchLiteralAvx512<Grammar>;
+    if (level >= SimdLevel::Avx2)
+        return searchLiteralAvx2<Grammar>;
+    if (level >= SimdLevel::Sse2)
+        return searchLiteralSse2<Grammar>;
+#endif
+
+    return searchLiteralScalar<Grammar>;
+}
+
+// Chosen on the first call, which is long after 'simdLevel' is known.
+template <typename Grammar>
+LiteralSearchFunc literalSearch() {
+    static LiteralSearchFunc const search =
+        selectLiteralSearch<Grammar>(simdLevel);
+    return search;
+}
+
+/*
+ * Looks for the literals of a grammar in the [begin, end) range of
+ * a buffer. The search functions want contiguous memory, so a circular
+ * buffer is searched piece by piece, and an occurrence which straddles
+ * the wrap-around point is checked for separately. If nothing is found,
+ * 'matchBegin' is the search re-run point.
+ */
+template <typename Grammar = UrlGrammar, typename Buffer>
+bool findLiteral(Buffer const& buf,
+                 UIndex begin, UIndex end, UIndex& matchBegin) {
+
+    const UIndex patlen = UrlTables<Grammar>::LiteralLength;
+    LiteralSearchFunc const search = literalSearch<Grammar>();
+
+    if (end - begin < patlen) {
+        matchBegin = begin;
+        return false;
+    }
+
+    UIndex pos = begin;
+    while (1) {
+        UIndex offset = buf.wrap(pos);
+        UIndex run = std::min(end - pos, buf.size() - offset);
+
+        char const* first = buf.begin() + offset;
+        char const* match = search(first, first + run);
+        if (match != first + run) {
+            matchBegin = pos + (match - first);
+            return true;
+        }
+
+        pos += run;
+        if (pos == end)
+            break;
+
+        UIndex i = pos - std::min(run, patlen-1);
+        for (; i < pos && i + patlen <= end; ++i) {
+            if (isLiteralAt<Grammar>(buf, i)) {
+                matchBegin = i;
+                return true;
+            }
+        }
+    }
+
+    // The last few characters may be the beginning of a literal which
+    // hasn't been read yet, so they have to be looked at once again.
+    matchBegin = end - (patlen-1);
+    return false;
+}
+
+/*
+ * Returns 'false' for the characters which cannot appear anywhere inside
+ * an URL, scheme included. No URL can span over such a character, so
+ * the search started right at it gives the same results as if it was
+ * started from the very beginning of the file. That's what makes cutting
+ * the input into independently scanned chunks possible.
+ */
+inline bool allowedInUrl(char ch) {
+    return UrlTables<UrlGrammar>::UrlMembership::values[(unsigned char)ch];
+}
+
+/*
+ * A span function returns the first byte in [first, last) which doesn't
+ * belong to a set of characters, or 'last' if there is none. That's how
+ * the ends of domain names and paths are found: in a single pass over the
+ * whole run of characters instead of an automaton step per byte. The sets
+ * are those of a grammar, like 'DomainChars<UrlGrammar>'.
+ */
+using SpanFunc = char const* (*)(char const* first, char const* last);
+
+template <typename Chars>
+char const* spanScalar(char const* first, char const* last) {
+    using Membership = GeneratedTable<MembershipOf<Chars>>;
+
+    while (first != last && Membership::values[(unsigned char)*first])
+        ++first;
+
+    return first;
+}
+
+/*
+ * The vector versions classify a whole block with a pair of 'pshufb'
+ * lookups: one by the low nibble of every byte, and one by the high
+ * nibble. Bit 'h' of the entry for the low nibble 'l' is set when the byte
+ * 0xhl belongs to the set (see 'LowNibblesOf'), and the high nibble table
+ * just picks bit 'h' out of it (see 'HighNibbles'). Non-ASCII bytes have
+ * high nibbles without any bits set, so they never belong to anything.
+ */
+
+#if defined(__x86_64__) || defined(__i386__)
+
+template <typename Chars>
+__attribute__((target("ssse3")))
+char const* spanSsse3(char const* first, char const* last) {
+    auto table = [](std::uint8_t const* t) {
+        return _mm_load_si128(reinterpret_cast<__m128i const*>(t));
+    };
+
+    const __m128i lowTable  = table(
+                                  GeneratedTable<LowNibblesOf<Chars>>::values);
+    const __m128i highTable = table(GeneratedTable<HighNibbles>::values);
+    const __m128i nibble    = _mm_set1_epi8(0x0F);
+    const __m128i zero      = _mm_setzero_si128();
+
+    for (; last - first >= 16; first += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(first));
+        __m128i lo = _mm_shuffle_epi8(lowTable, _mm_and_si128(v, nibble));
+        __m128i hi = _mm_shuffle_epi8(highTable,
+                            _mm_and_si128(_mm_srli_epi16(v, 4), nibble));
+
+        __m128i in = _mm_and_si128(lo, hi);
+        unsigned out = _mm_movemask_epi8(_mm_cmpeq_epi8(in, zero));
+        if (out != 0)
+            return first + __builtin_ctz(out);
+    }
+
+    return spanScalar<Chars>(first, last);
+}
+
+template <typename Chars>
+__attribute__((target("avx2")))
+char const* spanAvx2(char const* first, char const* last) {
+    auto table = [](std::uint8_t const* t) {
+        return reinterpret_cast<__m128i const*>(t);
+    };
+
+    // 'vpshufb' looks up within 128-bit lanes, so both lanes get a copy.
+    const __m256i lowTable  = _mm256_broadcastsi128_si256(_mm_load_si128(
+                         table(GeneratedTable<LowNibblesOf<Chars>>::values)));
+    const __m256i highTable = _mm256_broadcastsi128_si256(_mm_load_si128(
+                                  table(GeneratedTable<HighNibbles>::values)));
+    const __m256i nibble    = _mm256_set1_epi8(0x0F);
+    const __m256i zero      = _mm256_setzero_si256();
+
+    for (; last - first >= 32; first += 32) {
+        __m256i v = _mm256_loadu_si256(
+                               reinterpret_cast<__m256i const*>(first));
+        __m256i lo = _mm256_shuffle_epi8(lowTable,
+                                         _mm256_and_si256(v, nibble));
+        __m256i hi = _mm256_shuffle_epi8(highTable,
+                         _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+
+        __m256i in = _mm256_and_si256(lo, hi);
+        unsigned out = _mm256_movemask_epi8(_mm256_cmpeq_epi8(in, zero));
+        if (out != 0)
+            return first + __builtin_ctz(out);
+    }
+
+    return spanSsse3<Chars>(first, last);
+}
+
+template <typename Chars>
+__attribute__((target("avx512f,avx512bw")))
+char const* spanAvx512(char const* first, char const* last) {
+    using LowTable  = GeneratedTable<RepeatedOf<LowNibblesOf<Chars>, 4>>;
+    using HighTable = GeneratedTable<RepeatedOf<HighNibbles, 4>>;
+
+    const __m512i lowTable  = _mm512_load_si512(LowTable::values);
+    const __m512i highTable = _mm512_load_si512(HighTable::values);
+    const __m512i nibble    = _mm512_set1_epi8(0x0F);
+
+    for (; last - first >= 64; first += 64) {
+        __m512i v = _mm512_loadu_si512(first);
+        __m512i lo = _mm512_shuffle_epi8(lowTable,
+                                         _mm512_and_si512(v, nibble));
+        __m512i hi = _mm512_shuffle_epi8(highTable,
+                         _mm512_and_si512(_mm512_srli_epi16(v, 4), nibble));
+
+        __mmask64 in = _mm512_test_epi8_mask(lo, hi);
+        if (~in != 0)
+            return first + __builtin_ctzll(~in);
+    }
+
+    return spanAvx2<Chars>(first, last);
+}
+
+#endif
+
+template <typename Chars>
+SpanFunc selectSpan(SimdLevel level) {
+#if defined(__x86_64__) || defined(__i386__)
+    if (level >= SimdLevel::Avx512)
+        return spanAvx512<Chars>;
+    if (level >= SimdLevel::Avx2)
+        return spanAvx2<Chars>;
+    if (level >= SimdLevel::Sse2 && __builtin_cpu_supports("ssse3"))
+        return spanSsse3<Chars>;
+#endif
+
+    return spanScalar<Chars>;
+}
+
+// Chosen on the first call, just like 'literalSearch'.
+template <typename Chars>
+SpanFunc spanOf() {
+    static SpanFunc const span = selectSpan<Chars>(simdLevel);
+    return span;
+}
+
+/*
+ * Applies 'span' to the [begin, end) range of a buffer piece by piece,
+ * and returns the index of the first byte which doesn't belong.
+ */
+template <typename Buffer>
+UIndex skipSpan(Buffer const& buf,
+                UIndex begin, UIndex end, SpanFunc span) {
+
+    while (begin != end) {
+        UIndex offset = buf.wrap(begin);
+        UIndex run = std::min(end - begin, buf.size() - offset);
+
+        char const* first = buf.begin() + offset;
+        char const* stop  = span(first, first + run);
+
+        begin += stop - first;
+        if (stop != first + run)
+            break;
+    }
+
+    return begin;
+}
+
+/*
+ * A find function returns the first byte in [first, last) which is one of
+ * the 'numBytes' bytes at 'bytes', or 'last' if there is none. It's how the
+ * literals automaton of the extra patterns gets from its start state to the
+ * next byte which can begin a literal: most of the input begins nothing.
+ */
+using FindAnyFunc = char const* (*)(char const* first, char const* last,
+                                    char const* bytes, unsigned numBytes);
+
+// More bytes than that, and the vector versions would compare too much.
+constexpr unsigned MaxFindAnyBytes = 8;
+
+extern FindAnyFunc const findAny;
+
+/*
+ * Applies 'findAny' to the [begin, end) range of a buffer piece by piece.
+ */
+template <typename Buffer>
+UIndex skipToAny(Buffer const& buf, UIndex begin, UIndex end,
+                 std::string const& bytes) {
+
+    while (begin != end) {
+        UIndex offset = buf.wrap(begin);
+        UIndex run = std::min(end - begin, buf.size() - offset);
+
+        char const* first = buf.begin() + offset;
+        char const* stop  = findAny(first, first + run,
+                                    bytes.data(), bytes.size());
+
+        begin += stop - first;
+        if (stop != first + run)
+            break;
+    }
+
+    return begin;
+}
+
+/*
+ * How a look at a single candidate ended: it's a match, or it's not, or it
+ * may still become one when the input beyond the end of the range is read.
+ */
+enum class MatchStatus { Found, Rejected, NeedMore };
+
+/*
+ * Parses an URL of the grammar at 'literalBegin', where the prefilter has
+ * found one of its literals. That's one of the schemes followed by "://",
+ * then domain characters, and a path after the first '/'. Runs of domain
+ * and path characters are stepped over in one go. On success,
+ * 'domainBegin', 'pathBegin' and 'urlEnd' are set (see 'findUrl' for what
+ * they mean), and they are not touched otherwise.
+ */
+template <typename Grammar = UrlGrammar, typename Buffer>
+MatchStatus parseUrl(Buffer const& buf,
+                     UIndex  literalBegin,
+                     UIndex  end,
+                     bool    final,
+                     UIndex& domainBegin,
+                     UIndex& pathBegin,
+                     UIndex& urlEnd) {
+
+    using Tables = UrlTables<Grammar>;
+    MatchStatus cut = final ? MatchStatus::Rejected : MatchStatus::NeedMore;
+
+    // Which scheme it is, if any. They can't be prefixes of one another,
+    // with "://" after them.
+    UIndex idx = literalBegin;
+    bool truncated = false;
+    for (unsigned k = 0; k < Tables::NumSchemes && idx == literalBegin; ++k) {
+        char const* scheme = Tables::scheme(k);
+        UIndex length = Tables::SchemeLengths::values[k];
+
+        UIndex j = 0;
+        for (; j < length + 3 && literalBegin + j != end; ++j) {
+            char expected = j < length ? scheme[j] : "://"[j - length];
+            if (buf[literalBegin + j] != expected)
+                break;
+        }
+
+        if (j == length + 3)
+            idx = literalBegin + j;
+        else if (literalBegin + j == end)
+            truncated = true;
+    }
+
+    if (idx == literalBegin)
+        return truncated ? cut : MatchStatus::Rejected;
+
+    if (idx == end)
+        return cut;
+
+    using DomainMembership = typename Tables::DomainMembership;
+    if (!DomainMembership::values[(unsigned char)buf[idx]])
+        return MatchStatus::Rejected;
+
+    UIndex domain = idx;
+    idx = skipSpan(buf, idx, end, spanOf<DomainChars<Grammar>>());
+    if (idx == end && !final)
+        return MatchStatus::NeedMore;
+
+    if (idx == end || buf[idx] != '/') {
+        domainBegin = domain;
+        pathBegin = urlEnd = idx;
+        return MatchStatus::Found;
+    }
+
+    UIndex path = idx;
+    idx = skipSpan(buf, idx + 1, end, spanOf<PathChars<Grammar>>());
+    if (idx == end && !final)
+        return MatchStatus::NeedMore;
+
+    domainBegin = domain;
+    pathBegin = path;
+    urlEnd = idx;
+    return MatchStatus::Found;
+}
+
+/*
+ * Finds the first thing looking like an URL in the buffer 'buf' (either
+ * a 'RingArray', or an 'ArrayView' of a memory mapped file)
+ * in the [begin, end) range. If an URL was found, the function returns
+ * 'true' and sets its results like in the following example:
+ *
+ *     https://www.youtube.com/watch?v=oHg5SJYRHA0
+ *     ^       ^ domainBegin  ^     ^ urlEnd
+ *     urlBegin               pathBegin
+ *
+ * If the function hasn't found anything like an URL, or found a thing
+ * what, if continued beyond the 'end', may cause a longer match, it sets
+ * all these four results to the same value which should be treated as the
+ * search re-run point. When 'final' is set, there will be nothing beyond
+ * the 'end', and an URL which runs up to it is reported as found.
+ *
+ * Indices are not wrapped around: they grow monotonically as the stream
+ * is being read, and only the buffer itself takes them modulo its size.
+ */
+template <typename Grammar = UrlGrammar, typename Buffer>
+bool findUrl(Buffer const& buf,
+             UIndex  begin,
+             UIndex  end,
+             bool    final,
+             UIndex& urlBegin,
+             UIndex& domainBegin,
+             UIndex& pathBegin,
+             UIndex& urlEnd) {
+             // More arguments for the god of arguments.
+
+    UIndex literalBegin;
+    while (findLiteral<Grammar>(buf, begin, end, literalBegin)) {
+        Stats::add(Stats::HttpCandidates, 1);
+        switch (parseUrl<Grammar>(buf, literalBegin, end, final,
+                                  domainBegin, pathBegin, urlEnd)) {
+        case MatchStatus::Found:
+            Stats::add(Stats::UrlsFound, 1);
+            urlBegin = literalBegin;
+            return true;
+
+        case MatchStatus::NeedMore:
+            urlBegin = domainBegin = pathBegin = urlEnd = literalBegin;
+            return false;
+
+        case MatchStatus::Rejected:
+            // Not an URL, but there may be real ones further in the buffer.
+            begin = literalBegin + UrlTables<Grammar>::Restart;
+        }
+    }
+
+    urlBegin = domainBegin = pathBegin = urlEnd = literalBegin;
+    return false;
+}
@@ -1,25 +1,105 @@
+#include <chrono>
+#include <cstdint>
 #include <cstdlib>
 #include <iostream>
 #include <iomanip>
+#include <thread>
 #include <vector>
-#include <unordered_map>
-#include <boost/range/adaptors.hpp>
+#include "FrequencyTable.hpp"
+#include "InputFiles.hpp"
+#include "InputStream.hpp"
 #include "RegexSearchFile.hpp"
 #include "Helpers.hpp"
+#include "Stats.hpp"
+#include "ThreadPool.hpp"
+
+using FrequencyMap = FrequencyTable;
+
+// What's found in a file, or in all of them.
+struct Counts {
+    FrequencyMap hosts, paths;
+    std::uint64_t numMatches = 0;
+
+    void merge(Counts const& other) {
+        hosts.merge(other.hosts);
+        paths.merge(other.paths);
+        numMatches += other.numMatches;
+    }
+};
+
+Counts countFile(std::string method, InputFile const& input,
+                 DfaRegex const& rex) {
+
+    // Pipes and compressed files can't be mapped, they are read (and
+    // decompressed) by blocks, whatever the method. Neither can empty
+    // files, mmap() refuses a zero length. Only a regular file may be
+    // looked at twice: the first bytes of a pipe are gone once read, so
+    // 'InputStream' tells compression by the bytes it has read.
+    std::string const& inputFn = input.path;
+    if (!input.regular || input.size == 0
+            || detectCompression(inputFn) != Compression::None)
+        method = "buf";
+
+    // The search runs before the first batch and between the batches, so
+    // it's timed along with the counting, and with the waits for the reads.
+    Stats::Timer timer(Stats::ScanNanos);
+
+    RegexSearchCo::pull_type coro =
+        method == "mmap" ? spawn<RegexSearchCo>(regexSearchFileMmap, inputFn, rex)
+      : method == "buf"  ? spawn<RegexSearchCo>(regexSearchFileBuf, inputFn, rex, 100, 1024*1024)
+      : method == "window" ? spawn<RegexSearchCo>(regexSearchFileWindow, inputFn, rex, 100, 64*1024*1024)
+      : throw std::invalid_argument("lookup method unsupported");
+
+    Counts counts;
+
+    // Matches come in batches of groups' bounds, and are counted right
+    // in the file's data, with nothing copied.
+    for (auto const& batch: coro) {
+        Stats::add(Stats::UrlsFound, batch.size());
+
+        for (std::size_t idx = 0; idx < batch.size(); ++idx) {
+            // At this place some additional cleanup and canonicalization
+            // should be done. But the task doesn't insist on that.
+            StringRef path = batch.group(idx, 3);
+            if (path.empty())
+                path = StringRef("/", 1);
+
+            counts.hosts.add(batch.group(idx, 2));
+            counts.paths.add(path);
+        }
+
+        counts.numMatches += batch.size();
+    }
+
+    return counts;
+}
 
 int main(int argc, char *argv[]) {
-    if (argc != 4) {
+    // The only option, and an optional one.
+    std::string statsFn;
+    if (argc > 2 && std::string(argv[1]) == "--stats") {
+        statsFn = argv[2];
+        argv += 2;
+        argc -= 2;
+    }
+
+    if (argc < 4) {
         // Sorry for not using the original command line syntax proposed by
         // the problem formulation ("mytest [-n NNN] in.txt out.txt"),
         // I was too lazy for command-line options parsing. I hope that's
         // not a mission critical thing.
-        std::cout << "Usage: shodantask (mmap|buf) N INPUT_FILE\n";
+        std::cout << "Usage: shodantask [--stats FILE] (mmap|buf|window) N"
+                     " INPUT...\n"
+                     "An input may be a file, a directory or a glob.\n"
+                     "With --stats, where the time and memory went is"
+                     " written to FILE as JSON, '-' is stderr.\n";
         return EXIT_FAILURE;
     }
 
     auto method   = std::string(argv[1]);
     auto maxNum   = std::stoul (argv[2]);
-    auto inputFn  = std::string(argv[3]);
+    auto inputs   = listInputFiles(std::vector<std::string>(argv + 3,
+                                                            argv + argc));
 
     // The simplistic regex to find URLs (to find just as many patters,
     // as the problem formulation asks for). However, it can easily be
@@ -27,69 +107,45 @@ int main(int argc, char *argv[]) {
     constexpr auto urlRegexExpr = "(https?)://([\\w.-]+)(/[\\w_.,/+-]*)?";
                                 // 1          2         3
 
-    std::regex rex(urlRegexExpr, std::regex::icase);
+    DfaRegex rex(urlRegexExpr, std::regex::icase);
 
-    RegexSearchCo::pull_type coro =
-        method == "mmap" ? spawn<RegexSearchCo>(regexSearchFileMmap, inputFn, rex)
-      : method == "buf"  ? spawn<RegexSearchCo>(regexSearchFileBuf, inputFn, rex, 100, 32*1024)
-      : throw std::invalid_argument("lookup method unsupported");
+    if (method != "mmap" && method != "buf" && method != "window")
+        throw std::invalid_argument("lookup method unsupported");
 
-    using FrequencyMap = std::unordered_map<std::string, int>;
+    // Every file is searched on a thread of its own, the largest ones
+    // first, and its counts are merged into the total once it's done.
+    ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+    auto started = std::chrono::steady_clock::now();
 
-    FrequencyMap hosts, paths;
-    int numMatches = 0;
-    for (auto const& match: coro) {
-        // At this place some additional cleanup and canonicalization
-        // should be done. But the task doesn't insist on that.
-        std::string host = match.str(2);
-        std::string path = match.str(3);
-        if (path.empty())
-            path = "/";
-
-        ++numMatches;
-
-        auto ihost = hosts.find(host);
-        if (ihost != hosts.end())
-            ++(ihost->second);
-        else hosts[host] = 1;
-
-        auto ipath = paths.find(path);
-        if (ipath != paths.end())
-            ++(ipath->second);
-        else paths[path] = 1;
+    std::vector<Task<Counts>> tasks;
+    for (auto const& input: inputs) {
+        tasks.push_back(pool.submit([method, input, &rex]{
+            return countFile(method, input, rex);
+        }));
+    }
+
+    Counts total;
+    for (std::size_t k = 0; k < tasks.size(); ++k) {
+        if (k == 0)
+            total = tasks[k].get();
+        else
+            total.merge(tasks[k].get());
     }
 
-    // Convenience subroutine which sorts 'map' items by 'second' field,
+    FrequencyMap const& hosts = total.hosts;
+    FrequencyMap const& paths = total.paths;
+    std::uint64_t numMatches = total.numMatches;
+
+    // Convenience subroutine which sorts 'map' items by their counts,
     // and prints the most frequent items as a nice text table.
-    auto printTop = [maxNum](FrequencyMap& map){
-
-        // Instead of copying pairs from the original map, simply fill
-        // a vector with their addresses.
-        std::vector<FrequencyMap::pointer> pointers;
-        pointers.reserve(map.size());
-        for (auto& pair: map) {
-            pointers.push_back(std::addressof(pair));
-        }
+    auto printTop = [maxNum, &pool](FrequencyMap const& map){
 
-        // Just sort the vercor. I know, this is not not the best possible
-        // approach from the O() point of view, but I have not enough spare
-        // time for elaborated algorithms in a test assignment.
-        using Pointer = FrequencyMap::pointer;
-        std::sort(pointers.begin(), pointers.end(),
-                  [](Pointer const& a, Pointer const& b) {
-                              return a->second > b->second; });
-
-        // For some reason which is unclear to me, boost::adaptors::sliced
-        // fails when the requested slice size is greater than the range
-        // size. Instead of rolling out custom adaptor it's easier to
-        // adjust the requested size appropriately.
-        auto num = std::min(maxNum, pointers.size());
-
-        using boost::adaptors::sliced;
-        for (auto const& ptr: pointers | sliced(0, num)) {
+        // Only the requested number of entries is ever sorted, the rest
+        // are filtered out by a heap of the best ones.
+        for (auto const& ptr: map.top(maxNum, &pool)) {
             std::cout << std::left
-                      << std::setw(6) << ptr->second
-                               << " " << ptr->first << std::endl;
+                      << std::setw(6) << ptr->count()
+                               << " " << ptr->key() << std::endl;
         }
     };
 
@@ -101,4 +157,19 @@ int main(int argc, char *argv[]) {
 
     std::cout << "Most frequent paths:" << std::endl;
     printTop(paths);
+
+    if (!statsFn.empty()) {
+        std::uint64_t inputBytes = 0;
+        for (auto const& input: inputs)
+            inputBytes += input.size;
+
+        auto elapsed = std::chrono::steady_clock::now() - started;
+        Stats::writeJson(statsFn, {
+            {"elapsed_ms", std::chrono::duration_cast<
+                               std::chrono::milliseconds>(elapsed).count()},
+            {"input_bytes", inputBytes},
+            {"urls", numMatches},
+            {"table_bytes", hosts.memoryUsage() + paths.memoryUsage()},
+        });
+    }
 }
@@ -0,0 +1,250 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <string>
+#include <system_error>
+#include <vector>
+#include "../src/BlockReader.hpp"
+#include "Check.hpp"
+
+namespace {
+
+// Blocks as large as the scanner's would make a slow test, and these are
+// still aligned the way O_DIRECT wants.
+const std::size_t BlockSize = 16*1024;
+const unsigned Depth = 4;
+const unsigned NumSlots = 2*Depth;
+
+std::string randomText(std::mt19937& random, std::size_t size) {
+    std::string text;
+    while (text.size() < size)
+        text += char(random());
+    return text;
+}
+
+void writeFile(std::string const& filename, std::string const& text) {
+    std::ofstream output(filename, std::ios_base::binary);
+    output << text;
+}
+
+std::string readFile(std::string const& filename) {
+    std::ifstream input(filename, std::ios_base::binary);
+    return std::string(std::istreambuf_iterator<char>(input),
+                       std::istreambuf_iterator<char>());
+}
+
+/*
+ * The buffer the way the scanner has it, aligned for O_DIRECT. It's a slot
+ * per block, no matter where in the file the block is.
+ */
+std::shared_ptr<char> makeBuffer() {
+    void* ptr = nullptr;
+    if (::posix_memalign(&ptr, BlockReader::DirectAlignment,
+                         NumSlots * BlockSize) != 0)
+        throw std::bad_alloc();
+    return std::shared_ptr<char>(static_cast<char*>(ptr), std::free);
+}
+
+/*
+ * Reads the first 'numBlocks' blocks of the file behind 'reader', up to
+ * 'Depth' of them in flight, the same way the scanner does, and compares
+ * what has come with 'text'. The blocks past the end of the file come
+ * short, or empty.
+ */
+void checkBlocks(BlockReader& reader, char* buffer, std::string const& text,
+                 unsigned numBlocks) {
+    std::vector<bool> arrived(numBlocks, false);
+
+    for (unsigned first = 0; first < numBlocks; first += Depth) {
+        unsigned last = std::min(first + Depth, numBlocks);
+
+        // Backwards, so that completions have a chance to come out of order.
+        // A tag is below the depth, so it's the block's place in the batch.
+        for (unsigned block = last; block-- > first; ) {
+            reader.submit(block - first, buffer + block % NumSlots * BlockSize,
+                          BlockSize, block * BlockSize);
+        }
+
+        for (unsigned k = first; k < last; ++k) {
+            BlockReader::Completion done = reader.wait();
+            unsigned block = first + done.tag;
+            CHECK(block < last);
+            if (block >= last)
+                continue;
+
+            CHECK(!arrived[block]);
+            arrived[block] = true;
+
+            std::size_t offset = std::min(block * BlockSize, text.size());
+            std::size_t expected = std::min(BlockSize, text.size() - offset);
+            CHECK_EQ(done.length, expected);
+
+            char const* got = buffer + block % NumSlots * BlockSize;
+            CHECK(std::string(got, std::min(done.length, expected))
+                      == text.substr(offset, expected));
+        }
+    }
+}
+
+// Enough blocks for the whole of 'text', and two more past its end.
+unsigned blocksOf(std::string const& text) {
+    return (text.size() + BlockSize - 1) / BlockSize + 2;
+}
+
+/*
+ * A file which doesn't end at a block boundary, read with and without
+ * O_DIRECT, then another one by the same reader. Whatever the filesystem
+ * says to O_DIRECT, the reads give the same.
+ */
+void testBackend(std::mt19937& random, std::string const& prefix,
+                 ReaderOptions::Backend backend, char const* name) {
+    std::string firstFn = prefix + ".first";
+    std::string secondFn = prefix + ".second";
+    std::string first = randomText(random, 5*BlockSize + 1000);
+    std::string second = randomText(random, 2*BlockSize - 1);
+    writeFile(firstFn, first);
+    writeFile(secondFn, second);
+
+    auto buffer = makeBuffer();
+
+    for (bool direct: {false, true}) {
+        ReaderOptions options;
+        options.backend = backend;
+        options.direct = direct;
+
+        auto reader = BlockReader::open(firstFn, buffer.get(),
+                                        NumSlots * BlockSize, Depth, options);
+        CHECK_EQ(std::string(reader->name()), name);
+        CHECK(reader->alignment() == 1
+              || (direct && reader->alignment()
+                                == BlockReader::DirectAlignment));
+        checkBlocks(*reader, buffer.get(), first, blocksOf(first));
+
+        // Another file, with the threads, or the ring, kept.
+        reader->reopen(secondFn, options);
+        CHECK_EQ(std::string(reader->name()), name);
+        checkBlocks(*reader, buffer.get(), second, blocksOf(second));
+
+        // A file which isn't there leaves the reader good for another try.
+        bool thrown = false;
+        try {
+            reader->reopen(prefix + ".missing", options);
+        } catch (std::system_error const&) {
+            thrown = true;
+        }
+        CHECK(thrown);
+
+        reader->reopen(firstFn, options);
+        checkBlocks(*reader, buffer.get(), first, blocksOf(first));
+    }
+
+    std::remove(firstFn.c_str());
+    std::remove(secondFn.c_str());
+}
+
+/*
+ * A file of procfs refuses O_DIRECT, and is read through the page cache
+ * then. Whatever it is, it's shorter than a block, so it comes short.
+ */
+void testDirectFallback(ReaderOptions::Backend backend) {
+    std::string const filename = "/proc/version";
+    std::string text = readFile(filename);
+    if (text.empty())
+        return;
+
+    auto buffer = makeBuffer();
+    ReaderOptions options;
+    options.backend = backend;
+    options.direct = true;
+
+    auto reader = BlockReader::open(filename, buffer.get(),
+                                    NumSlots * BlockSize, Depth, options);
+    CHECK_EQ(reader->alignment(), 1u);
+    checkBlocks(*reader, buffer.get(), text, 2);
+
+    reader->reopen(filename, options);
+    CHECK_EQ(reader->alignment(), 1u);
+    checkBlocks(*reader, buffer.get(), text, 2);
+}
+
+// A failed read comes out of 'wait()', rather than as the end of the file.
+void testReadError(ReaderOptions::Backend backend) {
+    auto buffer = makeBuffer();
+    ReaderOptions options;
+    options.backend = backend;
+
+    auto reader = BlockReader::open("/", buffer.get(), NumSlots * BlockSize,
+                                    Depth, options);
+    reader->submit(0, buffer.get(), BlockSize, 0);
+
+    bool thrown = false;
+    try {
+        reader->wait();
+    } catch (std::system_error const&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+
+    // The missing file is told at once.
+    thrown = false;
+    try {
+        BlockReader::open("/nonexistent/file", buffer.get(),
+                          NumSlots * BlockSize, Depth, options);
+    } catch (std::system_error const&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+
+// Whatever the kernel is, 'Auto' gives a working reader.
+bool uringAvailable() {
+    auto buffer = makeBuffer();
+    auto reader = BlockReader::open("/proc/self/exe", buffer.get(),
+                                    NumSlots * BlockSize, Depth,
+                                    ReaderOptions());
+    return std::string(reader->name()) == "io_uring";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " TEMPPREFIX" << std::endl;
+        return 2;
+    }
+
+    std::mt19937 random(20240601);
+
+    testBackend(random, argv[1], ReaderOptions::Pread, "pread");
+    testDirectFallback(ReaderOptions::Pread);
+    testReadError(ReaderOptions::Pread);
+
+    // io_uring may be missing, or forbidden, and then there's nothing
+    // to test, but that asking for it explicitly fails.
+    if (uringAvailable()) {
+        testBackend(random, argv[1], ReaderOptions::Uring, "io_uring");
+        testDirectFallback(ReaderOptions::Uring);
+        testReadError(ReaderOptions::Uring);
+    } else {
+        std::cout << "io_uring isn't available" << std::endl;
+
+        bool thrown = false;
+        try {
+            auto buffer = makeBuffer();
+            ReaderOptions options;
+            options.backend = ReaderOptions::Uring;
+            BlockReader::open("/proc/self/exe", buffer.get(),
+                              NumSlots * BlockSize, Depth, options);
+        } catch (std::system_error const&) {
+            thrown = true;
+        }
+        CHECK(thrown);
+    }
+
+    return checkResult("BlockReader");
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <iostream>
+#include <sstream>
+#include <string>
+
+/*
+ * Just enough of a test framework for these tests. A failed check tells
+ * where it is and what it has seen, and the test goes on, so a single run
+ * shows everything that's broken. A test's 'main' returns 'checkResult()'.
+ */
+inline unsigned& checkFailures() {
+    static unsigned failures = 0;
+    return failures;
+}
+
+inline void checkFailed(char const* file, int line, std::string const& what) {
+    std::cerr << file << ":" << line << ": FAIL: " << what << std::endl;
+    ++checkFailures();
+}
+
+#define CHECK(expr) \
+    do { \
+        if (!(expr)) \
+            checkFailed(__FILE__, __LINE__, #expr); \
+    } while (0)
+
+#define CHECK_EQ(actual, expected) \
+    do { \
+        auto const& checkActual_   = (actual); \
+        auto const& checkExpected_ = (expected); \
+        if (!(checkActual_ == checkExpected_)) { \
+            std::ostringstream checkOut_; \
+            checkOut_ << #actual << " is " << checkActual_ \
+                      << ", expected " << checkExpected_; \
+            checkFailed(__FILE__, __LINE__, checkOut_.str()); \
+        } \
+    } while (0)
+
+inline int checkResult(char const* name) {
+    if (checkFailures() != 0) {
+        std::cerr << name << ": " << checkFailures() << " checks failed"
+                  << std::endl;
+        return 1;
+    }
+
+    std::cout << name << ": OK" << std::endl;
+    return 0;
+}
@@ -0,0 +1,176 @@
+#include <random>
+#include <regex>
+#include <string>
+#include "../src/DfaRegex.hpp"
+#include "Check.hpp"
+
+namespace {
+
+using StdIterator = std::sregex_iterator;
+using DfaIterator = DfaRegexIterator<std::string::const_iterator>;
+
+/*
+ * Every match of an iteration with its groups, as offsets into the text.
+ * A group which didn't participate is an empty range at the end of the
+ * match, which is how 'DfaMatch' has it.
+ */
+template <typename It, typename Match>
+std::string describe(std::string const& text, It it, It end,
+                     std::size_t numGroups) {
+    auto offset = [&](std::string::const_iterator pos) {
+        return std::to_string(pos - text.begin());
+    };
+
+    std::string matches = "\n";
+    for (; it != end; ++it) {
+        Match const& match = *it;
+        for (std::size_t g = 0; g <= numGroups; ++g) {
+            bool empty = match[g].first == match[g].second;
+            auto first = empty ? match[0].second : match[g].first;
+            auto last  = empty ? match[0].second : match[g].second;
+            matches += offset(first) + "-" + offset(last) + " ";
+        }
+        matches += "\n";
+    }
+
+    return matches;
+}
+
+std::string stdMatches(std::string const& text, std::regex const& rex) {
+    return describe<StdIterator, std::smatch>(
+               text, StdIterator(text.begin(), text.end(), rex),
+               StdIterator(), rex.mark_count());
+}
+
+std::string dfaMatches(std::string const& text, DfaRegex const& rex) {
+    return describe<DfaIterator, DfaMatch<std::string::const_iterator>>(
+               text, DfaIterator(text.begin(), text.end(), rex),
+               DfaIterator(), rex.mark_count());
+}
+
+// Where every match starts and ends, the groups left out.
+std::string spans(std::string const& text, std::string const& pattern,
+                  std::regex::flag_type flags = std::regex::ECMAScript) {
+    DfaRegex rex(pattern, flags);
+    std::string result;
+    for (DfaIterator it(text.begin(), text.end(), rex), end; it != end; ++it)
+        result += "[" + it->str() + "]";
+    return result;
+}
+
+void testEmptyMatches() {
+    CHECK_EQ(spans("baab", "a*"), "[][aa][][]");
+    CHECK_EQ(spans("", "a*"), "[]");
+    CHECK_EQ(spans("", "a"), "");
+    CHECK_EQ(spans("abc", "(?:)"), "[][][][]");
+    CHECK_EQ(spans("ab", "a|"), "[a][][]");
+    CHECK_EQ(spans("xaby", "b?"), "[][][b][][]");
+    CHECK_EQ(spans("aaa", "(?:a|b?)"), "[a][a][a][]");
+
+    // A default constructed iterator is the end of any iteration.
+    DfaIterator end;
+    CHECK(end == DfaIterator());
+    CHECK(!(end != DfaIterator()));
+}
+
+void testIcase() {
+    auto icase = std::regex::ECMAScript | std::regex::icase;
+    CHECK_EQ(spans("HTTP http HtTp", "http", icase), "[HTTP][http][HtTp]");
+    CHECK_EQ(spans("HTTP http", "http"), "[http]");
+    CHECK_EQ(spans("xABCy", "[a-c]+", icase), "[ABC]");
+    CHECK_EQ(spans("xabcY", "[A-C]+", icase), "[abc]");
+    CHECK_EQ(spans("aBz", "[^b]+", icase), "[a][z]");
+    CHECK_EQ(spans("Q_q", "\\w", icase), "[Q][_][q]");
+}
+
+/*
+ * A random pattern of the syntax DfaRegex knows. The loops never get
+ * a body which can match an empty string, since there libstdc++ parts
+ * with ECMAScript (see 'DfaRegex'). 'empty' tells whether the pattern may
+ * match an empty string.
+ */
+std::string randomPattern(std::mt19937& random, unsigned depth, bool& empty) {
+    static char const* const atoms[] = {
+        "a", "b", "c", "A", "1", " ", ".", "[ab]", "[^a]", "[a-c]", "[B-C1]",
+        "\\d", "\\w", "\\s", "\\.", "\\x41" };
+    static char const* const quantifiers[] = { "?", "*", "+" };
+
+    std::string pattern;
+    empty = false;
+
+    unsigned numBranches = 1 + random() % 3;
+    for (unsigned b = 0; b < numBranches; ++b) {
+        if (b != 0)
+            pattern += "|";
+
+        bool branchEmpty = true;
+        unsigned numPieces = 1 + random() % 3;
+        for (unsigned p = 0; p < numPieces; ++p) {
+            std::string atom;
+            bool atomEmpty = false;
+            if (depth > 0 && random() % 4 == 0) {
+                atom = random() % 2 ? "(" : "(?:";
+                atom += randomPattern(random, depth - 1, atomEmpty) + ")";
+            } else {
+                atom = atoms[random() % (sizeof atoms / sizeof atoms[0])];
+            }
+
+            if (!atomEmpty && random() % 3 == 0) {
+                char const* quantifier = quantifiers[random() % 3];
+                atom += quantifier;
+                atomEmpty = quantifier[0] != '+';
+            }
+
+            pattern += atom;
+            branchEmpty = branchEmpty && atomEmpty;
+        }
+
+        empty = empty || branchEmpty;
+    }
+
+    return pattern;
+}
+
+std::string randomText(std::mt19937& random) {
+    static char const chars[] = "abcABC1 .\n";
+    std::string text;
+    for (std::size_t length = random() % 16; length != 0; --length)
+        text += chars[random() % (sizeof chars - 1)];
+    return text;
+}
+
+void testRandom(std::mt19937& random, unsigned numPatterns) {
+    for (unsigned k = 0; k < numPatterns; ++k) {
+        bool empty;
+        std::string pattern = randomPattern(random, 2, empty);
+        auto flags = std::regex::ECMAScript;
+        if (random() % 3 == 0)
+            flags |= std::regex::icase;
+
+        std::regex stdRex(pattern, flags);
+        DfaRegex dfaRex(pattern, flags);
+
+        for (unsigned t = 0; t < 6; ++t) {
+            std::string text = randomText(random);
+            std::string expected = stdMatches(text, stdRex);
+            std::string actual = dfaMatches(text, dfaRex);
+            if (actual != expected) {
+                checkFailed(__FILE__, __LINE__, "/" + pattern + "/ on \""
+                            + text + "\" gives" + actual + "expected"
+                            + expected);
+            }
+        }
+    }
+}
+
+} // namespace
+
+int main() {
+    testEmptyMatches();
+    testIcase();
+
+    std::mt19937 random(20240601);
+    testRandom(random, 2000);
+
+    return checkResult("DfaRegex");
+}
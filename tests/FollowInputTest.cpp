@@ -0,0 +1,155 @@
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include "../src/FollowInput.hpp"
+#include "../src/ScanResult.hpp"
+#include "../src/ThreadPool.hpp"
+#include "Check.hpp"
+
+namespace {
+
+void appendTo(std::string const& filename, std::string const& text) {
+    std::ofstream output(filename, std::ios_base::binary | std::ios_base::app);
+    output << text;
+}
+
+void rewrite(std::string const& filename, std::string const& text) {
+    std::ofstream output(filename, std::ios_base::binary);
+    output << text;
+}
+
+// Every domain and path counted so far, for readable failures.
+std::string countsOf(ScanResult const& result) {
+    std::string counts = std::to_string(result.numMatches) + ":";
+    for (auto const* counter: {&result.urlDomains, &result.urlPaths}) {
+        std::map<std::string, std::uint64_t> table;
+        for (auto const& entry: counter->exact())
+            table[entry.key().str()] = entry.count();
+
+        for (auto const& entry: table)
+            counts += " " + entry.first + "=" + std::to_string(entry.second);
+        counts += " |";
+    }
+
+    return counts;
+}
+
+/*
+ * The file grows by whole lines, then by a line cut right in an URL, which
+ * isn't counted until its end comes, and then counted once, whole.
+ */
+void testAppend(ThreadPool& pool, std::string const& filename) {
+    std::remove(filename.c_str());
+
+    FollowedInput input(ScanConfig(), filename, ReaderOptions());
+    CHECK(!input.update(pool));
+    CHECK_EQ(countsOf(input.total()), "0: | |");
+
+    rewrite(filename, "GET http://a.com/x 200\n");
+    CHECK(input.update(pool));
+    CHECK_EQ(countsOf(input.total()), "1: a.com=1 | /x=1 |");
+
+    // Nothing new, nothing counted.
+    CHECK(!input.update(pool));
+    CHECK_EQ(countsOf(input.total()), "1: a.com=1 | /x=1 |");
+
+    appendTo(filename, "GET http://b.com/y 200\nGET http://a.com/x 404\n");
+    CHECK(!input.update(pool));
+    CHECK_EQ(countsOf(input.total()), "3: a.com=2 b.com=1 | /x=2 /y=1 |");
+
+    appendTo(filename, "GET http://c.com/pa");
+    std::uint64_t before = input.offset();
+    CHECK(!input.update(pool));
+    CHECK_EQ(countsOf(input.total()), "3: a.com=2 b.com=1 | /x=2 /y=1 |");
+    CHECK(input.offset() > before);
+
+    // Still no end to it.
+    appendTo(filename, "th/to");
+    CHECK(!input.update(pool));
+    CHECK_EQ(countsOf(input.total()), "3: a.com=2 b.com=1 | /x=2 /y=1 |");
+
+    appendTo(filename, "/it 200\n");
+    CHECK(!input.update(pool));
+    CHECK_EQ(countsOf(input.total()),
+             "4: a.com=2 b.com=1 c.com=1 | /path/to/it=1 /x=2 /y=1 |");
+
+    std::remove(filename.c_str());
+}
+
+/*
+ * A file cut shorter, like by 'truncate' or '>', is the same file, but it
+ * has been rotated in place, and what it has now is all there is.
+ */
+void testTruncate(ThreadPool& pool, std::string const& filename) {
+    rewrite(filename, "GET http://a.com/x 200\nGET http://b.com/y 200\n");
+
+    FollowedInput input(ScanConfig(), filename, ReaderOptions());
+    CHECK(input.update(pool));
+    CHECK_EQ(countsOf(input.total()), "2: a.com=1 b.com=1 | /x=1 /y=1 |");
+
+    rewrite(filename, "");
+    CHECK(!input.update(pool));
+    CHECK_EQ(countsOf(input.total()), "0: | |");
+    CHECK_EQ(input.offset(), 0u);
+
+    appendTo(filename, "GET http://c.com/z 200\n");
+    CHECK(!input.update(pool));
+    CHECK_EQ(countsOf(input.total()), "1: c.com=1 | /z=1 |");
+
+    // Shorter, but not empty, than what has been counted.
+    rewrite(filename, "http://d.com/ \n");
+    CHECK(!input.update(pool));
+    CHECK_EQ(countsOf(input.total()), "1: d.com=1 | /=1 |");
+
+    std::remove(filename.c_str());
+}
+
+/*
+ * A file renamed away, and a new one put in its place, is another file,
+ * even when it's larger than the old one, and it's counted from scratch.
+ */
+void testRotate(ThreadPool& pool, std::string const& filename) {
+    std::string rotatedFn = filename + ".1";
+    rewrite(filename, "GET http://a.com/x 200\n");
+
+    FollowedInput input(ScanConfig(), filename, ReaderOptions());
+    CHECK(input.update(pool));
+    CHECK_EQ(countsOf(input.total()), "1: a.com=1 | /x=1 |");
+
+    // Written to the old file after the rename, which nobody reads.
+    CHECK_EQ(std::rename(filename.c_str(), rotatedFn.c_str()), 0);
+    appendTo(rotatedFn, "GET http://lost.com/ 200\n");
+
+    // Not there yet, then the new one.
+    CHECK(!input.update(pool));
+    CHECK_EQ(countsOf(input.total()), "1: a.com=1 | /x=1 |");
+
+    rewrite(filename, "GET http://b.com/y 200\nGET http://b.com/z 200\n");
+    CHECK(input.update(pool));
+    CHECK_EQ(countsOf(input.total()), "2: b.com=2 | /y=1 /z=1 |");
+
+    appendTo(filename, "GET http://c.com/y 200\n");
+    CHECK(!input.update(pool));
+    CHECK_EQ(countsOf(input.total()), "3: b.com=2 c.com=1 | /y=2 /z=1 |");
+
+    std::remove(rotatedFn.c_str());
+    std::remove(filename.c_str());
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " TEMPFILE" << std::endl;
+        return 2;
+    }
+
+    ThreadPool pool(2);
+    testAppend(pool, argv[1]);
+    testTruncate(pool, argv[1]);
+    testRotate(pool, argv[1]);
+
+    return checkResult("followInput");
+}
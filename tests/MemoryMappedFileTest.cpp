@@ -0,0 +1,229 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include "../src/MemoryMappedFile.hpp"
+#include "Check.hpp"
+
+extern "C" {
+    #include <dirent.h>
+    #include <sys/mman.h>
+    #include <unistd.h>
+}
+
+namespace {
+
+std::string randomText(std::mt19937& random, std::size_t size) {
+    std::string text;
+    while (text.size() < size)
+        text += char('a' + random() % 26);
+    return text;
+}
+
+void writeFile(std::string const& filename, std::string const& text) {
+    std::ofstream output(filename, std::ios_base::binary);
+    output << text;
+}
+
+// What the window has of the [begin, end) range of the file.
+std::string windowed(MappedWindow const& window, std::uint64_t begin,
+                     std::uint64_t end) {
+    return std::string(window.begin() + (begin - window.offset()),
+                       end - begin);
+}
+
+/*
+ * A match cut by the end of a window is what the scanner moves the window
+ * for: it's moved to where the match begins, or a bit before, and then
+ * the whole match is in the new window, which overlaps the old one.
+ */
+void testWindowOverlap(std::mt19937& random, std::string const& filename) {
+    std::size_t pageSize = ::sysconf(_SC_PAGESIZE);
+    std::string text = randomText(random, 7*pageSize + 123);
+    writeFile(filename, text);
+
+    MappingOptions options;
+    options.windowSize = 2*pageSize;
+
+    for (bool drop: {false, true}) {
+        options.dropConsumed = drop;
+        MappedWindow window(filename, options);
+        CHECK_EQ(window.fileSize(), text.size());
+        CHECK_EQ(window.offset(), 0u);
+        CHECK_EQ(window.endOffset(), 2*pageSize);
+        CHECK(!window.isLast());
+
+        for (std::size_t length: {1u, 100u, 4000u}) {
+            for (std::uint64_t windowEnd = window.endOffset();
+                 windowEnd < text.size(); windowEnd = window.endOffset()) {
+
+                // Begins a few bytes before the window's end, and goes on
+                // past it, but is shorter than a window.
+                std::uint64_t matchBegin = windowEnd - std::min<std::size_t>(
+                                               length, windowEnd - 1);
+                std::uint64_t matchEnd = std::min<std::uint64_t>(
+                                             windowEnd + length, text.size());
+                std::uint64_t oldOffset = window.offset();
+
+                window.moveTo(matchBegin);
+                CHECK(window.offset() <= matchBegin);
+                CHECK(window.offset() > oldOffset);
+                CHECK_EQ(window.offset() % pageSize, 0u);
+                CHECK(window.endOffset() >= matchEnd);
+                CHECK_EQ(windowed(window, matchBegin, matchEnd),
+                         text.substr(matchBegin, matchEnd - matchBegin));
+            }
+
+            CHECK(window.isLast());
+            CHECK_EQ(window.endOffset(), text.size());
+            window.moveTo(0);
+        }
+
+        // Every window has just what's in the file, wherever it's moved.
+        for (std::uint64_t offset: {0u, 1u, 4095u, 4096u, 5000u, 12345u}) {
+            window.moveTo(offset);
+            CHECK_EQ(windowed(window, window.offset(), window.endOffset()),
+                     text.substr(window.offset(),
+                                 window.endOffset() - window.offset()));
+        }
+
+        // Past the end, it's the last page.
+        window.moveTo(text.size() + 100);
+        CHECK_EQ(window.offset(), text.size() / pageSize * pageSize);
+        CHECK(window.isLast());
+    }
+
+    // A window is two pages at least, whatever is asked for.
+    options.windowSize = 1;
+    MappedWindow small(filename, options);
+    CHECK_EQ(small.endOffset(), 2*pageSize);
+
+    std::remove(filename.c_str());
+}
+
+std::size_t countOpenFiles() {
+    std::size_t count = 0;
+    if (DIR* dir = ::opendir("/proc/self/fd")) {
+        while (::readdir(dir))
+            ++count;
+        ::closedir(dir);
+    }
+    return count;
+}
+
+/*
+ * A window which can't be made doesn't leave its descriptor behind. procfs
+ * won't tell the size of its files, and sysfs has one, but doesn't map.
+ */
+void testWindowFailure() {
+    std::size_t before = countOpenFiles();
+
+    for (char const* filename: {"/proc/version",
+                                "/sys/kernel/mm/transparent_hugepage/enabled",
+                                "/nonexistent/file"}) {
+        bool thrown = false;
+        try {
+            MappedWindow window(filename, MappingOptions());
+        } catch (std::system_error const&) {
+            thrown = true;
+        }
+
+        // The sysfs file may be missing, and then it's missing.
+        if (std::ifstream(filename).is_open())
+            CHECK(thrown);
+    }
+
+    CHECK_EQ(countOpenFiles(), before);
+}
+
+/*
+ * Several scans of a mapping at once, reading ahead and releasing what
+ * they have passed, still see just what's in the file, and so does anybody
+ * who looks at the released pages afterwards.
+ */
+void testMappedScan(std::mt19937& random, std::string const& filename) {
+    std::size_t pageSize = ::sysconf(_SC_PAGESIZE);
+    std::string text = randomText(random, 3*1024*1024 + 777);
+    writeFile(filename, text);
+
+    MappingOptions options;
+    options.readAhead = 64*pageSize;
+    options.dropConsumed = true;
+    options.sequential = true;
+    options.hugePages = true;
+
+    MemoryMappedFile file(filename, options);
+    CHECK_EQ(std::size_t(file.end() - file.begin()), text.size());
+
+    const unsigned numScans = 3;
+    std::vector<std::string> seen(numScans);
+    std::vector<std::thread> threads;
+    for (unsigned k = 0; k < numScans; ++k) {
+        std::size_t begin = text.size() * k / numScans;
+        std::size_t end = text.size() * (k + 1) / numScans;
+
+        threads.emplace_back([&, k, begin, end]{
+            MappedScan scan(file, begin, end);
+            adviseMapping(file.begin() + begin, end - begin, file.options(),
+                          MADV_WILLNEED);
+
+            // Odd steps, so that the scan never stops at a page boundary,
+            // and a step back now and then, which is just ignored.
+            for (std::size_t pos = begin; pos < end; ) {
+                std::size_t next = std::min(end, pos + 10007);
+                seen[k].append(file.begin() + pos, next - pos);
+                scan.advance(next);
+                scan.advance(pos);
+                pos = next;
+            }
+        });
+    }
+
+    for (auto& thread: threads)
+        thread.join();
+
+    std::string all;
+    for (auto const& part: seen)
+        all += part;
+    CHECK(all == text);
+
+    // The released pages are read from the file again.
+    CHECK(std::string(file.begin(), file.end()) == text);
+
+    // An empty scan, and one which is dropped right away.
+    { MappedScan scan(file, 100, 100); }
+    { MappedScan scan(file, 0, text.size()); }
+
+    CHECK(file.advise(MADV_NORMAL, 4095, 10));
+    CHECK(!file.advise(MADV_NORMAL, text.size(), 10));
+    CHECK(file.release(1, 2*pageSize));
+    CHECK(std::string(file.begin(), file.end()) == text);
+
+    file.close();
+    CHECK(!file.isOpen());
+    CHECK(!file.advise(MADV_NORMAL));
+
+    std::remove(filename.c_str());
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " TEMPFILE" << std::endl;
+        return 2;
+    }
+
+    std::mt19937 random(20240601);
+
+    testWindowOverlap(random, argv[1]);
+    testWindowFailure();
+    testMappedScan(random, argv[1]);
+
+    return checkResult("MemoryMappedFile");
+}
@@ -0,0 +1,374 @@
+// Which SIMD functions are tested is up to SPEEDRUN_SIMD, see
+// 'detectSimdLevel'.
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include "../src/Patterns.hpp"
+#include "../src/ScanResult.hpp"
+#include "../src/Scanner.hpp"
+#include "../src/ThreadPool.hpp"
+#include "../src/UrlSearch.hpp"
+#include "Check.hpp"
+
+namespace {
+
+struct FoundUrl {
+    std::string scheme;
+    std::string domain;
+    std::string path;
+};
+
+// All the URLs of a list in a single line each, for readable failures.
+std::string describe(std::vector<FoundUrl> const& urls) {
+    std::string text = "\n";
+    for (auto const& url: urls)
+        text += url.scheme + "|" + url.domain + "|" + url.path + "\n";
+    return text;
+}
+
+/*
+ * What the scanner is meant to find, done the dumbest way I could think
+ * of: every scheme is tried at every position, and the domain and the path
+ * are walked byte by byte.
+ */
+template <typename Grammar>
+std::vector<FoundUrl> referenceUrls(std::string const& text) {
+    std::vector<std::string> schemes;
+    std::string all = Grammar::schemes();
+    for (std::size_t pos = 0; pos <= all.size(); ) {
+        std::size_t bar = std::min(all.find('|', pos), all.size());
+        schemes.push_back(all.substr(pos, bar - pos) + "://");
+        pos = bar + 1;
+    }
+
+    std::vector<FoundUrl> urls;
+    for (std::size_t pos = 0; pos < text.size(); ) {
+        std::size_t domain = std::string::npos;
+        for (auto const& scheme: schemes) {
+            if (text.compare(pos, scheme.size(), scheme) == 0)
+                domain = pos + scheme.size();
+        }
+
+        if (domain >= text.size() || !Grammar::domain().has(text[domain])) {
+            ++pos;
+            continue;
+        }
+
+        std::size_t path = domain;
+        while (path < text.size() && Grammar::domain().has(text[path]))
+            ++path;
+
+        std::size_t end = path;
+        if (end < text.size() && text[end] == '/') {
+            ++end;
+            while (end < text.size() && Grammar::path().has(text[end]))
+                ++end;
+        }
+
+        urls.push_back(FoundUrl{text.substr(pos, domain - pos),
+                                text.substr(domain, path - domain),
+                                text.substr(path, end - path)});
+        pos = end;
+    }
+
+    return urls;
+}
+
+// What 'findUrl' finds in the whole of 'text', as if it was a mapped file.
+template <typename Grammar>
+std::vector<FoundUrl> scannedUrls(std::string const& text) {
+    ArrayView<char> view(text.data(), text.size());
+
+    std::vector<FoundUrl> urls;
+    UIndex urlBegin, domainBegin, pathBegin, urlEnd = 0;
+    while (findUrl<Grammar>(view, urlEnd, text.size(), true,
+                            urlBegin, domainBegin, pathBegin, urlEnd)) {
+        urls.push_back(FoundUrl{
+            text.substr(urlBegin, domainBegin - urlBegin),
+            text.substr(domainBegin, pathBegin - domainBegin),
+            text.substr(pathBegin, urlEnd - pathBegin)});
+    }
+
+    return urls;
+}
+
+template <typename Grammar = HttpGrammar>
+std::string scan(std::string const& text) {
+    return describe(scannedUrls<Grammar>(text));
+}
+
+std::string urls(std::vector<std::string> const& lines) {
+    std::string text = "\n";
+    for (auto const& line: lines)
+        text += line + "\n";
+    return text;
+}
+
+void testExamples() {
+    CHECK_EQ(scan("see http://example.com/a/b, then"),
+             urls({"http://|example.com|/a/b,"}));
+    CHECK_EQ(scan("https://a.org"), urls({"https://|a.org|"}));
+
+    // Near misses of the schemes.
+    CHECK_EQ(scan("htttp://example.com/x"), urls({}));
+    CHECK_EQ(scan("htp://example.com/x"), urls({}));
+    CHECK_EQ(scan("http:/example.com/x"), urls({}));
+    CHECK_EQ(scan("httpss://example.com/x"), urls({}));
+    CHECK_EQ(scan("hthttps://b.com/x"), urls({"https://|b.com|/x"}));
+    CHECK_EQ(scan("hthttp://b.com/x"), urls({"http://|b.com|/x"}));
+    CHECK_EQ(scan("httphttp://c.com"), urls({"http://|c.com|"}));
+    CHECK_EQ(scan("http://http://d.com"), urls({"http://|http|"}));
+    CHECK_EQ(scan("http://"), urls({}));
+    CHECK_EQ(scan("http:// e.com"), urls({}));
+
+    // URLs at the very end of the input.
+    CHECK_EQ(scan("x http://a.com"), urls({"http://|a.com|"}));
+    CHECK_EQ(scan("x http://a.com/"), urls({"http://|a.com|/"}));
+    CHECK_EQ(scan("x http://a.com/p/q"), urls({"http://|a.com|/p/q"}));
+    CHECK_EQ(scan("x http://a"), urls({"http://|a|"}));
+
+    // Non-ASCII bytes end both domains and paths.
+    CHECK_EQ(scan("http://caf\xc3\xa9.com/x"), urls({"http://|caf|"}));
+    CHECK_EQ(scan("http://a.com/it\xe2\x80\x99s"), urls({"http://|a.com|/it"}));
+    CHECK_EQ(scan("\xffhttp://a.com\x80"), urls({"http://|a.com|"}));
+    CHECK_EQ(scan("http://\xc3\xa9.com"), urls({}));
+    CHECK_EQ(scan("\xe3\x83\x9ehttps://b.com/\xe3\x83\x9e"),
+             urls({"https://|b.com|/"}));
+
+    // The grammars differ by what they let in.
+    CHECK_EQ(scan("http://a.com/s?q=1"), urls({"http://|a.com|/s"}));
+    CHECK_EQ(scan<HttpQueryGrammar>("http://a.com/s?q=1&r=%20#f"),
+             urls({"http://|a.com|/s?q=1&r=%20#f"}));
+    CHECK_EQ(scan("ftp://a.com/x"), urls({}));
+    CHECK_EQ(scan<HttpFtpGrammar>("ftp://a.com/x fftp://b.com"),
+             urls({"ftp://|a.com|/x", "ftp://|b.com|"}));
+}
+
+/*
+ * An URL running up to the end of a range which isn't the last one may go
+ * on in the next range. Then nothing is found, and the search is to be
+ * re-run right at its scheme.
+ */
+void testNeedMore() {
+    auto rerunPoint = [](std::string const& text, bool& found) {
+        ArrayView<char> view(text.data(), text.size());
+        UIndex urlBegin, domainBegin, pathBegin, urlEnd;
+        found = findUrl<HttpGrammar>(view, 0, text.size(), false,
+                                     urlBegin, domainBegin, pathBegin,
+                                     urlEnd);
+        return urlBegin;
+    };
+
+    for (std::string text: {"xy http://a.com", "xy http://a.com/p", "xy htt",
+                            "xy http:", "xy https:/", "xy http://"}) {
+        bool found = true;
+        CHECK_EQ(rerunPoint(text, found), 3u);
+        CHECK(!found);
+    }
+
+    // Something which can't be an URL whatever follows is stepped over.
+    bool found = true;
+    CHECK(rerunPoint("xy http:/x http://a.com/ ", found) == 11 && found);
+    CHECK(rerunPoint("xy htttp", found) >= 5 && !found);
+}
+
+// Long paths, much longer than any vector, cut in every possible place.
+void testLongPaths() {
+    std::string query = "/search";
+    for (unsigned k = 0; query.size() < 20000; ++k) {
+        query += (k == 0 ? "?" : "&") + std::string("key")
+               + std::to_string(k) + "=a%20b~c-d_e.f+g," + std::to_string(k);
+    }
+    query += "#top";
+
+    std::string url = "https://www.example.com" + query;
+    CHECK_EQ(scan<HttpQueryGrammar>(url + " tail"),
+             urls({"https://|www.example.com|" + query}));
+    CHECK_EQ(scan("x " + url), urls({"https://|www.example.com|/search"}));
+
+    for (std::size_t cut = 0; cut < 300; ++cut) {
+        std::string text = url;
+        text[url.size() - 1 - cut] = '\x80';
+        CHECK_EQ(scan<HttpQueryGrammar>(text),
+                 describe(referenceUrls<HttpQueryGrammar>(text)));
+    }
+
+    std::string domain(5000, 'a');
+    for (std::size_t k = 7; k < domain.size(); k += 7)
+        domain[k] = k % 2 ? '.' : '-';
+    CHECK_EQ(scan("http://" + domain + "/x"),
+             urls({"http://|" + domain + "|/x"}));
+}
+
+/*
+ * Random texts made of pieces of URLs, near misses, and non-ASCII bytes,
+ * at random offsets, so that every vector function is cut short at every
+ * possible place.
+ */
+std::string randomText(std::mt19937& random, std::size_t size) {
+    static char const* const pieces[] = {
+        "http://", "https://", "ftp://", "http", "https", "htt", "ftp",
+        "://", ":/", "hthttps://", "htttp://", ".", "/", "-", "_", "+", ",",
+        "?q=", "&", "=", "%20", "~", "#", " ", "\n", "\t", "\"", "<a>",
+        "\xc3\xa9", "\xff", "\x80", "\xe2\x80\x99" };
+    static char const letters[] = "abcdefghijklmnopqrstuvwxyzABCXYZ0123456789";
+
+    std::size_t const numPieces = sizeof pieces / sizeof pieces[0];
+    std::string text;
+    while (text.size() < size) {
+        if (random() % 3 == 0) {
+            std::size_t length = random() % 4 == 0 ? random() % 200
+                                                   : random() % 12;
+            for (std::size_t k = 0; k < length; ++k)
+                text += letters[random() % (sizeof letters - 1)];
+        } else {
+            text += pieces[random() % numPieces];
+        }
+    }
+
+    return text;
+}
+
+template <typename Grammar>
+void testRandom(std::mt19937& random, unsigned numTexts) {
+    for (unsigned k = 0; k < numTexts; ++k) {
+        std::string text = randomText(random, random() % 1000);
+        CHECK_EQ(scan<Grammar>(text), describe(referenceUrls<Grammar>(text)));
+    }
+}
+
+/*
+ * The counts which speedrun reports for a text, the way 'countUrl' counts
+ * them, printed in a single string.
+ */
+std::string expectedCounts(std::string const& text) {
+    std::map<std::string, unsigned> domains, paths;
+    unsigned numMatches = 0;
+    for (auto const& url: referenceUrls<UrlGrammar>(text)) {
+        ++numMatches;
+        ++domains[url.domain];
+        ++paths[url.path.empty() ? "/" : url.path];
+    }
+
+    std::string counts = std::to_string(numMatches) + " matches\n";
+    for (auto const& table: {domains, paths}) {
+        for (auto const& entry: table)
+            counts += entry.first + " " + std::to_string(entry.second) + "\n";
+        counts += "--\n";
+    }
+
+    return counts;
+}
+
+std::string countsOf(ScanResult const& result) {
+    std::string counts = std::to_string(result.numMatches) + " matches\n";
+    for (auto const* counter: {&result.urlDomains, &result.urlPaths}) {
+        std::map<std::string, unsigned> table;
+        for (auto const& entry: counter->exact())
+            table[entry.key().str()] = entry.count();
+
+        for (auto const& entry: table)
+            counts += entry.first + " " + std::to_string(entry.second) + "\n";
+        counts += "--\n";
+    }
+
+    return counts;
+}
+
+/*
+ * A small ring wraps around every few URLs. Shifting the text a byte at
+ * a time puts every part of an URL on the wrap-around point.
+ */
+template <UIndex N>
+void testRing(ThreadPool& pool, std::string const& text) {
+    for (UIndex shift = 0; shift < N; shift += 3) {
+        std::string shifted = std::string(shift, ' ') + text;
+        std::istringstream input(shifted);
+
+        ScanResult result{ScanConfig()};
+        scanStream<N>(pool, input, UINT64_MAX, result);
+        CHECK_EQ(countsOf(result), expectedCounts(shifted));
+    }
+}
+
+/*
+ * Files cut into many chunks, read by blocks through a ring which wraps,
+ * or mapped by windows much smaller than the file. No URL is lost or
+ * counted twice on any of these boundaries.
+ */
+void testFile(ThreadPool& pool, std::string const& filename,
+              std::string const& text) {
+    {
+        std::ofstream output(filename, std::ios_base::binary);
+        output << text;
+    }
+
+    std::string expected = expectedCounts(text);
+    for (unsigned numChunks: {1, 2, 3, 7, 16}) {
+        ScanConfig config;
+        ScanResult buffered(config);
+        scanFileBuffered(pool, config, filename, 0, text.size(), numChunks,
+                         ReaderOptions(), buffered);
+        CHECK_EQ(countsOf(buffered), expected);
+
+        MappingOptions mapping;
+        ScanResult mapped(config);
+        scanFileMapped(pool, config, filename, numChunks, mapping, mapped);
+        CHECK_EQ(countsOf(mapped), expected);
+
+        mapping.windowSize = 8192;
+        ScanResult windowed(config);
+        scanFileMapped(pool, config, filename, numChunks, mapping, windowed);
+        CHECK_EQ(countsOf(windowed), expected);
+    }
+
+    std::remove(filename.c_str());
+}
+
+// URLs with no gaps between them, so that any boundary cuts one.
+std::string urlDenseText(std::mt19937& random, std::size_t size) {
+    std::string text;
+    while (text.size() < size) {
+        text += random() % 2 ? "http://" : "https://";
+        text += "site" + std::to_string(random() % 50) + ".example.com";
+        if (random() % 4 != 0)
+            text += "/p" + std::to_string(random() % 100) + "/x_y-z";
+        text += random() % 5 == 0 ? "\xe2\x80\x99" : " ";
+    }
+
+    return text;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " TEMPFILE" << std::endl;
+        return 2;
+    }
+
+    std::cout << "SIMD level: " << int(simdLevel) << std::endl;
+
+    testExamples();
+    testNeedMore();
+    testLongPaths();
+
+    std::mt19937 random(20240601);
+    testRandom<HttpGrammar>(random, 3000);
+    testRandom<HttpQueryGrammar>(random, 3000);
+    testRandom<HttpFtpGrammar>(random, 3000);
+
+    ThreadPool pool(3);
+    testRing<256>(pool, urlDenseText(random, 1500));
+    testRing<1024>(pool, randomText(random, 5000));
+
+    std::string text = urlDenseText(random, 3*BlockRingSize);
+    text += randomText(random, 200000) + "http://the.end/of/it";
+    testFile(pool, argv[1], text);
+
+    return checkResult("scanner");
+}
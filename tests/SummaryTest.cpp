@@ -0,0 +1,303 @@
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include "../src/FrequencyTable.hpp"
+#include "../src/HeavyHitters.hpp"
+#include "../src/HyperLogLog.hpp"
+#include "../src/PartialResult.hpp"
+#include "../src/ThreadPool.hpp"
+#include "Check.hpp"
+
+namespace {
+
+using ExactCounts = std::map<std::string, std::uint64_t>;
+
+/*
+ * A stream of keys where a few are frequent and most are rare, the way
+ * domains are. Key k is drawn with the weight of 1/(k+1).
+ */
+std::vector<std::string> zipfStream(std::mt19937& random, std::size_t length,
+                                    std::size_t numKeys) {
+    std::vector<double> weights;
+    for (std::size_t k = 0; k < numKeys; ++k)
+        weights.push_back(1.0 / (k + 1));
+
+    std::discrete_distribution<std::size_t> pick(weights.begin(),
+                                                 weights.end());
+    std::vector<std::string> stream;
+    for (std::size_t k = 0; k < length; ++k)
+        stream.push_back("key" + std::to_string(pick(random)));
+    return stream;
+}
+
+ExactCounts countExactly(std::vector<std::string> const& stream) {
+    ExactCounts counts;
+    for (auto const& key: stream)
+        ++counts[key];
+    return counts;
+}
+
+/*
+ * Space-Saving promises that every count is off by no more than N/capacity,
+ * that the true count lies between the bounds, and that a key occurring
+ * more often than N/capacity is monitored.
+ */
+void checkSpaceSaving(HeavyHitters const& summary, ExactCounts const& exact,
+                      std::uint64_t total) {
+    std::uint64_t maxError = total / summary.capacity();
+
+    std::map<std::string, HeavyHitters::Item> monitored;
+    for (auto const& item: summary.top(summary.capacity())) {
+        std::uint64_t count = exact.at(item.key.str());
+        CHECK(item.lower <= count);
+        CHECK(count <= item.count);
+        CHECK(item.count - count <= maxError);
+        monitored.emplace(item.key.str(), item);
+    }
+
+    for (auto const& entry: exact) {
+        if (entry.second > maxError)
+            CHECK(monitored.count(entry.first) == 1);
+    }
+}
+
+void testHeavyHitters(std::mt19937& random) {
+    std::size_t const capacity = 100;
+    auto stream = zipfStream(random, 200000, 20000);
+    auto exact = countExactly(stream);
+
+    HeavyHitters whole(capacity);
+    for (auto const& key: stream)
+        whole.add(key);
+
+    CHECK(whole.evicted());
+    CHECK_EQ(whole.size(), capacity);
+    checkSpaceSaving(whole, exact, stream.size());
+
+    // Summaries of the parts, merged, keep the same bound of the whole.
+    HeavyHitters merged(capacity);
+    for (unsigned part = 0; part < 4; ++part) {
+        HeavyHitters summary(capacity);
+        for (std::size_t k = part; k < stream.size(); k += 4)
+            summary.add(stream[k]);
+        merged.merge(summary);
+    }
+    checkSpaceSaving(merged, exact, stream.size());
+
+    // Until something is evicted, the counts are exact.
+    HeavyHitters few(capacity);
+    auto small = zipfStream(random, 1000, capacity);
+    for (auto const& key: small)
+        few.add(key);
+
+    CHECK(!few.evicted());
+    for (auto const& item: few.top(capacity)) {
+        CHECK_EQ(item.count, countExactly(small).at(item.key.str()));
+        CHECK_EQ(item.lower, item.count);
+    }
+}
+
+// The keys of the estimators are hashes, so they are made up right away.
+std::uint64_t mixBits(std::uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+void addRange(HyperLogLog& sketch, std::uint64_t first, std::uint64_t last) {
+    for (std::uint64_t k = first; k < last; ++k)
+        sketch.add(mixBits(k));
+}
+
+double relativeError(HyperLogLog const& sketch, double expected) {
+    return std::fabs(sketch.estimate() - expected) / expected;
+}
+
+/*
+ * The standard error at precision 14 is 0.8%, and five of them are allowed.
+ * The sparse list is much more precise than that.
+ */
+void testHyperLogLog() {
+    double const denseError = 5 * 1.04 / std::sqrt(1 << 14);
+
+    HyperLogLog sketch(14);
+    CHECK_EQ(sketch.estimate(), 0.0);
+
+    // Adds a key at a time until the sketch turns dense, and looks at the
+    // estimate on both sides of the switch.
+    std::uint64_t numKeys = 0;
+    while (sketch.isSparse()) {
+        sketch.add(mixBits(numKeys++));
+        if (numKeys % 97 == 0 && sketch.isSparse())
+            CHECK(relativeError(sketch, numKeys) < 0.01);
+    }
+
+    CHECK(numKeys > 1000);
+    CHECK(relativeError(sketch, numKeys) < denseError);
+
+    for (std::uint64_t target: {20000, 100000, 1000000}) {
+        addRange(sketch, numKeys, target);
+        numKeys = target;
+        CHECK(relativeError(sketch, numKeys) < denseError);
+    }
+
+    // Merging is lossless, so a merge is just as good as a single sketch
+    // of the union, whether the sides are sparse, dense, or one of each.
+    for (auto sizes: {std::make_pair(300, 500), std::make_pair(300, 50000),
+                      std::make_pair(50000, 300),
+                      std::make_pair(40000, 60000)}) {
+        std::uint64_t last = std::max(sizes.first,
+                                      sizes.first / 2 + sizes.second);
+
+        HyperLogLog left(14), right(14), both(14);
+        addRange(left, 0, sizes.first);
+        addRange(right, sizes.first / 2, sizes.first / 2 + sizes.second);
+        addRange(both, 0, last);
+
+        double expected = last;
+        left.merge(right);
+        CHECK(relativeError(left, expected) < denseError);
+        CHECK(std::fabs(left.estimate() - both.estimate())
+              <= 1e-9 * expected);
+    }
+
+    // A saved sketch merges back into the same estimate.
+    for (std::uint64_t size: {500, 50000}) {
+        HyperLogLog original(14);
+        addRange(original, 0, size);
+
+        std::vector<std::uint32_t> sparse;
+        std::vector<std::uint8_t> dense;
+        original.save(sparse, dense);
+
+        HyperLogLog loaded(14);
+        if (original.isSparse())
+            loaded.mergeSparse(sparse.data(), sparse.size());
+        else
+            loaded.mergeDense(dense.data());
+        CHECK_EQ(loaded.estimate(), original.estimate());
+    }
+}
+
+/*
+ * Counts written by separate scans as partial results, then merged, give
+ * the very same top list as counting the whole stream exactly would.
+ */
+void testPartialResults(std::mt19937& random, std::string const& tempPrefix) {
+    std::size_t const maxNum = 20;
+    auto stream = zipfStream(random, 100000, 5000);
+    auto exact = countExactly(stream);
+
+    for (bool withSketch: {false, true}) {
+        std::vector<std::string> filenames;
+        for (unsigned part = 0; part < 3; ++part) {
+            FrequencyTable counts;
+            HyperLogLog distinct(12);
+            std::uint64_t total = 0;
+            for (std::size_t k = part; k < stream.size(); k += 3) {
+                counts.add(stream[k]);
+                distinct.add(hashBytes(stream[k]));
+                ++total;
+            }
+
+            filenames.push_back(tempPrefix + std::to_string(part));
+            writePartialResult(filenames.back(), {
+                { PartialKind::Domains, "", total, &counts,
+                  withSketch ? &distinct : nullptr } });
+        }
+
+        std::vector<std::unique_ptr<PartialResultFile>> files;
+        for (auto const& filename: filenames)
+            files.emplace_back(new PartialResultFile(filename));
+
+        ThreadPool pool(2);
+        auto merged = mergePartialResults(files, maxNum, pool);
+
+        CHECK_EQ(merged.size(), 1u);
+        if (merged.size() != 1)
+            continue;
+
+        MergedTable const& table = merged[0];
+        CHECK_EQ(table.total, stream.size());
+        CHECK_EQ(table.estimated, withSketch);
+        if (withSketch) {
+            CHECK(std::fabs(double(table.distinct) - exact.size())
+                  < 0.05 * exact.size());
+        } else {
+            CHECK_EQ(table.distinct, exact.size());
+        }
+
+        // By count descending, then by key.
+        std::vector<std::pair<std::string, std::uint64_t>> expected(
+            exact.begin(), exact.end());
+        std::stable_sort(expected.begin(), expected.end(),
+                         [](std::pair<std::string, std::uint64_t> const& a,
+                            std::pair<std::string, std::uint64_t> const& b) {
+                             return a.second > b.second;
+                         });
+        expected.resize(maxNum);
+
+        std::string expectedTop, actualTop;
+        for (auto const& entry: expected)
+            expectedTop += entry.first + " " + std::to_string(entry.second)
+                         + "\n";
+        for (auto const& entry: table.top)
+            actualTop += entry.key.str() + " " + std::to_string(entry.count)
+                       + "\n";
+        CHECK_EQ(actualTop, expectedTop);
+
+        files.clear();
+        for (auto const& filename: filenames)
+            std::remove(filename.c_str());
+    }
+}
+
+/*
+ * A moved-from table is empty, and counts anew as if it was a fresh one,
+ * while the keys moved along stay where they were.
+ */
+void testMovedTable() {
+    FrequencyTable table;
+    for (int k = 0; k < 1000; ++k)
+        table.add("key" + std::to_string(k % 300));
+
+    FrequencyTable moved(std::move(table));
+    CHECK_EQ(table.size(), 0u);
+    CHECK(table.begin() == table.end());
+    CHECK_EQ(table.memoryUsage(), 0u);
+    CHECK_EQ(moved.size(), 300u);
+
+    table.add(std::string("again"), 2);
+    CHECK_EQ(table.size(), 1u);
+    CHECK_EQ(table.top(1)[0]->count(), 2u);
+
+    FrequencyTable assigned;
+    assigned.add(std::string("old"));
+    assigned = std::move(moved);
+    CHECK_EQ(moved.size(), 0u);
+    CHECK(moved.begin() == moved.end());
+    CHECK_EQ(assigned.size(), 300u);
+    CHECK_EQ(assigned.top(1)[0]->count(), 4u);
+    CHECK_EQ(assigned.top(1)[0]->key().str(), "key0");
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " TEMPPREFIX" << std::endl;
+        return 2;
+    }
+
+    std::mt19937 random(20240601);
+    testHeavyHitters(random);
+    testHyperLogLog();
+    testPartialResults(random, argv[1]);
+    testMovedTable();
+
+    return checkResult("summaries");
+}
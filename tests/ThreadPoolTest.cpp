@@ -0,0 +1,184 @@
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../src/ThreadPool.hpp"
+#include "Check.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Spins until 'flag' is set, or a few seconds have passed, since a broken
+// pool would rather hang than fail.
+bool spinUntil(std::atomic<bool> const& flag) {
+    auto deadline = Clock::now() + std::chrono::seconds(10);
+    while (!flag && Clock::now() < deadline)
+        std::this_thread::yield();
+    return flag;
+}
+
+/*
+ * A worker which is busy with something else never gets to the tasks it
+ * has submitted to its own queue, so they are only ever done if another
+ * worker steals them.
+ */
+void testStealing() {
+    ThreadPool pool(2);
+    const unsigned numTasks = 8;
+
+    std::mutex mutex;
+    std::vector<std::thread::id> ranOn;
+    std::atomic<unsigned> numDone(0);
+    std::atomic<bool> allDone(false);
+    std::atomic<bool> ownerDone(false);
+    std::thread::id owner;
+
+    auto outer = pool.submit([&]{
+        owner = std::this_thread::get_id();
+
+        std::vector<Task<void>> tasks;
+        for (unsigned k = 0; k < numTasks; ++k) {
+            tasks.push_back(pool.submit([&]{
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    ranOn.push_back(std::this_thread::get_id());
+                }
+                if (++numDone == numTasks)
+                    allDone = true;
+            }));
+        }
+
+        // Busy, rather than waiting for them the way 'Task::wait' does.
+        spinUntil(allDone);
+        ownerDone = true;
+    });
+
+    // Not 'get()' yet, so that nothing is run by this thread.
+    CHECK(spinUntil(ownerDone));
+    outer.get();
+
+    CHECK_EQ(numDone.load(), numTasks);
+    CHECK_EQ(ranOn.size(), numTasks);
+    for (auto const& id: ranOn)
+        CHECK(id != owner);
+}
+
+unsigned sumTree(ThreadPool& pool, unsigned depth) {
+    if (depth == 0)
+        return 1;
+
+    auto left = pool.submit([&pool, depth]{
+        return sumTree(pool, depth - 1);
+    });
+    auto right = pool.submit([&pool, depth]{
+        return sumTree(pool, depth - 1);
+    });
+    return left.get() + right.get();
+}
+
+/*
+ * Whoever waits for a task runs the pending ones meanwhile. With a single
+ * worker, a task waiting for a task of its own would never see it done
+ * otherwise, and neither would a tree of them, which waits at every level.
+ */
+void testHelpWhileWaiting() {
+    ThreadPool pool(1);
+
+    std::atomic<bool> outerDone(false);
+    std::thread::id outerOn, innerOn;
+    int innerResult = 0;
+
+    auto outer = pool.submit([&]{
+        outerOn = std::this_thread::get_id();
+        auto inner = pool.submit([&]{
+            innerOn = std::this_thread::get_id();
+            return 42;
+        });
+        innerResult = inner.get();
+        outerDone = true;
+    });
+
+    CHECK(spinUntil(outerDone));
+    outer.get();
+    CHECK_EQ(innerResult, 42);
+    CHECK(innerOn == outerOn);
+
+    std::atomic<bool> treeDone(false);
+    unsigned sum = 0;
+    auto tree = pool.submit([&]{
+        sum = sumTree(pool, 10);
+        treeDone = true;
+    });
+
+    CHECK(spinUntil(treeDone));
+    tree.get();
+    CHECK_EQ(sum, 1u << 10);
+
+    // The same from a pool of a few, where the tasks are stolen as well.
+    ThreadPool wide(4);
+    CHECK_EQ(wide.submit([&]{ return sumTree(wide, 12); }).get(), 1u << 12);
+}
+
+/*
+ * What a task throws comes out of 'get()', even through a task which has
+ * waited for it, and the pool goes on afterwards.
+ */
+void testExceptions() {
+    ThreadPool pool(2);
+
+    std::string what;
+    try {
+        pool.submit([]() -> int { throw std::runtime_error("boom"); }).get();
+    } catch (std::runtime_error const& e) {
+        what = e.what();
+    }
+    CHECK_EQ(what, "boom");
+
+    what.clear();
+    try {
+        pool.submit([&pool]{
+            pool.submit([]{ throw std::invalid_argument("inner"); }).get();
+        }).get();
+    } catch (std::invalid_argument const& e) {
+        what = e.what();
+    }
+    CHECK_EQ(what, "inner");
+
+    // Only the one which threw fails, the ones around it don't.
+    std::vector<Task<int>> tasks;
+    for (int k = 0; k < 16; ++k) {
+        tasks.push_back(pool.submit([k]{
+            if (k == 7)
+                throw std::out_of_range("seven");
+            return k;
+        }));
+    }
+
+    int sum = 0;
+    unsigned numThrown = 0;
+    for (auto& task: tasks) {
+        try {
+            sum += task.get();
+        } catch (std::out_of_range const&) {
+            ++numThrown;
+        }
+    }
+    CHECK_EQ(sum, 120 - 7);
+    CHECK_EQ(numThrown, 1u);
+
+    CHECK_EQ(pool.submit([]{ return 5; }).get(), 5);
+}
+
+} // namespace
+
+int main() {
+    testStealing();
+    testHelpWhileWaiting();
+    testExceptions();
+
+    return checkResult("ThreadPool");
+}
@@ -0,0 +1,54 @@
+#!/bin/sh
+#
+# Feeds a corpus to both tools through a pipe, plain and gzip compressed,
+# and checks that they count just what they count in the file itself. The
+# first bytes of a pipe can only be read once, so whatever looks at them
+# before the scan loses them.
+#
+# Usage: pipe_input.sh SPEEDRUN SHODANTASK GENCORPUS GZIP WORKDIR
+
+set -e
+
+speedrun=$1
+shodantask=$2
+gencorpus=$3
+gzip=$4
+dir=$5
+
+mkdir -p "$dir"
+corpus=$dir/corpus.log
+
+"$gencorpus" 2 "$corpus"
+"$gzip" -c "$corpus" > "$corpus.gz"
+
+fail() {
+    echo "FAIL: $*" >&2
+    exit 1
+}
+
+"$shodantask" buf 20 "$corpus" > "$dir/shodan.expected"
+
+for method in buf mmap window; do
+    cat "$corpus" | "$shodantask" $method 20 /dev/stdin > "$dir/shodan.out"
+    cmp -s "$dir/shodan.expected" "$dir/shodan.out" \
+        || fail "shodantask $method, piped plain input"
+
+    cat "$corpus.gz" | "$shodantask" $method 20 /dev/stdin > "$dir/shodan.out"
+    cmp -s "$dir/shodan.expected" "$dir/shodan.out" \
+        || fail "shodantask $method, piped gzip input"
+done
+
+"$speedrun" -n 20 "$corpus" "$dir/speedrun.expected"
+
+for method in buf mmap; do
+    cat "$corpus" | "$speedrun" -n 20 -m $method /dev/stdin "$dir/speedrun.out"
+    cmp -s "$dir/speedrun.expected" "$dir/speedrun.out" \
+        || fail "speedrun $method, piped plain input"
+
+    cat "$corpus.gz" | "$speedrun" -n 20 -m $method /dev/stdin \
+                                   "$dir/speedrun.out"
+    cmp -s "$dir/speedrun.expected" "$dir/speedrun.out" \
+        || fail "speedrun $method, piped gzip input"
+done
+
+echo "OK"